@@ -0,0 +1,429 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cerrno>
+#include <cstdio>
+#include <sys/resource.h> // Cho getrlimit/setrlimit
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "async_protocol.hpp"
+
+/**
+ * Load generator (không tương tác) cho server quiz.
+ * Mở nhiều kết nối đồng thời, đăng nhập bằng tài khoản tổng hợp
+ * (<prefix>000000, <prefix>000001, ...), trả lời với tốc độ và tỉ lệ đúng
+ * cấu hình được, rồi in throughput và độ trễ p50/p99/p999 của đăng nhập
+ * và của từng lượt hỏi-đáp.
+ *
+ * Mỗi kết nối là 1 coroutine (coro.hpp) viết tuần tự như client blocking;
+ * mỗi thread chạy 1 EventLoop multiplex phần kết nối của nó.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+    std::string host = "127.0.0.1";
+    int port = 8081;
+    int connections = 1000;
+    int threads = 0;              // 0 = số core
+    int duration_s = 10;
+    double rate = 0;              // Câu trả lời/giây của mỗi kết nối (0 = nhanh nhất có thể)
+    double accuracy = 0.9;        // Xác suất trả lời đúng 1 câu
+    int speed_round = 0;          // > 0: chơi speed round N câu/lượt
+    bool msgpack = true;
+    std::string questions_file = "../data/questions.json";
+    std::string user_prefix = "bench";
+    std::string password = "bench";
+};
+
+// Thống kê của 1 thread (gộp lại khi kết thúc)
+struct BenchStats {
+    std::vector<uint32_t> login_us;  // Độ trễ đăng nhập (micro giây)
+    std::vector<uint32_t> round_us;  // Độ trễ 1 lượt: gửi trả lời -> nhận kết quả
+    uint64_t answers = 0;
+    uint64_t games = 0;              // Số game kết thúc do trả lời sai
+    uint64_t connect_errors = 0;
+    uint64_t disconnects = 0;        // Server đóng kết nối ngoài dự kiến
+    uint64_t busy = 0;               // Nhận S2C_SERVER_BUSY
+    uint64_t login_errors = 0;
+};
+
+static std::atomic<bool> g_stop{false};
+
+// Chờ trước khi kết nối lại khi không kết nối được tới server
+static const Clock::duration RETRY_DELAY = std::chrono::milliseconds(100);
+// Chờ trước khi đăng nhập lại khi phiên cũ của tài khoản chưa kịp logout
+static const Clock::duration RELOGIN_DELAY = std::chrono::milliseconds(50);
+
+/**
+ * @brief 1 thread của load generator: 1 EventLoop chạy 1 coroutine cho mỗi
+ * kết nối (kết nối -> đăng nhập -> chơi đến hết ván -> kết nối lại).
+ */
+class BenchWorker {
+public:
+    BenchWorker(const BenchConfig& config, const std::unordered_map<std::string, std::string>& answers,
+                std::vector<int> indices)
+        : config(config), answers(answers), rng(std::random_device{}()) {
+        for (int index : indices) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "%s%06d", config.user_prefix.c_str(), index);
+            usernames.push_back(name);
+        }
+        encoding = config.msgpack ? protocol::Encoding::MSGPACK : protocol::Encoding::JSON;
+        address.sin_family = AF_INET;
+        address.sin_port = htons(config.port);
+        inet_pton(AF_INET, config.host.c_str(), &address.sin_addr);
+    }
+
+    void run() {
+        coro::EventLoop loop;
+        for (const auto& username : usernames) {
+            loop.spawn(session(loop, username));
+        }
+        loop.run(g_stop);
+    }
+
+    BenchStats stats;
+
+private:
+    /**
+     * @brief Vòng đời của 1 tài khoản tổng hợp: mỗi ván 1 kết nối mới.
+     */
+    coro::Task<void> session(coro::EventLoop& loop, const std::string& username) {
+        while (true) {
+            coro::Socket socket(loop);
+            if (!co_await socket.connect(address)) {
+                stats.connect_errors++;
+                co_await loop.sleep(RETRY_DELAY);
+                continue;
+            }
+            protocol::setNoDelay(socket.fd());
+            if (!co_await play(loop, socket, username)) {
+                co_return; // Tài khoản không đăng nhập được: bỏ kết nối này
+            }
+        }
+    }
+
+    /**
+     * @brief Đăng nhập rồi chơi tới khi server đóng kết nối.
+     * @return false nếu đăng nhập thất bại (không thử lại).
+     */
+    coro::Task<bool> play(coro::EventLoop& loop, coro::Socket& socket, const std::string& username) {
+        protocol::FrameReader reader;
+        if (config.msgpack) {
+            // HELLO luôn gửi bằng JSON; server tự nhận dạng encoding của các frame sau
+            json hello;
+            hello["action"] = protocol::C2S_HELLO;
+            hello["payload"]["encodings"] = {protocol::encodingName(protocol::Encoding::MSGPACK)};
+            co_await protocol::asyncSendMessage(socket, hello);
+        }
+        Clock::time_point sent_at = Clock::now(); // Lúc gửi đăng nhập / câu trả lời
+        co_await protocol::asyncSendMessage(socket, loginMessage(username), encoding);
+
+        bool game_over = false;
+        while (true) {
+            json msg = co_await protocol::asyncReceiveMessage(socket, reader);
+            if (msg.is_null()) {
+                // Sau game over server chủ động đóng: chơi game mới bằng kết nối mới
+                if (!game_over) stats.disconnects++;
+                co_return true;
+            }
+
+            std::string action = msg.value("action", "");
+            const json& payload = msg.contains("payload") ? msg["payload"] : msg;
+            Clock::time_point now = Clock::now();
+
+            if (action == protocol::S2C_LOGIN_SUCCESS) {
+                stats.login_us.push_back(elapsedUs(sent_at, now));
+            } else if (action == protocol::S2C_LOGIN_FAILURE) {
+                std::string message = payload.value("message", "");
+                if (message.find("already logged in") == std::string::npos) {
+                    stats.login_errors++;
+                    if (stats.login_errors == 1) {
+                        std::cerr << "Login failed for " << username << ": " << message << std::endl;
+                    }
+                    co_return false;
+                }
+                // Phiên cũ của tài khoản này chưa kịp logout trên server: thử lại sau
+                co_await loop.sleep(RELOGIN_DELAY);
+                sent_at = Clock::now();
+                co_await protocol::asyncSendMessage(socket, loginMessage(username), encoding);
+            } else if (action == protocol::S2C_NEW_QUESTION || action == protocol::S2C_QUESTION_BATCH) {
+                std::vector<std::string> question_ids;
+                if (action == protocol::S2C_NEW_QUESTION) {
+                    question_ids.push_back(payload.value("question_id", ""));
+                } else {
+                    for (const auto& q : payload.value("questions", json::array())) {
+                        question_ids.push_back(q.value("question_id", ""));
+                    }
+                }
+                if (config.rate > 0) {
+                    // Mỗi kết nối trả lời 'rate' câu/giây (1 lượt speed round = N câu)
+                    double seconds = question_ids.size() / config.rate;
+                    co_await loop.sleep(std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(seconds)));
+                }
+                stats.answers += question_ids.size();
+                sent_at = Clock::now();
+                co_await protocol::asyncSendMessage(socket, answerMessage(question_ids), encoding);
+            } else if (action == protocol::S2C_ANSWER_RESULT || action == protocol::S2C_BATCH_RESULT) {
+                stats.round_us.push_back(elapsedUs(sent_at, now));
+                bool over = action == protocol::S2C_ANSWER_RESULT
+                                ? !payload.value("is_correct", false)
+                                : payload.value("game_over", true);
+                if (over) {
+                    stats.games++;
+                    game_over = true;
+                }
+            } else if (action == protocol::S2C_SERVER_BUSY) {
+                stats.busy++;
+                game_over = true; // Server sẽ đóng kết nối
+            } else if (action == protocol::S2C_PING) {
+                json pong;
+                pong["action"] = protocol::C2S_PONG;
+                pong["payload"] = json::object();
+                co_await protocol::asyncSendMessage(socket, pong, encoding);
+            }
+        }
+    }
+
+    json loginMessage(const std::string& username) const {
+        json login;
+        login["action"] = protocol::C2S_LOGIN_REQUEST;
+        login["payload"]["username"] = username;
+        login["payload"]["password"] = config.password;
+        if (config.speed_round > 0) {
+            login["payload"]["speed_round"] = config.speed_round;
+        }
+        return login;
+    }
+
+    json answerMessage(const std::vector<std::string>& question_ids) {
+        std::bernoulli_distribution correct(config.accuracy);
+        json msg;
+        if (config.speed_round > 0) {
+            msg["action"] = protocol::C2S_SUBMIT_BATCH;
+            json& list = msg["payload"]["answers"] = json::array();
+            for (const auto& id : question_ids) {
+                list.push_back({{"question_id", id}, {"answer", pickAnswer(id, correct(rng))}});
+            }
+        } else {
+            const std::string& id = question_ids.front();
+            msg["action"] = protocol::C2S_SUBMIT_ANSWER;
+            msg["payload"]["question_id"] = id;
+            msg["payload"]["answer"] = pickAnswer(id, correct(rng));
+        }
+        return msg;
+    }
+
+    std::string pickAnswer(const std::string& question_id, bool correct) {
+        auto it = answers.find(question_id);
+        if (correct && it != answers.end()) return it->second;
+        return "-"; // Không phải đáp án hợp lệ nào
+    }
+
+    static uint32_t elapsedUs(Clock::time_point from, Clock::time_point to) {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+    }
+
+    const BenchConfig& config;
+    const std::unordered_map<std::string, std::string>& answers;
+    std::mt19937 rng;
+    protocol::Encoding encoding;
+    sockaddr_in address{};
+    std::vector<std::string> usernames;
+};
+
+/**
+ * @brief Ghi file users.json chứa 'count' tài khoản tổng hợp cho load generator.
+ */
+static bool generateUsers(const BenchConfig& config, int count, const std::string& path) {
+    json users = json::array();
+    for (int i = 0; i < count; ++i) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s%06d", config.user_prefix.c_str(), i);
+        users.push_back({{"username", name}, {"password", config.password}, {"score", 0}, {"status", "active"}});
+    }
+    std::ofstream o(path);
+    o << std::setw(2) << users << std::endl;
+    if (!o) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << count << " synthetic users to " << path << std::endl;
+    return true;
+}
+
+/**
+ * @brief Đọc đáp án đúng của mọi câu hỏi (question_id -> đáp án).
+ */
+static bool loadAnswers(const std::string& path, std::unordered_map<std::string, std::string>& answers) {
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        std::cerr << "Cannot open question file: " << path << std::endl;
+        return false;
+    }
+    try {
+        for (const auto& item : json::parse(f)) {
+            answers[item["id"]] = item["correct_answer"];
+        }
+    } catch (json::exception& e) {
+        std::cerr << "Failed to parse questions file: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void printLatency(const char* name, std::vector<uint32_t>& samples, double seconds) {
+    std::cout << std::left << std::setw(8) << name << std::right
+              << std::setw(10) << samples.size() << " ops"
+              << std::setw(12) << std::fixed << std::setprecision(1) << samples.size() / seconds << " ops/s";
+    if (samples.empty()) {
+        std::cout << std::endl;
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto pct = [&](double p) {
+        size_t i = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+        return samples[i] / 1000.0;
+    };
+    std::cout << std::setprecision(3)
+              << "   p50 " << pct(0.50) << " ms"
+              << "   p99 " << pct(0.99) << " ms"
+              << "   p999 " << pct(0.999) << " ms"
+              << "   max " << samples.back() / 1000.0 << " ms" << std::endl;
+}
+
+static void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --host ADDR          Server address (default 127.0.0.1)\n"
+              << "  --port N             Server port (default 8081)\n"
+              << "  --connections N      Concurrent connections / synthetic accounts (default 1000)\n"
+              << "  --threads N          Load generator threads (default: number of cores)\n"
+              << "  --duration N         Seconds to run (default 10)\n"
+              << "  --rate R             Answers per second per connection, 0 = unthrottled (default 0)\n"
+              << "  --accuracy P         Probability of answering correctly (default 0.9)\n"
+              << "  --speed-round N      Play speed rounds of N questions (default 0 = classic)\n"
+              << "  --msgpack 0|1        Negotiate MessagePack (default 1)\n"
+              << "  --questions PATH     questions.json used to pick correct answers\n"
+              << "  --user-prefix S      Synthetic account prefix (default bench)\n"
+              << "  --password S         Synthetic account password (default bench)\n"
+              << "  --gen-users N PATH   Write N synthetic accounts to PATH and exit\n";
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    int gen_count = -1;
+    std::string gen_path;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--host") config.host = value;
+            else if (arg == "--port") config.port = std::stoi(value);
+            else if (arg == "--connections") config.connections = std::stoi(value);
+            else if (arg == "--threads") config.threads = std::stoi(value);
+            else if (arg == "--duration") config.duration_s = std::stoi(value);
+            else if (arg == "--rate") config.rate = std::stod(value);
+            else if (arg == "--accuracy") config.accuracy = std::stod(value);
+            else if (arg == "--speed-round") config.speed_round = std::stoi(value);
+            else if (arg == "--msgpack") config.msgpack = std::stoi(value) != 0;
+            else if (arg == "--questions") config.questions_file = value;
+            else if (arg == "--user-prefix") config.user_prefix = value;
+            else if (arg == "--password") config.password = value;
+            else if (arg == "--gen-users" && i + 1 < argc) {
+                gen_count = std::stoi(value);
+                gen_path = argv[++i];
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception&) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (gen_count >= 0) {
+        return generateUsers(config, gen_count, gen_path) ? 0 : 1;
+    }
+
+    std::unordered_map<std::string, std::string> answers;
+    if (!loadAnswers(config.questions_file, answers)) {
+        return 1;
+    }
+    config.accuracy = std::max(0.0, std::min(config.accuracy, 1.0));
+    if (config.threads <= 0) {
+        config.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Mỗi kết nối 1 fd: nâng giới hạn số fd lên mức tối đa cho phép
+    rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    std::vector<std::unique_ptr<BenchWorker>> workers;
+    for (int t = 0; t < config.threads; ++t) {
+        std::vector<int> indices;
+        for (int i = t; i < config.connections; i += config.threads) indices.push_back(i);
+        workers.push_back(std::make_unique<BenchWorker>(config, answers, std::move(indices)));
+    }
+
+    std::cout << "Running " << config.connections << " connections on " << config.threads
+              << " thread(s) against " << config.host << ":" << config.port
+              << " for " << config.duration_s << "s (" << (config.msgpack ? "msgpack" : "json")
+              << (config.speed_round > 0 ? ", speed round " + std::to_string(config.speed_round) : std::string())
+              << ")..." << std::endl;
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (auto& w : workers) {
+        threads.emplace_back([&w]() { w->run(); });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(config.duration_s));
+    g_stop = true;
+    for (auto& t : threads) t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Gộp thống kê của các thread
+    BenchStats total;
+    for (auto& w : workers) {
+        BenchStats& s = w->stats;
+        total.login_us.insert(total.login_us.end(), s.login_us.begin(), s.login_us.end());
+        total.round_us.insert(total.round_us.end(), s.round_us.begin(), s.round_us.end());
+        total.answers += s.answers;
+        total.games += s.games;
+        total.connect_errors += s.connect_errors;
+        total.disconnects += s.disconnects;
+        total.busy += s.busy;
+        total.login_errors += s.login_errors;
+    }
+
+    std::cout << "\n--- RESULTS (" << std::fixed << std::setprecision(1) << seconds << "s) ---" << std::endl;
+    printLatency("login", total.login_us, seconds);
+    printLatency("round", total.round_us, seconds);
+    std::cout << "answers " << total.answers << " (" << std::setprecision(1) << total.answers / seconds << "/s)"
+              << ", games over " << total.games
+              << ", connect errors " << total.connect_errors
+              << ", unexpected disconnects " << total.disconnects
+              << ", busy " << total.busy
+              << ", login errors " << total.login_errors << std::endl;
+    return total.login_errors == 0 ? 0 : 1;
+}
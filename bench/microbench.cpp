@@ -0,0 +1,603 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "protocol.hpp"
+#include "user_db.hpp"
+#include "user_store.hpp"
+
+/**
+ * Microbenchmark cho từng đoạn nóng của server, đo riêng lẻ (không cần server chạy):
+ *   json/dump, json/parse      nlohmann DOM <-> chuỗi JSON của từng loại thông điệp
+ *   msgpack/encode, decode     protocol::encodeBody/decodeBody (encoding MessagePack)
+ *   msgpack/decode-arena       decodeBody<ArenaJson> trong Arena của kết nối như reactor của server
+ *   frame/json, frame/msgpack  sendMessage + receiveMessage qua socketpair (1 vòng gửi-nhận)
+ *   round/json, round/msgpack  1 lượt chơi phía server qua socketpair: đọc + giải mã câu trả lời
+ *                              (ArenaJson), dựng + mã hóa kết quả, gửi kèm câu hỏi kế tiếp;
+ *                              phải là 0 allocs/op (mọi thứ nằm trong arena/buffer của kết nối)
+ *   store/login/N              phần tra tài khoản của đăng nhập: UserStore::acquire +
+ *                              đọc record + release, CSDL N user (cache đã ấm)
+ *   store/login-4t/N           như store/login nhưng 4 thread cùng lúc (ns/op tính theo thời gian thực)
+ *   store/login-miss/N         như trên nhưng cache nhỏ: mỗi lần đều đọc SQLite
+ *   store/commit/N/B           B thay đổi điểm + chờ commit (fsync) xuống CSDL N user
+ *
+ * Mỗi benchmark tự tăng số vòng tới khi 1 lần chạy đủ --min-time, chạy --repeat
+ * lần và in ns/op của lần nhanh nhất cùng allocs/op và bytes/op (đếm bằng operator new thay thế trong binary này).
+ * --save-baseline ghi kết quả ra file; --baseline so sánh với file đó và trả
+ * về mã lỗi 1 nếu có benchmark cấp phát nhiều hơn (allocs/op, bytes/op: như nhau
+ * trên mọi máy). Thời gian chỉ so sánh khi có --threshold, với baseline ghi trên
+ * chính máy đó; store/commit/... (chờ fsync, phụ thuộc đĩa) không bao giờ so thời gian.
+ * Benchmark round/... thất bại khi có cấp phát, kể cả không có baseline.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+// --- ĐẾM CẤP PHÁT (mọi thread, kể cả thread writer của UserDb) ---
+static std::atomic<uint64_t> g_allocs{0};
+static std::atomic<uint64_t> g_alloc_bytes{0};
+
+void* operator new(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+// noinline: gcc (-Wmismatched-new-delete) không thấy được free() ghép với malloc() trong operator new
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// allocs/op và bytes/op được phép tăng so với baseline (thời gian dùng --threshold)
+static const double ALLOC_TOLERANCE = 0.05;
+static const double BYTES_SLACK = 64; // Thêm cho bytes/op: chuỗi độ dài thay đổi (số, token)
+
+// Arena của benchmark msgpack/decode-arena/..., round/... giữ tối đa chừng này giữa 2 thông điệp (như IDLE_BUFFER_LIMIT của reactor)
+static const size_t ARENA_IDLE_LIMIT = 4 * 1024;
+
+// Số thread của benchmark store/login-Nt/...
+static const size_t LOGIN_THREADS = 4;
+
+// Chặn compiler bỏ kết quả của vòng đo
+static volatile size_t g_sink = 0;
+
+struct MicroConfig {
+    std::string filter;          // Chỉ chạy benchmark có tên chứa chuỗi này
+    int min_time_ms = 200;       // Thời gian đo tối thiểu của mỗi lần chạy
+    int repeat = 3;              // Số lần chạy mỗi benchmark (lấy lần nhanh nhất)
+    int max_users = 100000;      // Bỏ các cỡ CSDL lớn hơn
+    double threshold = -1;       // Chậm hơn baseline quá tỉ lệ này thì báo hồi quy (< 0: không so thời gian)
+    std::string baseline;        // File baseline để so sánh
+    std::string save_baseline;   // Ghi kết quả ra file này
+};
+
+struct Result {
+    double ns_per_op = 0;
+    double allocs_per_op = 0;
+    double bytes_per_op = 0;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<void(size_t iterations)> run; // Chạy đúng 'iterations' op
+    bool time_gated = true; // false: thời gian phụ thuộc đĩa (fsync), không so với baseline
+    bool zero_alloc = false; // true: phải là 0 allocs/op (không cần baseline)
+};
+
+/**
+ * @brief Đo 1 lần chạy 'iterations' op.
+ */
+static Result runOnce(const Benchmark& bench, size_t iterations, double& ns) {
+    uint64_t allocs = g_allocs.load(std::memory_order_relaxed);
+    uint64_t bytes = g_alloc_bytes.load(std::memory_order_relaxed);
+    Clock::time_point start = Clock::now();
+    bench.run(iterations);
+    ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    Result r;
+    r.ns_per_op = ns / iterations;
+    r.allocs_per_op = double(g_allocs.load(std::memory_order_relaxed) - allocs) / iterations;
+    r.bytes_per_op = double(g_alloc_bytes.load(std::memory_order_relaxed) - bytes) / iterations;
+    return r;
+}
+
+/**
+ * @brief Tăng số vòng tới khi 1 lần chạy đủ min_time, rồi chạy thêm để đủ 'repeat'
+ * lần và lấy lần nhanh nhất (ít bị ảnh hưởng bởi process khác nhất).
+ */
+static Result measure(const Benchmark& bench, int min_time_ms, int repeat) {
+    bench.run(1); // Làm ấm (cache, bộ đệm của socket, statement của SQLite)
+    const double min_ns = min_time_ms * 1e6;
+    size_t iterations = 1;
+    double ns;
+    Result best = runOnce(bench, iterations, ns);
+    while (ns < min_ns && iterations < (size_t(1) << 30)) {
+        // Ước lượng số vòng cần cho đủ min_time (+20%), tăng ít nhất gấp đôi, nhiều nhất 100 lần
+        double factor = ns > 0 ? min_ns * 1.2 / ns : 100;
+        iterations = static_cast<size_t>(iterations * std::max(2.0, std::min(factor, 100.0)));
+        best = runOnce(bench, iterations, ns);
+    }
+    for (int i = 1; i < repeat; ++i) {
+        Result r = runOnce(bench, iterations, ns);
+        if (r.ns_per_op < best.ns_per_op) best = r;
+    }
+    return best;
+}
+
+// ==========================================================
+// THÔNG ĐIỆP MẪU
+// ==========================================================
+
+static json questionPayload(int i) {
+    char id[16];
+    std::snprintf(id, sizeof(id), "q%03d", i);
+    return {
+        {"question_id", id},
+        {"question_text", "Which planet in our solar system has the shortest day?"},
+        {"options", {{"A", "Mercury"}, {"B", "Venus"}, {"C", "Jupiter"}, {"D", "Mars"}}}
+    };
+}
+
+/**
+ * @brief 1 thông điệp tiêu biểu cho mỗi loại gói tin nóng.
+ */
+static std::vector<std::pair<std::string, json>> sampleMessages() {
+    std::vector<std::pair<std::string, json>> messages;
+
+    json login;
+    login["action"] = protocol::C2S_LOGIN_REQUEST;
+    login["payload"]["username"] = "player000042";
+    login["payload"]["password"] = "correct horse battery staple";
+    messages.emplace_back("login", std::move(login));
+
+    json question;
+    question["action"] = protocol::S2C_NEW_QUESTION;
+    question["payload"] = questionPayload(42);
+    messages.emplace_back("question", std::move(question));
+
+    json answer;
+    answer["action"] = protocol::C2S_SUBMIT_ANSWER;
+    answer["payload"]["question_id"] = "q042";
+    answer["payload"]["answer"] = "C";
+    messages.emplace_back("answer", std::move(answer));
+
+    json result;
+    result["action"] = protocol::S2C_ANSWER_RESULT;
+    result["payload"]["question_id"] = "q042";
+    result["payload"]["is_correct"] = true;
+    result["payload"]["new_score"] = 17;
+    messages.emplace_back("result", std::move(result));
+
+    json batch;
+    batch["action"] = protocol::S2C_QUESTION_BATCH;
+    json& list = batch["payload"]["questions"] = json::array();
+    for (int i = 0; i < 10; ++i) list.push_back(questionPayload(i));
+    messages.emplace_back("batch10", std::move(batch));
+
+    json standings;
+    standings["action"] = protocol::S2C_ROOM_STANDINGS;
+    standings["payload"]["room"] = "lobby";
+    standings["payload"]["round"] = 128;
+    json& rows = standings["payload"]["standings"] = json::array();
+    for (int i = 0; i < 16; ++i) {
+        rows.push_back({{"username", "player" + std::to_string(i)}, {"points", 16 - i}});
+    }
+    messages.emplace_back("standings16", std::move(standings));
+    return messages;
+}
+
+// ==========================================================
+// CÁC NHÓM BENCHMARK
+// ==========================================================
+
+static void addCodecBenchmarks(std::vector<Benchmark>& out) {
+    for (const auto& [name, msg] : sampleMessages()) {
+        out.push_back({"json/dump/" + name, [msg = msg](size_t n) {
+            for (size_t i = 0; i < n; ++i) g_sink += msg.dump().size();
+        }});
+        out.push_back({"json/parse/" + name, [text = msg.dump()](size_t n) {
+            for (size_t i = 0; i < n; ++i) g_sink += json::parse(text).size();
+        }});
+        out.push_back({"msgpack/encode/" + name, [msg = msg](size_t n) {
+            std::string body;
+            for (size_t i = 0; i < n; ++i) {
+                body.clear();
+                protocol::encodeBody(body, msg, protocol::Encoding::MSGPACK);
+                g_sink += body.size();
+            }
+        }});
+        std::string packed;
+        protocol::encodeBody(packed, msg, protocol::Encoding::MSGPACK);
+        out.push_back({"msgpack/decode/" + name, [packed](size_t n) {
+            for (size_t i = 0; i < n; ++i) g_sink += protocol::decodeBody(packed.data(), packed.size()).size();
+        }});
+        // Như reactor: giải mã trong arena của kết nối, xử lý xong thì reset()
+        out.push_back({"msgpack/decode-arena/" + name, [packed, arena = std::make_shared<Arena>()](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                {
+                    Arena::Scope scope(*arena);
+                    ArenaJson msg = protocol::decodeBody<ArenaJson>(packed.data(), packed.size());
+                    g_sink += msg.size();
+                    protocol::clearTree(msg);
+                }
+                arena->reset(ARENA_IDLE_LIMIT);
+            }
+        }});
+    }
+}
+
+/**
+ * @brief 1 cặp socket (AF_UNIX) cho benchmark framing, đóng khi benchmark bị hủy.
+ */
+struct SocketPair {
+    int fds[2] = {-1, -1};
+    SocketPair() {
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+            perror("socketpair");
+            std::exit(1);
+        }
+    }
+    ~SocketPair() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+};
+
+static void addFramingBenchmarks(std::vector<Benchmark>& out) {
+    const protocol::Encoding encodings[] = {protocol::Encoding::JSON, protocol::Encoding::MSGPACK};
+    for (protocol::Encoding enc : encodings) {
+        for (const auto& [name, msg] : sampleMessages()) {
+            auto pair = std::make_shared<SocketPair>();
+            auto reader = std::make_shared<protocol::FrameReader>();
+            std::string bench_name = std::string("frame/") + protocol::encodingName(enc) + "/" + name;
+            out.push_back({bench_name, [pair, reader, msg = msg, enc](size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (!protocol::sendMessage(pair->fds[0], msg, enc)) std::exit(1);
+                    g_sink += protocol::receiveMessage(pair->fds[1], *reader).size();
+                }
+            }});
+        }
+    }
+}
+
+/**
+ * @brief 1 lượt chơi phía server như Reactor::handleFrame + Server::handleAnswer:
+ * client gửi C2S_SUBMIT_ANSWER, server đọc frame, giải mã thành ArenaJson trong arena
+ * của kết nối, chấm, dựng S2C_ANSWER_RESULT, xếp hàng cùng frame câu hỏi kế tiếp
+ * (mã hóa sẵn như câu hỏi trong questions.bin) rồi flush; client đọc hết rồi bỏ.
+ */
+static void addRoundBenchmarks(std::vector<Benchmark>& out) {
+    const protocol::Encoding encodings[] = {protocol::Encoding::JSON, protocol::Encoding::MSGPACK};
+    for (protocol::Encoding enc : encodings) {
+        struct Round {
+            SocketPair pair;
+            protocol::FrameReader reader;
+            protocol::FrameWriter writer;
+            Arena arena;
+            std::string answer_frame;
+            protocol::PreparedFrame question;
+            char sink[16 * 1024];
+        };
+        auto round = std::make_shared<Round>();
+        json answer;
+        answer["action"] = protocol::C2S_SUBMIT_ANSWER;
+        answer["payload"]["question_id"] = "q042";
+        answer["payload"]["answer"] = "C";
+        protocol::appendFrame(round->answer_frame, answer, enc);
+        json question;
+        question["action"] = protocol::S2C_NEW_QUESTION;
+        question["payload"] = questionPayload(43);
+        round->question = protocol::prepareFrame(question);
+
+        out.push_back({std::string("round/") + protocol::encodingName(enc), [round, enc](size_t n) {
+            Round& r = *round;
+            for (size_t i = 0; i < n; ++i) {
+                if (write(r.pair.fds[0], r.answer_frame.data(), r.answer_frame.size()) < 0) std::exit(1);
+                const char* body;
+                size_t len;
+                while (r.reader.next(body, len) != protocol::FrameReader::Next::FRAME) {
+                    if (r.reader.fill(r.pair.fds[1]) <= 0) std::exit(1);
+                }
+                {
+                    Arena::Scope scope(r.arena);
+                    ArenaJson msg = protocol::decodeBody<ArenaJson>(body, len);
+                    const ArenaJson& payload = msg["payload"];
+                    bool is_correct = protocol::actionOf(msg) == protocol::C2S_SUBMIT_ANSWER &&
+                                      payload["question_id"].get_ref<const ArenaJson::string_t&>() == std::string_view("q042") &&
+                                      payload["answer"].get_ref<const ArenaJson::string_t&>() == std::string_view("C");
+                    ArenaJson reply;
+                    reply["action"] = protocol::S2C_ANSWER_RESULT;
+                    reply["payload"]["question_id"] = std::string_view("q042");
+                    reply["payload"]["is_correct"] = is_correct;
+                    reply["payload"]["new_score"] = static_cast<int>(i);
+                    r.writer.add(reply, enc);
+                    r.writer.add(r.question, enc);
+                    protocol::clearTree(reply);
+                    protocol::clearTree(msg);
+                }
+                r.arena.reset(ARENA_IDLE_LIMIT);
+
+                size_t queued = r.writer.pending();
+                if (r.writer.flush(r.pair.fds[1]) != protocol::FrameWriter::Status::DONE) std::exit(1);
+                for (size_t got = 0; got < queued;) {
+                    ssize_t k = read(r.pair.fds[0], r.sink, sizeof(r.sink));
+                    if (k <= 0) std::exit(1);
+                    got += k;
+                }
+                g_sink += queued;
+            }
+        }, true, true});
+    }
+}
+
+/**
+ * @brief CSDL user tạm (N tài khoản) cho các benchmark store/..., xóa khi không còn dùng.
+ */
+struct TempUserDb {
+    std::string path;
+    std::unique_ptr<UserDb> db;
+    std::vector<std::string> usernames;
+
+    TempUserDb(int users, int commit_interval_ms, size_t batch_size) {
+        char dir[] = "/tmp/microbench.XXXXXX";
+        if (!mkdtemp(dir)) {
+            perror("mkdtemp");
+            std::exit(1);
+        }
+        path = std::string(dir) + "/users.db";
+        db = std::make_unique<UserDb>(commit_interval_ms, batch_size);
+        if (!db->open(path)) {
+            std::cerr << "Cannot open " << path << std::endl;
+            std::exit(1);
+        }
+        std::vector<UserRecord> records(users);
+        for (int i = 0; i < users; ++i) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "user%07d", i);
+            records[i].username = name;
+            records[i].password = "pbkdf2-sha256$100000$c2FsdA$aGFzaA"; // Chỉ để record có kích thước thật
+            usernames.push_back(name);
+        }
+        if (!db->insertAll(records)) {
+            std::cerr << "Cannot populate " << path << std::endl;
+            std::exit(1);
+        }
+    }
+
+    ~TempUserDb() {
+        std::string dir = path.substr(0, path.rfind('/'));
+        db.reset(); // Commit nốt, đóng SQLite trước khi xóa file
+        for (const char* suffix : {"", "-wal", "-shm"}) {
+            unlink((path + suffix).c_str());
+        }
+        rmdir(dir.c_str());
+    }
+};
+
+static void addStoreBenchmarks(std::vector<Benchmark>& out, int max_users) {
+    // Dữ liệu chỉ tạo khi benchmark chạy lần đầu (bỏ qua nếu bị --filter loại)
+    for (int users : {1000, 10000, 100000}) {
+        if (users > max_users) continue;
+        std::string suffix = "/" + std::to_string(users);
+
+        auto warm = std::make_shared<std::unique_ptr<TempUserDb>>();
+        auto warm_store = std::make_shared<std::unique_ptr<UserStore>>();
+        auto warm_up = [=]() {
+            if (!*warm) {
+                *warm = std::make_unique<TempUserDb>(users, 10, 512);
+                *warm_store = std::make_unique<UserStore>(*(*warm)->db, users);
+                for (const auto& name : (*warm)->usernames) (*warm_store)->release((*warm_store)->acquire(name));
+            }
+        };
+        // Đăng nhập thứ i (phần tra tài khoản): user thứ (i * 7919) % N
+        auto login = [=](size_t i) {
+            const auto& names = (*warm)->usernames;
+            int index = (*warm_store)->acquire(names[(i * 7919) % names.size()]);
+            g_sink += (*warm_store)->withRecord(index, [](UserRecord& r) {
+                return r.password.size() + (r.status == UserStatus::BLOCKED);
+            });
+            (*warm_store)->release(index);
+        };
+        out.push_back({"store/login" + suffix, [=](size_t n) {
+            warm_up();
+            for (size_t i = 0; i < n; ++i) login(i);
+        }});
+        // Như trên nhưng LOGIN_THREADS thread cùng lúc (các user khác nhau): đo tranh khóa của cache
+        out.push_back({"store/login-" + std::to_string(LOGIN_THREADS) + "t" + suffix, [=](size_t n) {
+            warm_up();
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < LOGIN_THREADS; ++t) {
+                threads.emplace_back([=]() {
+                    for (size_t i = t; i < n; i += LOGIN_THREADS) login(i);
+                });
+            }
+            for (auto& th : threads) th.join();
+        }});
+
+        auto cold = std::make_shared<std::unique_ptr<TempUserDb>>();
+        auto cold_store = std::make_shared<std::unique_ptr<UserStore>>();
+        out.push_back({"store/login-miss" + suffix, [=, next = size_t(0)](size_t n) mutable {
+            if (!*cold) {
+                *cold = std::make_unique<TempUserDb>(users, 10, 512);
+                *cold_store = std::make_unique<UserStore>(*(*cold)->db, 64);
+            }
+            const auto& names = (*cold)->usernames;
+            for (size_t i = 0; i < n; ++i) {
+                // Bước nhảy lớn hơn cỡ cache: lần nào cũng là cache miss
+                int index = (*cold_store)->acquire(names[(next++ * 7919) % names.size()]);
+                g_sink += (*cold_store)->withRecord(index, [](UserRecord& r) { return r.password.size(); });
+                (*cold_store)->release(index);
+            }
+        }});
+
+        for (size_t batch : {size_t(1), size_t(64)}) {
+            auto db = std::make_shared<std::unique_ptr<TempUserDb>>();
+            out.push_back({"store/commit" + suffix + "/" + std::to_string(batch), [=, score = 0](size_t n) mutable {
+                // Writer commit ngay khi đủ 'batch' user thay đổi (không chờ hết chu kỳ)
+                if (!*db) *db = std::make_unique<TempUserDb>(users, 1000, batch);
+                const auto& names = (*db)->usernames;
+                for (size_t i = 0; i < n; ++i) {
+                    uint64_t seq = 0;
+                    ++score;
+                    for (size_t b = 0; b < batch; ++b) {
+                        seq = (*db)->db->saveScore(names[(i * batch + b) % names.size()], score);
+                    }
+                    if (!(*db)->db->waitDurable(seq, std::chrono::seconds(10))) {
+                        std::cerr << "store/commit: commit did not complete" << std::endl;
+                        std::exit(1);
+                    }
+                }
+            }, false});
+        }
+    }
+}
+
+// ==========================================================
+// BASELINE
+// ==========================================================
+
+static bool loadBaseline(const std::string& path, std::map<std::string, Result>& out) {
+    std::ifstream f(path);
+    if (!f.is_open()) return false;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream in(line);
+        std::string name;
+        Result r;
+        if (in >> name >> r.ns_per_op >> r.allocs_per_op >> r.bytes_per_op) {
+            out[name] = r;
+        }
+    }
+    return true;
+}
+
+static bool saveBaseline(const std::string& path, const std::vector<std::pair<std::string, Result>>& results) {
+    std::ofstream o(path);
+    o << "# bin/microbench baseline (make microbench-baseline): name ns/op allocs/op bytes/op\n";
+    o << std::fixed << std::setprecision(2);
+    for (const auto& [name, r] : results) {
+        o << name << ' ' << r.ns_per_op << ' ' << r.allocs_per_op << ' ' << r.bytes_per_op << '\n';
+    }
+    return static_cast<bool>(o);
+}
+
+static void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --filter S           Only run benchmarks whose name contains S\n"
+              << "  --min-time MS        Minimum measuring time per run (default 200)\n"
+              << "  --repeat N           Runs per benchmark, the fastest is reported (default 3)\n"
+              << "  --max-users N        Skip store benchmarks with more users (default 100000)\n"
+              << "  --baseline PATH      Compare allocs/op and bytes/op with a saved baseline; exit 1 on regression\n"
+              << "  --threshold F        Also fail when slower than the baseline by more than F, 0.25 = 25%\n"
+              << "                       (off by default: only use with a baseline recorded on this machine)\n"
+              << "  --save-baseline PATH Write the results as the new baseline\n";
+}
+
+int main(int argc, char* argv[]) {
+    MicroConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--filter") config.filter = value;
+            else if (arg == "--min-time") config.min_time_ms = std::stoi(value);
+            else if (arg == "--repeat") config.repeat = std::max(1, std::stoi(value));
+            else if (arg == "--max-users") config.max_users = std::stoi(value);
+            else if (arg == "--baseline") config.baseline = value;
+            else if (arg == "--threshold") config.threshold = std::stod(value);
+            else if (arg == "--save-baseline") config.save_baseline = value;
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception&) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::map<std::string, Result> baseline;
+    if (!config.baseline.empty() && !loadBaseline(config.baseline, baseline)) {
+        std::cerr << "No baseline at " << config.baseline << " (record one with --save-baseline, see make microbench-baseline); "
+                  << "running without comparison." << std::endl;
+    }
+
+    std::vector<Benchmark> benchmarks;
+    addCodecBenchmarks(benchmarks);
+    addFramingBenchmarks(benchmarks);
+    addRoundBenchmarks(benchmarks);
+    addStoreBenchmarks(benchmarks, config.max_users);
+
+    std::cout << std::left << std::setw(32) << "benchmark" << std::right
+              << std::setw(14) << "ns/op" << std::setw(12) << "allocs/op" << std::setw(12) << "bytes/op"
+              << (baseline.empty() ? "" : "   vs baseline") << std::endl;
+
+    std::vector<std::pair<std::string, Result>> results;
+    int regressions = 0;
+    for (const Benchmark& bench : benchmarks) {
+        if (bench.name.find(config.filter) == std::string::npos) continue;
+        Result r = measure(bench, config.min_time_ms, config.repeat);
+        results.emplace_back(bench.name, r);
+
+        std::cout << std::left << std::setw(32) << bench.name << std::right << std::fixed
+                  << std::setw(14) << std::setprecision(1) << r.ns_per_op
+                  << std::setw(12) << std::setprecision(2) << r.allocs_per_op
+                  << std::setw(12) << std::setprecision(0) << r.bytes_per_op;
+        auto it = baseline.find(bench.name);
+        if (it != baseline.end()) {
+            const Result& base = it->second;
+            double delta = base.ns_per_op > 0 ? (r.ns_per_op / base.ns_per_op - 1) * 100 : 0;
+            // Cấp phát không đổi giữa các máy và các lần chạy: luôn so sánh, chặt.
+            // Thời gian phụ thuộc máy: chỉ so khi có --threshold (baseline của chính máy này)
+            bool more_allocs = r.allocs_per_op > base.allocs_per_op * (1 + ALLOC_TOLERANCE) + 0.5;
+            bool more_bytes = r.bytes_per_op > base.bytes_per_op * (1 + ALLOC_TOLERANCE) + BYTES_SLACK;
+            bool slower = config.threshold >= 0 && bench.time_gated &&
+                          r.ns_per_op > base.ns_per_op * (1 + config.threshold);
+            std::cout << "   " << std::showpos << std::setprecision(1) << delta << "%" << std::noshowpos;
+            if (more_allocs || more_bytes || slower) {
+                std::cout << (more_allocs ? "  REGRESSION (allocs)" : more_bytes ? "  REGRESSION (bytes)" : "  REGRESSION (time)");
+                regressions++;
+            } else if (config.threshold >= 0 && !bench.time_gated) {
+                std::cout << "  (fsync: time not compared)";
+            }
+        } else if (!baseline.empty()) {
+            std::cout << "   (new)";
+        }
+        if (bench.zero_alloc && r.allocs_per_op > 0) {
+            std::cout << "  FAILED (expected 0 allocs/op)";
+            regressions++;
+        }
+        std::cout << std::endl;
+    }
+
+    if (!config.save_baseline.empty()) {
+        if (!saveBaseline(config.save_baseline, results)) {
+            std::cerr << "Cannot write " << config.save_baseline << std::endl;
+            return 1;
+        }
+        std::cout << "Saved " << results.size() << " result(s) to " << config.save_baseline << std::endl;
+    }
+    if (regressions > 0) {
+        std::cout << regressions << " benchmark(s) regressed"
+                  << (config.baseline.empty() ? "" : " vs " + config.baseline) << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <cstdlib>   // Cho std::atoi
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -10,13 +11,105 @@
 #define SERVER_IP "127.0.0.1" 
 #define PORT 8081 
 
-using json = nlohmann::json;
+
+// Encoding dùng cho các thông điệp gửi server (chọn qua HELLO)
+static protocol::Encoding g_encoding = protocol::Encoding::JSON;
+// Bộ đệm nhận của kết nối tới server
+static protocol::FrameReader g_reader;
+// Số câu mỗi lượt speed round (0 = chơi từng câu), đọc từ dòng lệnh
+static int g_speed_round = 0;
+// Phòng chơi nhiều người (rỗng = chơi 1 mình), đọc từ dòng lệnh
+static std::string g_room;
+// --leaderboard: chỉ xem bảng xếp hạng (và hạng của g_rank_user nếu có), không chơi
+static bool g_leaderboard = false;
+static std::string g_rank_user;
+// Token server cấp khi đăng nhập; dùng để khôi phục phiên nếu kết nối rớt giữa ván
+static std::string g_resume_token;
 
 // --- Khai báo ---
+json receiveFromServer(int sock);
+int connectToServer();
+bool negotiateEncoding(int sock);
 bool handleLogin(int sock);
-void handleGame(int sock);
+bool resumeSession(int sock);
+bool handleGame(int sock);
+bool answerBatch(int sock, const json& batch);
+void showLeaderboard(int sock);
+
+int main(int argc, char* argv[]) {
+    // Tùy chọn: ./client [số câu mỗi lượt speed round], ./client --room TÊN_PHÒNG
+    // hoặc ./client --leaderboard [USERNAME]
+    if (argc == 3 && std::string(argv[1]) == "--room") {
+        g_room = argv[2];
+    } else if (argc >= 2 && argc <= 3 && std::string(argv[1]) == "--leaderboard") {
+        g_leaderboard = true;
+        if (argc == 3) g_rank_user = argv[2];
+    } else if (argc > 1) {
+        g_speed_round = std::atoi(argv[1]);
+        if (argc > 2 || g_speed_round < 0 || g_speed_round > protocol::MAX_SPEED_ROUND) {
+            std::cerr << "Usage: " << argv[0] << " [speed_round_size 1-" << protocol::MAX_SPEED_ROUND
+                      << " | --room NAME | --leaderboard [USERNAME]]" << std::endl;
+            return -1;
+        }
+    }
+
+    int sock = connectToServer();
+    if (sock < 0) {
+        return -1;
+    }
+
+    if (g_leaderboard) {
+        showLeaderboard(sock); // Không cần đăng nhập
+        close(sock);
+        return 0;
+    }
+
+    // 1. Thực hiện đăng nhập
+    if (handleLogin(sock)) {
+        // 2. Nếu đăng nhập OK, bắt đầu game; rớt kết nối giữa ván thì thử khôi phục phiên
+        int retries = 0;
+        while (!handleGame(sock) && !g_resume_token.empty() && retries++ < 3) {
+            close(sock);
+            std::cout << "Reconnecting..." << std::endl;
+            sleep(1);
+            sock = connectToServer();
+            if (sock < 0 || !resumeSession(sock)) break;
+        }
+    } else {
+        // Đăng nhập thất bại (bị khóa hoặc ngắt kết nối)
+        std::cout << "Login failed or account is locked. Exiting." << std::endl;
+    }
+
+    // Đóng kết nối
+    std::cout << "Game over. Disconnecting." << std::endl;
+    if (sock >= 0) close(sock);
+    return 0;
+}
+
+/**
+ * @brief Nhận thông điệp tiếp theo; S2C_PING (heartbeat) được trả lời C2S_PONG và bỏ qua.
+ * @return JSON rỗng nếu mất kết nối.
+ */
+json receiveFromServer(int sock) {
+    while (true) {
+        json msg = protocol::receiveMessage(sock, g_reader);
+        if (msg.empty() || protocol::actionOf(msg) != protocol::S2C_PING) {
+            return msg;
+        }
+        json pong;
+        pong["action"] = protocol::C2S_PONG;
+        pong["payload"] = json::object();
+        if (!protocol::sendMessage(sock, pong, g_encoding)) {
+            return json();
+        }
+    }
+}
 
-int main() {
+/**
+ * @brief Kết nối tới server và thỏa thuận encoding.
+ * @return Socket, hoặc -1 nếu thất bại.
+ */
+int connectToServer() {
     int sock = 0;
     sockaddr_in serv_addr;
 
@@ -30,29 +123,51 @@ int main() {
 
     if (inet_pton(AF_INET, SERVER_IP, &serv_addr.sin_addr) <= 0) {
         perror("Invalid address/ Address not supported");
+        close(sock);
         return -1;
     }
 
     if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
         perror("Connection Failed");
+        close(sock);
         return -1;
     }
 
     std::cout << "Connected to server..." << std::endl;
+    protocol::setNoDelay(sock); // Gửi câu trả lời ngay, không chờ Nagle
 
-    // 1. Thực hiện đăng nhập
-    if (handleLogin(sock)) {
-        // 2. Nếu đăng nhập OK, bắt đầu game
-        handleGame(sock);
-    } else {
-        // Đăng nhập thất bại (bị khóa hoặc ngắt kết nối)
-        std::cout << "Login failed or account is locked. Exiting." << std::endl;
+    // 0. Đề nghị dùng MessagePack (server cũ/không hỗ trợ thì tiếp tục JSON)
+    g_reader = protocol::FrameReader();
+    if (!negotiateEncoding(sock)) {
+        std::cout << "Server disconnected." << std::endl;
+        close(sock);
+        return -1;
     }
+    return sock;
+}
 
-    // Đóng kết nối
-    std::cout << "Game over. Disconnecting." << std::endl;
-    close(sock);
-    return 0;
+
+/**
+ * @brief Gửi C2S_HELLO (JSON) và chờ S2C_HELLO để biết encoding server chọn.
+ * @return false nếu mất kết nối
+ */
+bool negotiateEncoding(int sock) {
+    json hello;
+    hello["action"] = protocol::C2S_HELLO;
+    hello["payload"]["encodings"] = {protocol::encodingName(protocol::Encoding::MSGPACK)};
+    if (!protocol::sendMessage(sock, hello)) {
+        return false;
+    }
+
+    json r_msg = receiveFromServer(sock);
+    if (r_msg.empty()) {
+        return false;
+    }
+    if (r_msg["action"] == protocol::S2C_HELLO &&
+        r_msg["payload"]["encoding"] == protocol::encodingName(protocol::Encoding::MSGPACK)) {
+        g_encoding = protocol::Encoding::MSGPACK;
+    }
+    return true;
 }
 
 
@@ -79,14 +194,20 @@ bool handleLogin(int sock) {
         login_msg["action"] = protocol::C2S_LOGIN_REQUEST;
         login_msg["payload"]["username"] = username;
         login_msg["payload"]["password"] = password;
+        if (g_speed_round > 0) {
+            login_msg["payload"]["speed_round"] = g_speed_round;
+        }
+        if (!g_room.empty()) {
+            login_msg["payload"]["room"] = g_room;
+        }
 
-        if (!protocol::sendMessage(sock, login_msg)) {
+        if (!protocol::sendMessage(sock, login_msg, g_encoding)) {
             std::cout << "Server disconnected." << std::endl;
             return false;
         }
 
         // Chờ phản hồi
-        json r_msg = protocol::receiveMessage(sock);
+        json r_msg = receiveFromServer(sock);
         if (r_msg.empty()) {
              std::cout << "Server disconnected." << std::endl;
              return false;
@@ -96,7 +217,13 @@ bool handleLogin(int sock) {
         
         if (action == protocol::S2C_LOGIN_SUCCESS) {
             std::cout << "=> " << r_msg["payload"]["message"] << " Starting game..." << std::endl;
+            g_resume_token = r_msg["payload"].value("resume_token", "");
             is_logged_in = true;
+        } else if (action == protocol::S2C_SERVER_BUSY) {
+            // Server quá tải và sẽ đóng kết nối
+            std::string message = r_msg["payload"]["message"];
+            std::cout << "=> " << message << std::endl;
+            return false;
         } else { // S2C_LOGIN_FAILURE
             std::string message = r_msg["payload"]["message"];
             std::cout << "=> Login failed: " << message << std::endl;
@@ -112,18 +239,39 @@ bool handleLogin(int sock) {
 }
 
 
+/**
+ * @brief Gửi C2S_RESUME_REQUEST với token đã lưu (sau khi kết nối lại).
+ * @return true nếu server khôi phục được phiên (tiếp tục handleGame).
+ */
+bool resumeSession(int sock) {
+    json request;
+    request["action"] = protocol::C2S_RESUME_REQUEST;
+    request["payload"]["resume_token"] = g_resume_token;
+    if (!protocol::sendMessage(sock, request, g_encoding)) return false;
+
+    json r_msg = receiveFromServer(sock);
+    if (r_msg.empty() || r_msg["action"] != protocol::S2C_LOGIN_SUCCESS) {
+        std::cout << "=> Could not resume the session." << std::endl;
+        return false;
+    }
+    g_resume_token = r_msg["payload"].value("resume_token", "");
+    std::cout << "=> " << r_msg["payload"]["message"] << " Your score: " << r_msg["payload"]["score"] << std::endl;
+    return true;
+}
+
 /**
  * @brief HÀM CŨ: Đã sửa thành vòng lặp game
+ * @return false nếu mất kết nối giữa ván (có thể khôi phục), true nếu game kết thúc.
  */
-void handleGame(int sock) {
+bool handleGame(int sock) {
     
     // Vòng lặp game: Client chỉ phản ứng lại tin nhắn của Server
     while (true) {
         // 1. Chờ nhận tin nhắn (hoặc câu hỏi, hoặc kết quả)
-        json msg = protocol::receiveMessage(sock);
+        json msg = receiveFromServer(sock);
         if (msg.empty()) {
             std::cout << "Server disconnected." << std::endl;
-            break;
+            return false;
         }
 
         std::string action = msg["action"];
@@ -150,11 +298,24 @@ void handleGame(int sock) {
             a_msg["payload"]["question_id"] = q_id;
             a_msg["payload"]["answer"] = user_answer;
             
-            if (!protocol::sendMessage(sock, a_msg)) {
+            if (!protocol::sendMessage(sock, a_msg, g_encoding)) {
                 std::cout << "Failed to send answer." << std::endl;
-                break;
+                return false;
             }
         } 
+        // TH2a: Kết quả trong phòng chơi nhiều người (sai không kết thúc game)
+        else if (action == protocol::S2C_ANSWER_RESULT && msg["payload"].contains("room")) {
+            if (msg["payload"].value("round_over", false)) {
+                std::cout << "=> Too late, that round is over." << std::endl;
+            } else if (msg["payload"].value("timed_out", false)) {
+                std::cout << "=> Time's up! Waiting for the other players..." << std::endl;
+            } else if (msg["payload"]["is_correct"]) {
+                std::cout << "=> Correct! You won this round. Room points: "
+                          << msg["payload"]["new_score"] << std::endl;
+            } else {
+                std::cout << "=> Wrong! Waiting for the other players..." << std::endl;
+            }
+        }
         // TH2: Server gửi kết quả
         else if (action == protocol::S2C_ANSWER_RESULT) {
             bool is_correct = msg["payload"]["is_correct"];
@@ -167,17 +328,124 @@ void handleGame(int sock) {
             } else {
                 // Trả lời sai, kết thúc game
                 int final_score = msg["payload"]["final_score"];
-                std::cout << "=> Wrong! The correct answer was: " 
+                std::cout << (msg["payload"].value("timed_out", false) ? "=> Time's up!" : "=> Wrong!")
+                          << " The correct answer was: " 
                           << msg["payload"]["correct_answer"] << std::endl;
                 std::cout << "--- GAME OVER ---" << std::endl;
                 std::cout << "Final Score: " << final_score << std::endl;
                 break; // Thoát khỏi vòng lặp game
             }
         } 
-        // TH3: Lệnh lạ (không mong muốn)
+        // TH3: Speed round - nhận N câu, trả lời cả N câu trong 1 frame
+        else if (action == protocol::S2C_QUESTION_BATCH) {
+            if (!answerBatch(sock, msg)) {
+                std::cout << "Failed to send answers." << std::endl;
+                return false;
+            }
+        }
+        // TH4: Kết quả của cả lượt speed round
+        else if (action == protocol::S2C_BATCH_RESULT) {
+            for (const auto& r : msg["payload"]["results"]) {
+                if (r["is_correct"]) {
+                    std::cout << "=> " << r["question_id"] << ": Correct!" << std::endl;
+                } else {
+                    std::cout << "=> " << r["question_id"] << ": Wrong! The correct answer was: "
+                              << r["correct_answer"] << std::endl;
+                }
+            }
+
+            if (!msg["payload"]["game_over"]) {
+                int new_score = msg["payload"]["new_score"];
+                std::cout << "=> Round cleared! Your score: " << new_score << std::endl;
+            } else {
+                int final_score = msg["payload"]["final_score"];
+                if (msg["payload"].value("timed_out", false)) {
+                    std::cout << "=> Time's up!" << std::endl;
+                }
+                std::cout << "--- GAME OVER ---" << std::endl;
+                std::cout << "Final Score: " << final_score << std::endl;
+                break;
+            }
+        }
+        // TH5: Bảng điểm của phòng (sau mỗi lượt, hoặc khi có người vào/ra)
+        else if (action == protocol::S2C_ROOM_STANDINGS) {
+            const json& p = msg["payload"];
+            if (p.contains("correct_answer")) {
+                std::string winner = p["winner"];
+                std::cout << "\n=> Round over. The answer was " << p["correct_answer"] << ". "
+                          << (winner.empty() ? "Nobody got it." : "Winner: " + winner) << std::endl;
+            }
+            std::cout << "--- ROOM " << p["room"] << " STANDINGS ---" << std::endl;
+            for (const auto& row : p["standings"]) {
+                std::cout << "  " << row["username"] << ": " << row["points"] << std::endl;
+            }
+        }
+        // TH6: Lệnh lạ (không mong muốn)
         else {
             std::cout << "Received unexpected message: " << msg.dump(2) << std::endl;
             break;
         }
     } // Kết thúc while(true)
+    return true;
+}
+
+/**
+ * @brief Hiện cả lượt speed round, hỏi lần lượt từng câu rồi gửi mọi câu trả lời
+ * trong 1 frame C2S_SUBMIT_BATCH.
+ * @return false nếu gửi thất bại
+ */
+bool answerBatch(int sock, const json& batch) {
+    const json& questions = batch["payload"]["questions"];
+    std::cout << "\n--- SPEED ROUND: " << questions.size() << " QUESTIONS ---" << std::endl;
+
+    json b_msg;
+    b_msg["action"] = protocol::C2S_SUBMIT_BATCH;
+    json& answers = b_msg["payload"]["answers"] = json::array();
+    int number = 1;
+    for (const auto& q : questions) {
+        std::cout << "\n[" << number++ << "] " << q["question_text"] << std::endl;
+        for (auto& [key, value] : q["options"].items()) {
+            std::cout << key << ". " << value << std::endl;
+        }
+
+        std::string user_answer;
+        std::cout << "\nYour answer (A, B, C...): ";
+        std::getline(std::cin, user_answer);
+        answers.push_back({{"question_id", q["question_id"]}, {"answer", user_answer}});
+    }
+
+    return protocol::sendMessage(sock, b_msg, g_encoding);
+}
+
+/**
+ * @brief In top 10 của bảng xếp hạng, và hạng của g_rank_user nếu có.
+ */
+void showLeaderboard(int sock) {
+    json request;
+    request["action"] = protocol::C2S_LEADERBOARD_REQUEST;
+    request["payload"]["limit"] = 10;
+    if (!protocol::sendMessage(sock, request, g_encoding)) return;
+    json msg = receiveFromServer(sock);
+    if (msg.empty()) {
+        std::cout << "Server disconnected." << std::endl;
+        return;
+    }
+    std::cout << "--- LEADERBOARD (" << msg["payload"]["total"] << " players) ---" << std::endl;
+    for (const auto& row : msg["payload"]["entries"]) {
+        std::cout << "  #" << row["rank"] << " " << row["username"] << ": " << row["score"] << std::endl;
+    }
+
+    if (g_rank_user.empty()) return;
+    request = json();
+    request["action"] = protocol::C2S_RANK_REQUEST;
+    request["payload"]["username"] = g_rank_user;
+    if (!protocol::sendMessage(sock, request, g_encoding)) return;
+    msg = receiveFromServer(sock);
+    if (msg.empty()) return;
+    if (msg["payload"]["rank"] == 0) {
+        std::cout << "=> User " << g_rank_user << " not found." << std::endl;
+    } else {
+        std::cout << "=> " << g_rank_user << " is #" << msg["payload"]["rank"] << " with "
+                  << msg["payload"]["score"] << " point(s)." << std::endl;
+    }
 }
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Giới hạn kết nối và đăng nhập, kiểm tra ngay khi accept (trước khi
+ * tạo Connection hay đăng ký epoll) để tải vượt mức bị từ chối với chi phí
+ * thấp nhất: 1 frame S2C_SERVER_BUSY mã hóa sẵn rồi đóng socket.
+ *
+ * - max_connections: tổng số kết nối đang mở của cả server (0 = không giới hạn).
+ * - ip_connections: số kết nối đang mở của 1 địa chỉ IP (0 = không giới hạn).
+ * - ip_connect_rate / ip_login_rate: token bucket theo IP (số lần mỗi giây,
+ *   bucket chứa tối đa 2 giây; 0 = tắt).
+ *
+ * Trạng thái theo IP chia thành SHARDS phần, mỗi phần 1 mutex (như
+ * SessionRegistry); tổng số kết nối là 1 biến atomic, kiểm tra không cần khóa.
+ */
+class AdmissionControl {
+public:
+    struct Limits {
+        size_t max_connections = 0;
+        size_t ip_connections = 0;
+        double ip_connect_rate = 0;
+        double ip_login_rate = 0;
+    };
+
+    enum class Verdict {
+        ADMITTED,
+        SERVER_FULL, // Vượt max_connections
+        IP_LIMIT,    // Vượt ip_connections
+        RATE_LIMIT   // Hết token kết nối của IP
+    };
+
+    explicit AdmissionControl(const Limits& limits);
+
+    /**
+     * @brief Kiểm tra kết nối mới từ 'ip' (IPv4, network byte order).
+     * ADMITTED thì đã tính kết nối vào các giới hạn: phải gọi release() khi đóng.
+     */
+    Verdict admit(uint32_t ip);
+
+    /**
+     * @brief Kết nối của 'ip' đã đóng.
+     */
+    void release(uint32_t ip);
+
+    /**
+     * @brief Lấy 1 token đăng nhập của 'ip'.
+     * @return false nếu IP đăng nhập quá nhanh.
+     */
+    bool allowLogin(uint32_t ip);
+
+    /**
+     * @brief Xóa trạng thái của các IP không còn kết nối và đã hồi đầy token.
+     */
+    void sweep();
+
+    /**
+     * @brief Frame từ chối (JSON: client chưa kịp chọn encoding) ứng với 'verdict'.
+     */
+    const std::string& rejection(Verdict verdict) const;
+
+    size_t connections() const { return active.load(std::memory_order_relaxed); }
+
+private:
+    struct Bucket {
+        double tokens = -1; // < 0 = chưa dùng (đầy)
+        uint64_t updated = 0;
+
+        bool take(double rate, uint64_t now);
+        bool full(double rate, uint64_t now) const;
+    };
+
+    struct Peer {
+        size_t connections = 0;
+        Bucket connect;
+        Bucket login;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, Peer> peers;
+    };
+    static const size_t SHARDS = 64;
+
+    Shard& shardFor(uint32_t ip) { return shards[(ip * 0x9E3779B1u) >> 26]; }
+
+    const Limits limits;
+    std::atomic<size_t> active{0};
+    Shard shards[SHARDS];
+    std::shared_ptr<const std::string> frames[4]; // Theo thứ tự của Verdict
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/**
+ * @brief Vùng nhớ cấp phát tuần tự (monotonic arena) của 1 kết nối: cấp phát
+ * chỉ là tăng con trỏ, giải phóng từng phần không làm gì, reset() thu hồi tất
+ * cả một lần sau mỗi thông điệp. Block được giữ lại qua các lần reset() nên ở
+ * trạng thái ổn định không còn gọi tới heap chung (malloc).
+ *
+ * Thread đang xử lý thông điệp đặt arena "hiện tại" bằng Arena::Scope; mọi
+ * ArenaAllocator (json, ArenaString) trên thread đó lấy bộ nhớ từ arena này,
+ * không có Scope thì dùng heap chung như std::allocator.
+ *
+ * Không an toàn đa luồng: tại 1 thời điểm chỉ 1 thread dùng 1 arena.
+ * Object cấp phát trong Scope KHÔNG được sống qua reset() (không lưu json của
+ * thông điệp vào Session, Room, lambda gửi sang thread khác...).
+ */
+class Arena {
+public:
+    Arena() = default;
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief Cấp 'bytes' byte (căn lề theo max_align_t), hết chỗ thì thêm block mới.
+     */
+    void* allocate(size_t bytes);
+
+    /**
+     * @brief Thu hồi mọi thứ đã cấp. Nếu thông điệp vừa rồi cần nhiều block thì
+     * gộp thành 1 block đủ lớn cho lần sau; tổng lớn hơn 'idle_limit' thì trả
+     * lại hết cho heap (giữ bộ nhớ phẳng như các buffer khác của kết nối).
+     */
+    void reset(size_t idle_limit);
+
+    size_t capacity() const { return total; } // Tổng kích thước các block đang giữ
+
+    /**
+     * @brief Arena hiện tại của thread (nullptr = dùng heap chung).
+     */
+    static Arena* current();
+
+    /**
+     * @brief Đặt 'arena' làm arena hiện tại của thread trong phạm vi của Scope.
+     */
+    class Scope {
+    public:
+        explicit Scope(Arena& arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Arena* previous;
+    };
+
+private:
+    struct Block {
+        Block* next;
+        size_t size; // Số byte dữ liệu (sau header của block)
+    };
+
+    // Block nhỏ nhất: đủ cho 1 lượt chơi thông thường (câu trả lời nhận được + kết quả gửi đi, ~3KB)
+    static const size_t MIN_BLOCK = 4 * 1024;
+
+    void addBlock(size_t min_bytes);
+    void freeBlocks();
+
+    Block* blocks = nullptr; // Block đang cấp phát nằm đầu danh sách
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t total = 0;
+    size_t block_count = 0;
+};
+
+namespace arena {
+    /**
+     * @brief Cấp phát cho ArenaAllocator: từ Arena::current() nếu có, không thì từ heap chung.
+     * Mỗi vùng có 1 header nhỏ ghi nguồn gốc, nên deallocate() đúng cả khi arena
+     * hiện tại lúc giải phóng khác lúc cấp phát (ví dụ json tĩnh tạo ngoài Scope).
+     */
+    void* allocate(size_t bytes);
+    void deallocate(void* p) noexcept;
+}
+
+/**
+ * @brief Allocator không trạng thái, lấy bộ nhớ từ Arena::current() (xem arena::allocate).
+ * Dùng làm AllocatorType của json để cây JSON của 1 thông điệp nằm trọn trong arena.
+ */
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator() noexcept = default;
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena::allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t) noexcept { arena::deallocate(p); }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>&) const noexcept { return false; }
+};
+
+/**
+ * @brief Chuỗi của json (action, key, giá trị, kết quả dump()), cấp phát qua ArenaAllocator.
+ * Đổi ngầm qua lại với std::string để code cũ dùng json như trước; mỗi lần đổi là
+ * 1 bản chép (có thể ra heap chung), nên đường nóng đọc/so sánh qua std::string_view
+ * (so sánh trực tiếp với std::string không có sẵn vì khác allocator).
+ */
+class ArenaString : public std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> {
+public:
+    using Base = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+    using Base::Base;
+
+    ArenaString() = default;
+    ArenaString(const Base& s) : Base(s) {}
+    ArenaString(Base&& s) noexcept : Base(std::move(s)) {}
+    ArenaString(const std::string& s) : Base(s.data(), s.size()) {}
+
+    operator std::string() const { return std::string(data(), size()); }
+};
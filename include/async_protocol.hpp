@@ -0,0 +1,25 @@
+#pragma once
+
+#include "coro.hpp"
+#include "protocol.hpp"
+
+/**
+ * @brief Bản coroutine (C++20) của sendMessage/receiveMessage: cùng định dạng
+ * frame, nhưng treo coroutine thay cho chặn thread khi socket chưa sẵn sàng.
+ */
+namespace protocol {
+
+    /**
+     * @brief Gửi một thông điệp (xử lý partial write, chờ EPOLLOUT khi socket đầy).
+     * 'j' được mã hóa ngay khi bắt đầu co_await, không cần sống lâu hơn.
+     * @return false nếu mất kết nối.
+     */
+    coro::Task<bool> asyncSendMessage(coro::Socket& socket, const json& j, Encoding enc = Encoding::JSON);
+
+    /**
+     * @brief Nhận một thông điệp, JSON hoặc MessagePack.
+     * Dữ liệu đọc dư (frame sau) được giữ lại trong 'reader' cho lần gọi tiếp.
+     * @return JSON rỗng nếu mất kết nối hoặc thông điệp lỗi.
+     */
+    coro::Task<json> asyncReceiveMessage(coro::Socket& socket, FrameReader& reader);
+}
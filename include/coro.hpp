@@ -0,0 +1,243 @@
+#pragma once
+
+#if __cplusplus < 202002L
+#error "coro.hpp requires C++20 (-std=c++20)"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include <netinet/in.h>
+
+/**
+ * @brief Runtime coroutine C++20 nhỏ cho socket non-blocking: 1 thread
+ * (1 EventLoop, 1 epoll) chạy hàng nghìn phiên, mỗi phiên viết tuần tự như
+ * code dùng socket blocking nhưng "co_await" thay cho chờ.
+ *
+ *     coro::Task<void> session(coro::EventLoop& loop) {
+ *         coro::Socket socket(loop);
+ *         if (!co_await socket.connect(addr)) co_return;
+ *         co_await protocol::asyncSendMessage(socket, login);
+ *         json reply = co_await protocol::asyncReceiveMessage(socket, reader);
+ *         ...
+ *     }
+ *     loop.spawn(session(loop));
+ *     loop.run(stop);
+ *
+ * Mọi thứ (Task, Socket, EventLoop) chỉ dùng trên thread chạy loop.run().
+ * Quy ước: luôn thử đọc/ghi trước, chỉ co_await readable()/writable() sau
+ * khi gặp EAGAIN (epoll edge-triggered, không giữ lại sự kiện đã qua).
+ */
+namespace coro {
+
+    using Clock = std::chrono::steady_clock;
+
+    template <typename T = void>
+    class Task;
+
+    namespace detail {
+        struct PromiseBase {
+            std::coroutine_handle<> continuation; // Coroutine đang co_await task này
+            std::exception_ptr error;
+
+            // Task lười: chỉ chạy khi được co_await (hoặc EventLoop::spawn)
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            // Xong thì chạy tiếp ngay coroutine đang chờ (symmetric transfer, không đệ quy stack)
+            struct FinalAwaiter {
+                bool await_ready() noexcept { return false; }
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+                    std::coroutine_handle<> next = h.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct Promise : PromiseBase {
+            std::optional<T> value;
+            Task<T> get_return_object();
+            void return_value(T v) { value.emplace(std::move(v)); }
+            T result() {
+                if (error) std::rethrow_exception(error);
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct Promise<void> : PromiseBase {
+            Task<void> get_return_object();
+            void return_void() {}
+            void result() {
+                if (error) std::rethrow_exception(error);
+            }
+        };
+    }
+
+    /**
+     * @brief Kết quả của 1 coroutine: co_await để chạy nó và lấy giá trị
+     * (ngoại lệ bên trong được ném lại ở chỗ co_await). Task sở hữu frame
+     * của coroutine; hủy Task là hủy frame (kể cả khi đang treo).
+     */
+    template <typename T>
+    class Task {
+    public:
+        using promise_type = detail::Promise<T>;
+
+        explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+        Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                if (handle) handle.destroy();
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+        ~Task() {
+            if (handle) handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) noexcept {
+            handle.promise().continuation = waiter;
+            return handle; // Chạy task ngay trên thread hiện tại
+        }
+        T await_resume() { return handle.promise().result(); }
+
+    private:
+        friend class EventLoop;
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    namespace detail {
+        template <typename T>
+        Task<T> Promise<T>::get_return_object() {
+            return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+        }
+        inline Task<void> Promise<void>::get_return_object() {
+            return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+        }
+    }
+
+    class Socket;
+
+    /**
+     * @brief Vòng lặp epoll + hàng đợi timer, chạy các coroutine gốc (spawn).
+     */
+    class EventLoop {
+    public:
+        EventLoop();
+        ~EventLoop(); // Hủy mọi coroutine gốc (đóng luôn các Socket trong frame của chúng)
+        EventLoop(const EventLoop&) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+
+        /**
+         * @brief Chạy 'task' ngay tới lần co_await đầu tiên; EventLoop giữ frame của nó.
+         * Ngoại lệ thoát khỏi task được in ra stderr.
+         */
+        void spawn(Task<void> task);
+
+        /**
+         * @brief Xử lý sự kiện I/O và timer cho tới khi 'stop' = true.
+         */
+        void run(const std::atomic<bool>& stop);
+
+        struct SleepAwaiter {
+            EventLoop& loop;
+            Clock::time_point due;
+            bool await_ready() const { return due <= Clock::now(); }
+            void await_suspend(std::coroutine_handle<> h);
+            void await_resume() const noexcept {}
+        };
+
+        /**
+         * @brief co_await loop.sleep(d): treo coroutine ít nhất 'd'.
+         */
+        SleepAwaiter sleep(Clock::duration d) { return SleepAwaiter{*this, Clock::now() + d}; }
+
+    private:
+        friend class Socket;
+
+        struct Timer {
+            Clock::time_point due;
+            uint64_t seq; // Cùng 'due' thì chạy theo thứ tự đăng ký
+            std::coroutine_handle<> handle;
+            bool operator>(const Timer& other) const {
+                return due != other.due ? due > other.due : seq > other.seq;
+            }
+        };
+
+        void runTimers();
+        int nextTimeoutMs() const;
+
+        int epoll_fd;
+        std::vector<Task<void>> tasks;
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+        uint64_t timer_seq = 0;
+    };
+
+    /**
+     * @brief Socket TCP non-blocking gắn với 1 EventLoop. Tại 1 thời điểm chỉ
+     * 1 coroutine được chờ trên socket (đúng với 1 phiên = 1 coroutine).
+     * Không di chuyển được (epoll giữ địa chỉ của object).
+     */
+    class Socket {
+    public:
+        explicit Socket(EventLoop& loop) : loop(loop) {}
+        ~Socket() { close(); }
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+
+        /**
+         * @brief Tạo socket và kết nối tới 'addr' (treo tới khi kết nối xong).
+         * @return false nếu không kết nối được.
+         */
+        Task<bool> connect(const sockaddr_in& addr);
+
+        void close();
+        int fd() const { return socket_fd; }
+
+        struct IoAwaiter {
+            Socket& socket;
+            uint32_t events;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) noexcept {
+                socket.waiter = h;
+                socket.wait_events = events;
+            }
+            void await_resume() const noexcept {}
+        };
+
+        /**
+         * @brief Treo tới khi socket đọc được (hoặc lỗi/peer đóng).
+         */
+        IoAwaiter readable();
+
+        /**
+         * @brief Treo tới khi socket ghi được (hoặc lỗi).
+         */
+        IoAwaiter writable();
+
+    private:
+        friend class EventLoop;
+        void onEvent(uint32_t events);
+
+        EventLoop& loop;
+        int socket_fd = -1;
+        std::coroutine_handle<> waiter; // Coroutine đang chờ sự kiện của socket
+        uint32_t wait_events = 0;
+    };
+}
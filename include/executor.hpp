@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <semaphore.h>
+
+/**
+ * @brief Pool thread cố định với hàng đợi có giới hạn.
+ * Mỗi worker có deque riêng: worker lấy việc ở cuối deque của mình,
+ * khi hết việc thì "trộm" việc ở đầu deque của worker khác (work stealing).
+ */
+class Executor {
+public:
+    /**
+     * @param num_workers Số thread worker (cố định, tái sử dụng).
+     * @param queue_depth Số task tối đa đang chờ; vượt quá thì trySubmit thất bại.
+     */
+    Executor(size_t num_workers, size_t queue_depth);
+    ~Executor(); // Dừng và join các worker (bỏ các task còn chờ)
+
+    /**
+     * @brief Đưa 1 task vào hàng đợi.
+     * @return false nếu hàng đợi đã đầy (caller phải tự từ chối yêu cầu).
+     */
+    bool trySubmit(std::function<void()> task);
+
+    size_t workerCount() const { return workers.size(); }
+    size_t pending() const { return queued.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(size_t index);
+    bool takeTask(size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    size_t queue_depth;
+    std::atomic<size_t> queued{0};       // Số task đã nhận nhưng chưa chạy
+    std::atomic<size_t> next_worker{0};  // Chia task round-robin cho thread ngoài pool
+    std::atomic<bool> stopping{false};
+    sem_t ready;                         // Mỗi task đang chờ = 1 lần sem_post
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Bảng xếp hạng toàn server: skip list có đếm bước nhảy (indexable
+ * skip list), sắp theo (điểm giảm dần, username tăng dần).
+ *
+ * Mỗi link lưu số phần tử nó nhảy qua (span), nên cập nhật điểm, tra hạng
+ * của 1 user và tìm phần tử ở hạng bất kỳ đều O(log n); lấy K người tiếp
+ * theo chỉ đi thêm K bước ở tầng dưới cùng. Hạng bắt đầu từ 1.
+ */
+class Leaderboard {
+public:
+    struct Entry {
+        std::string username;
+        int32_t score = 0;
+        size_t rank = 0; // 0: không có trong bảng
+    };
+
+    Leaderboard();
+    ~Leaderboard();
+    Leaderboard(const Leaderboard&) = delete;
+    Leaderboard& operator=(const Leaderboard&) = delete;
+
+    /**
+     * @brief Đặt điểm của user (thêm mới nếu chưa có).
+     */
+    void update(const std::string& username, int32_t score);
+
+    /**
+     * @brief Thêm user nếu chưa có; đã có thì giữ nguyên. Dùng khi dựng bảng từ CSDL
+     * trong lúc server đang chạy: điểm đã đặt qua update() luôn mới hơn điểm đọc từ CSDL.
+     */
+    void insertIfAbsent(const std::string& username, int32_t score);
+
+    /**
+     * @brief Hạng và điểm hiện tại của user (rank = 0 nếu không có).
+     */
+    Entry rank(const std::string& username) const;
+
+    /**
+     * @brief Tối đa 'count' người, bắt đầu từ hạng offset + 1.
+     */
+    std::vector<Entry> top(size_t offset, size_t count) const;
+
+    size_t size() const;
+
+    /**
+     * @brief Kiểm tra toàn bộ cấu trúc: thứ tự, span của mọi link, index (O(n log n)).
+     * Chỉ dùng cho kiểm thử ('make check').
+     */
+    bool checkInvariants() const;
+
+private:
+    static const int MAX_LEVEL = 32; // Đủ cho 4^32 phần tử với xác suất lên tầng 1/4
+
+    struct Node;
+    struct Link {
+        Node* node = nullptr;
+        size_t span = 0; // Số phần tử đi qua khi theo link này
+    };
+    // Node và mảng link của nó nằm trong cùng 1 lần cấp phát (ít cache miss hơn khi duyệt)
+    struct Node {
+        Node(const std::string& username, int32_t score, int level)
+            : username(username), score(score), level(level) {}
+        const std::string username;
+        int32_t score;
+        const int level;
+        Link* next() { return reinterpret_cast<Link*>(this + 1); } // next()[i]: phần tử kế tiếp ở tầng i
+        const Link* next() const { return reinterpret_cast<const Link*>(this + 1); }
+    };
+
+    static Node* createNode(const std::string& username, int32_t score, int level);
+    static void destroyNode(Node* node);
+
+    // a đứng trước (score, username) trong bảng
+    static bool before(const Node* a, int32_t score, const std::string& username) {
+        return a->score != score ? a->score > score : a->username < username;
+    }
+
+    int randomLevel();
+    void insert(Node* node);
+    void erase(Node* node);
+
+    mutable std::mutex mutex; // Bảo vệ các biến bên dưới
+    Node* head; // Phần tử giả đứng đầu, có đủ MAX_LEVEL tầng
+    int level = 1;
+    size_t length = 0;
+    std::unordered_map<std::string_view, Node*> index; // Key trỏ vào Node::username
+    uint64_t rng_state;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+/**
+ * @brief Logger bất đồng bộ, lọc theo mức (compile-time và runtime).
+ *
+ * LOG_INFO("Client " << fd << " connected") chỉ định dạng dòng log khi mức
+ * INFO đang bật; dòng được định dạng vào buffer cố định của thread rồi chép
+ * vào ring buffer riêng của thread (1 producer, 1 consumer, không khóa).
+ * Thread flusher gom các dòng của mọi thread, sắp theo thời gian và ghi
+ * bằng 1 lần write(). Ring đầy thì bỏ dòng log (đếm lại), không bao giờ chờ I/O.
+ */
+
+// Mức log: dùng số để lọc được bằng tiền xử lý
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+
+// Các mức thấp hơn mức này bị bỏ hẳn khi biên dịch (ví dụ -DLOG_COMPILE_LEVEL=2)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+namespace logger {
+
+    enum class Level : uint8_t {
+        DEBUG = LOG_LEVEL_DEBUG,
+        INFO = LOG_LEVEL_INFO,
+        WARN = LOG_LEVEL_WARN,
+        ERROR = LOG_LEVEL_ERROR
+    };
+
+    extern std::atomic<int> g_level; // Mức tối thiểu đang bật (runtime)
+
+    inline bool enabled(Level level) {
+        return static_cast<int>(level) >= g_level.load(std::memory_order_relaxed);
+    }
+
+    void setLevel(Level level);
+
+    /**
+     * @brief Đọc tên mức ("debug", "info", "warn", "error").
+     * @return false nếu tên không hợp lệ.
+     */
+    bool parseLevel(const std::string& name, Level& level);
+
+    /**
+     * @brief Khởi động thread flusher (các dòng log trước đó vẫn nằm chờ trong ring).
+     */
+    void start(int flush_interval_ms = 20);
+
+    /**
+     * @brief Ghi nốt mọi dòng đang chờ và dừng thread flusher.
+     */
+    void shutdown();
+
+    /**
+     * @brief 1 dòng log: định dạng qua stream() vào buffer cố định của thread,
+     * destructor đẩy dòng vào ring buffer. Dòng quá dài bị cắt bớt.
+     */
+    class Line {
+    public:
+        explicit Line(Level level);
+        ~Line();
+        Line(const Line&) = delete;
+        Line& operator=(const Line&) = delete;
+
+        std::ostream& stream() { return out; }
+
+        static const size_t MAX_LINE = 1024;
+
+    private:
+        // streambuf ghi vào mảng cố định, hết chỗ thì bỏ phần thừa
+        class FixedBuf : public std::streambuf {
+        public:
+            FixedBuf(char* begin, size_t size) { setp(begin, begin + size); }
+            size_t size() const { return pptr() - pbase(); }
+
+        protected:
+            int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+        };
+
+        Level level;
+        FixedBuf buf;
+        std::ostream out;
+    };
+}
+
+#define LOG_AT(level, expr)                                  \
+    do {                                                     \
+        if (logger::enabled(level)) {                        \
+            logger::Line log_line_(level);                   \
+            log_line_.stream() << expr;                      \
+        }                                                    \
+    } while (0)
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(expr) LOG_AT(logger::Level::DEBUG, expr)
+#else
+#define LOG_DEBUG(expr) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(expr) LOG_AT(logger::Level::INFO, expr)
+#else
+#define LOG_INFO(expr) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(expr) LOG_AT(logger::Level::WARN, expr)
+#else
+#define LOG_WARN(expr) do {} while (0)
+#endif
+
+#define LOG_ERROR(expr) LOG_AT(logger::Level::ERROR, expr)
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Bộ đếm và histogram độ trễ cho các đoạn nóng của server.
+ *
+ * Mỗi thread ghi vào khối số liệu riêng của nó (tạo lần đầu khi ghi), nên
+ * add()/record() không có khóa và không tranh chấp cache line giữa các thread.
+ * snapshotText() cộng dồn khối của mọi thread (kể cả thread đã kết thúc).
+ *
+ * Histogram kiểu HDR: giá trị (nano giây) được chia theo lũy thừa của 2,
+ * mỗi khoảng chia thành 16 ô bằng nhau => sai số tương đối <= 6.25%.
+ */
+namespace metrics {
+
+    enum Counter : uint8_t {
+        CONNECTIONS_ACCEPTED,
+        CONNECTIONS_CLOSED,
+        MESSAGES_IN,
+        BYTES_IN,
+        LOGINS_OK,
+        LOGINS_FAILED,
+        ANSWERS_CORRECT,
+        ANSWERS_WRONG,
+        SERVER_BUSY,       // Kết nối bị từ chối vì Executor đầy
+        DB_COMMITS,        // Số transaction ghi thay đổi của user xuống SQLite
+        USER_CACHE_HITS,   // acquire() thấy record trong cache
+        USER_CACHE_MISSES, // acquire() phải đọc CSDL
+        FRAMES_BROADCAST,  // Frame xếp cho thành viên phòng (mỗi thành viên tính 1)
+        SLOW_CONSUMERS,    // Kết nối bị đóng vì hàng đợi gửi vượt MAX_SEND_QUEUE
+        SESSIONS_PARKED,   // Phiên được giữ lại khi rớt kết nối giữa chừng
+        SESSIONS_RESUMED,  // Phiên khôi phục bằng resume token
+        SESSIONS_EXPIRED,  // Phiên đỗ quá hạn, bị gỡ
+        AUTH_BUSY,         // Đăng nhập bị từ chối vì hàng đợi kiểm tra mật khẩu đầy
+        PASSWORDS_UPGRADED, // Mật khẩu được băm lại (dạng rõ cũ hoặc đổi số vòng)
+        SHED_SERVER_FULL,  // Kết nối bị từ chối khi accept: server đủ max_connections (hoặc hết fd)
+        SHED_IP_LIMIT,     // Kết nối bị từ chối khi accept: IP đủ số kết nối cho phép
+        SHED_RATE_LIMIT,   // Kết nối bị từ chối khi accept: IP kết nối quá nhanh
+        LOGINS_THROTTLED,  // Đăng nhập bị từ chối vì IP đăng nhập quá nhanh
+        IDLE_CLOSED,       // Kết nối bị đóng vì im lặng quá idle_timeout
+        HEARTBEATS_SENT,   // S2C_PING gửi cho kết nối im lặng
+        LOGIN_TIMEOUTS,    // Kết nối bị đóng vì không đăng nhập kịp login_timeout
+        ANSWER_TIMEOUTS,   // Câu hỏi (hoặc lượt speed round) quá hạn answer_timeout, tính là sai
+        QUESTION_RELOADS,  // Số lần nạp lại kho câu hỏi thành công
+        NUM_COUNTERS
+    };
+
+    enum Histogram : uint8_t {
+        ACCEPT,            // accept4 + đăng ký kết nối vào epoll
+        MESSAGE_DECODE,    // Giải mã 1 frame (JSON/MessagePack) trên Reactor
+        QUEUE_WAIT,        // Từ lúc xếp task vào Executor đến lúc worker chạy
+        LOGIN_CHECK,       // checkLogin
+        QUESTION_SEND,     // Chọn và xếp câu hỏi (hoặc 1 lượt speed round) để gửi
+        ANSWER_HANDLE,     // Xử lý 1 câu trả lời / 1 lượt (chấm, cập nhật điểm, xếp câu tiếp theo)
+        DB_LOAD,           // Đọc 1 user từ SQLite (cache miss)
+        DB_COMMIT,         // 1 transaction ghi batch thay đổi (kể cả fsync)
+        USER_LOCK_WAIT,    // Chờ khóa record trong UserStore
+        SESSION_LOCK_WAIT, // Chờ khóa shard của SessionRegistry
+        PASSWORD_VERIFY,   // Kiểm tra (và băm lại nếu cần) 1 mật khẩu trên pool xác thực
+        NUM_HISTOGRAMS
+    };
+
+    /**
+     * @brief Thời điểm hiện tại (nano giây, steady_clock).
+     */
+    inline uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void add(Counter c, uint64_t n = 1);
+    void record(Histogram h, uint64_t nanos);
+
+    /**
+     * @brief Ghi thời gian sống của object vào histogram 'h'.
+     */
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram h) : h(h), start(now()) {}
+        ~ScopedTimer() { record(h, now() - start); }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram h;
+        uint64_t start;
+    };
+
+    /**
+     * @brief Khóa 'm' và ghi thời gian chờ vào 'h'.
+     * Thử try_lock trước: khi không tranh chấp thì không cần đọc đồng hồ.
+     */
+    inline std::unique_lock<std::mutex> lockTimed(std::mutex& m, Histogram h) {
+        std::unique_lock<std::mutex> lock(m, std::try_to_lock);
+        if (lock.owns_lock()) {
+            record(h, 0);
+        } else {
+            uint64_t start = now();
+            lock.lock();
+            record(h, now() - start);
+        }
+        return lock;
+    }
+
+    /**
+     * @brief Bảng số liệu dạng text (cộng dồn mọi thread).
+     */
+    std::string snapshotText();
+
+    /**
+     * @brief Ghi snapshotText() ra file (file tạm + rename, người đọc không thấy file dở).
+     */
+    bool writeSnapshot(const std::string& path);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @brief Băm và kiểm tra mật khẩu (PBKDF2-HMAC-SHA256, OpenSSL libcrypto).
+ *
+ * Mật khẩu lưu trong CSDL có dạng:
+ *     pbkdf2-sha256$<số vòng lặp>$<salt 16 byte, hex>$<hash 32 byte, hex>
+ * Chuỗi không bắt đầu bằng "pbkdf2-sha256$" là mật khẩu dạng rõ (CSDL do
+ * phiên bản cũ nhập từ users.json; bản hiện tại băm ngay lúc nhập):
+ * verify() vẫn chấp nhận, và needsRehash() báo cần băm lại ngay sau lần
+ * đăng nhập đúng đầu tiên.
+ *
+ * Các hàm này cố ý chậm (hàng chục ms); server chỉ gọi chúng trên pool
+ * thread xác thực riêng, không bao giờ khi đang giữ khóa.
+ */
+namespace password {
+
+    /**
+     * @brief Băm mật khẩu với salt ngẫu nhiên mới.
+     */
+    std::string hash(const std::string& plain, int iterations);
+
+    /**
+     * @brief So mật khẩu với giá trị lưu trong CSDL (so sánh thời gian hằng).
+     * Giá trị dạng băm nhưng hỏng thì không khớp với mật khẩu nào.
+     */
+    bool verify(const std::string& plain, const std::string& stored);
+
+    /**
+     * @brief true nếu 'stored' có dạng băm (không phải mật khẩu dạng rõ).
+     */
+    bool isHashed(const std::string& stored);
+
+    /**
+     * @brief true nếu 'stored' là mật khẩu dạng rõ hoặc được băm với số vòng khác 'iterations'.
+     */
+    bool needsRehash(const std::string& stored, int iterations);
+}
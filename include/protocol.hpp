@@ -1,21 +1,222 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
 #include <nlohmann/json.hpp> 
+#include "arena.hpp"
 
 // Dùng nlohmann::json cho tiện
 using json = nlohmann::json;
 
+// Thông điệp trong task xử lý inbox của Reactor (giải mã + trả lời mã hóa ngay): như json
+// nhưng object, mảng và chuỗi cấp phát qua ArenaAllocator, tức là trong arena của kết nối
+// (Arena::Scope). KHÔNG giữ lại qua Arena::reset(): lưu lâu thì chép sang std::string/json.
+using ArenaJson = nlohmann::basic_json<std::map, std::vector, ArenaString, bool, std::int64_t,
+                                       std::uint64_t, double, ArenaAllocator>;
+
 namespace protocol {
+    // Giới hạn an toàn cho 1 frame, tránh bị tấn công OOM
+    const uint32_t MAX_MESSAGE_SIZE = 10 * 1024 * 1024; // 10MB
+
+    /**
+     * @brief Cách mã hóa phần thân của frame.
+     * JSON: chuỗi JSON (mặc định, client cũ chỉ biết loại này).
+     * MSGPACK: MessagePack [opcode, payload], action được thay bằng số (xem OPCODE trong protocol.cpp).
+     * Bên nhận tự nhận biết theo byte đầu tiên nên không cần biết trước encoding của bên gửi.
+     */
+    enum class Encoding : uint8_t {
+        JSON,
+        MSGPACK
+    };
+
+    const char* encodingName(Encoding enc);
+
+    /**
+     * @brief Mã hóa thông điệp và nối phần thân (không có 4-byte độ dài) vào cuối 'out'.
+     */
+    void encodeBody(std::string& out, const json& j, Encoding enc);
+    void encodeBody(std::string& out, const ArenaJson& j, Encoding enc);
+
+    /**
+     * @brief Giải mã phần thân frame (JSON hoặc MessagePack, tự nhận biết).
+     * Ném json::exception nếu dữ liệu hỏng hoặc lồng sâu quá MAX_DEPTH. Json là json
+     * hoặc ArenaJson (Reactor); với ArenaJson mọi bộ nhớ tạm đều nằm trong arena.
+     */
+    template <typename Json = json>
+    Json decodeBody(const char* data, size_t len);
+
+    // Số tầng object/mảng lồng nhau tối đa của 1 thông điệp nhận được
+    constexpr size_t MAX_DEPTH = 64;
+
+    /**
+     * @brief Hủy cây từ lá lên, 'j' thành null. Destructor của nlohmann chép các phần tử
+     * của object/mảng còn khác rỗng ra 1 std::vector tạm trên heap chung; gọi hàm này
+     * trước khi 1 ArenaJson bị hủy thì không có cấp phát nào ngoài arena.
+     */
+    void clearTree(ArenaJson& j);
+
+    /**
+     * @brief Trường "action" của thông điệp (không chép chuỗi); "" nếu thiếu hoặc không phải chuỗi.
+     * Chỉ hợp lệ khi 'msg' còn sống.
+     */
+    std::string_view actionOf(const json& msg);
+    std::string_view actionOf(const ArenaJson& msg);
+
+    /**
+     * @brief Đóng gói thông điệp thành 1 frame (4-byte độ dài + thân) và nối vào cuối 'out'.
+     * Dùng cho socket non-blocking (Reactor tự gửi dần 'out').
+     */
+    void appendFrame(std::string& out, const json& j, Encoding enc = Encoding::JSON);
+    void appendFrame(std::string& out, const ArenaJson& j, Encoding enc = Encoding::JSON);
+
+    /**
+     * @brief Frame bất biến đã mã hóa sẵn (gồm 4-byte độ dài) cho mọi encoding.
+     * Mã hóa 1 lần, nhiều kết nối cùng gửi mà không cần chép hay mã hóa lại.
+     */
+    struct PreparedFrame {
+        std::shared_ptr<const std::string> encoded[2]; // Theo thứ tự của Encoding
+
+        const std::shared_ptr<const std::string>& get(Encoding enc) const {
+            return encoded[static_cast<size_t>(enc)];
+        }
+    };
+
+    /**
+     * @brief Mã hóa thông điệp thành PreparedFrame (JSON và MessagePack).
+     */
+    PreparedFrame prepareFrame(const json& j);
+    PreparedFrame prepareFrame(const ArenaJson& j);
+
+    /**
+     * @brief Như PreparedFrame nhưng nằm trong vùng nhớ của người khác
+     * (ví dụ file mmap); 'owner' giữ vùng nhớ đó sống cho tới khi gửi xong.
+     */
+    struct FrameView {
+        std::shared_ptr<const void> owner;
+        std::string_view encoded[2]; // Theo thứ tự của Encoding
+
+        std::string_view get(Encoding enc) const { return encoded[static_cast<size_t>(enc)]; }
+    };
+
+    /**
+     * @brief Bộ đệm gửi: gom nhiều frame (ví dụ S2C_ANSWER_RESULT + S2C_NEW_QUESTION)
+     * rồi gửi bằng 1 lần sendmsg (writev). Frame mã hóa tại chỗ nằm trong buffer riêng,
+     * PreparedFrame chỉ được tham chiếu (không chép).
+     * Dùng được cho cả socket blocking và non-blocking.
+     */
+    class FrameWriter {
+    public:
+        enum class Status {
+            DONE,        // Đã gửi hết
+            WOULD_BLOCK, // Socket non-blocking đầy, gọi flush() lại khi ghi được
+            FAILED       // Lỗi socket / mất kết nối
+        };
+
+        void add(const json& j, Encoding enc = Encoding::JSON);
+        void add(const ArenaJson& j, Encoding enc = Encoding::JSON);
+        void add(const PreparedFrame& frame, Encoding enc) { addShared(frame.get(enc)); }
+        void add(const FrameView& frame, Encoding enc) {
+            addView(frame.owner, frame.get(enc).data(), frame.get(enc).size());
+        }
+        void addShared(std::shared_ptr<const std::string> frame);
+
+        /**
+         * @brief Gửi 'len' byte (các frame hoàn chỉnh) tại 'data' mà không chép;
+         * 'owner' giữ vùng nhớ đó (ví dụ file mmap) sống cho tới khi gửi xong.
+         */
+        void addView(std::shared_ptr<const void> owner, const char* data, size_t len);
+        bool empty() const { return segments.empty(); }
+        size_t pending() const { return queued; } // Số byte chưa gửi
+
+        /**
+         * @brief Gửi phần còn lại, xử lý partial write.
+         */
+        Status flush(int socket);
+
+        /**
+         * @brief Khi đã gửi hết: trả lại bộ nhớ nếu buffer lớn hơn 'idle_limit'.
+         */
+        void release(size_t idle_limit);
+
+    private:
+        void addOwned(size_t start); // Ghi nhận frame vừa mã hóa vào 'owned' từ vị trí 'start'
+
+        // 1 đoạn cần gửi: hoặc nằm trong 'owned' (data == nullptr), hoặc là vùng nhớ dùng chung
+        struct Segment {
+            size_t offset;     // Vị trí trong 'owned' (khi data == nullptr)
+            size_t length;
+            const char* data;  // Vùng nhớ dùng chung
+            std::shared_ptr<const void> owner;
+        };
+
+        std::string owned;              // Frame mã hóa tại chỗ
+        std::vector<Segment> segments;
+        size_t head_sent = 0;           // Số byte của segments[0] đã gửi
+        size_t queued = 0;              // Tổng số byte chưa gửi
+    };
+
     /**
-     * @brief Gửi một thông điệp JSON (Thêm 4-byte độ dài ở đầu).
+     * @brief Bật/tắt TCP_NODELAY (tắt thuật toán Nagle) cho socket.
+     * Frame đã được gom trước khi gửi nên không cần Nagle để gộp gói nhỏ.
      */
-    bool sendMessage(int socket, const json& j);
+    bool setNoDelay(int socket, bool enabled = true);
 
     /**
-     * @brief Nhận một thông điệp JSON (Đọc 4-byte độ dài trước).
+     * @brief Gửi một thông điệp: 4-byte độ dài + thân trong 1 lần sendmsg (writev).
      */
-    json receiveMessage(int socket);
+    bool sendMessage(int socket, const json& j, Encoding enc = Encoding::JSON);
+
+    /**
+     * @brief Bộ đệm nhận của 1 kết nối: mỗi lần recv đọc nhiều nhất có thể vào
+     * thẳng buffer, rồi tách mọi frame hoàn chỉnh (thân frame được trả về dạng
+     * con trỏ vào buffer, không chép). Buffer chỉ lớn dần theo dữ liệu thực sự
+     * nhận được, không cấp phát trước theo độ dài do client khai báo.
+     */
+    class FrameReader {
+    public:
+        enum class Next {
+            FRAME,      // Có 1 frame hoàn chỉnh
+            INCOMPLETE, // Cần đọc thêm (kể cả khi chưa đủ 4-byte độ dài)
+            TOO_LARGE   // Độ dài vượt MAX_MESSAGE_SIZE, phải đóng kết nối
+        };
+
+        /**
+         * @brief Gọi recv 1 lần vào phần trống cuối buffer (nới buffer nếu cần).
+         * @return Như recv: số byte đọc được, 0 nếu peer đóng, -1 nếu lỗi (xem errno).
+         */
+        ssize_t fill(int socket);
+
+        /**
+         * @brief Lấy frame hoàn chỉnh tiếp theo trong buffer.
+         * 'body' chỉ hợp lệ đến lần gọi fill()/release() kế tiếp.
+         */
+        Next next(const char*& body, size_t& len);
+
+        bool empty() const { return head == tail; }
+
+        /**
+         * @brief Khi buffer rỗng: trả lại bộ nhớ nếu lớn hơn 'idle_limit'.
+         */
+        void release(size_t idle_limit);
+
+    private:
+        // Số byte trống tối thiểu cho 1 lần recv
+        static constexpr size_t MIN_READ = 4 * 1024;
+
+        std::unique_ptr<char[]> data;
+        size_t capacity = 0;
+        size_t head = 0; // Byte đầu tiên chưa xử lý
+        size_t tail = 0; // Cuối dữ liệu đã nhận
+    };
+
+    /**
+     * @brief Nhận một thông điệp (socket blocking), JSON hoặc MessagePack.
+     * Dữ liệu đọc dư (frame sau) được giữ lại trong 'reader' cho lần gọi tiếp.
+     * @return JSON rỗng nếu mất kết nối hoặc thông điệp lỗi.
+     */
+    json receiveMessage(int socket, FrameReader& reader);
 
     // --- CÁC HÀNH ĐỘNG CỦA GAME ---
     const std::string C2S_SUBMIT_ANSWER = "C2S_SUBMIT_ANSWER";
@@ -26,4 +227,47 @@ namespace protocol {
     const std::string C2S_LOGIN_REQUEST = "C2S_LOGIN_REQUEST";
     const std::string S2C_LOGIN_SUCCESS = "S2C_LOGIN_SUCCESS";
     const std::string S2C_LOGIN_FAILURE = "S2C_LOGIN_FAILURE";
+
+    // --- KHÔI PHỤC PHIÊN: S2C_LOGIN_SUCCESS có "resume_token"; kết nối rớt giữa ván thì
+    //     client kết nối lại và gửi C2S_RESUME_REQUEST {resume_token} thay cho C2S_LOGIN_REQUEST.
+    //     Thành công: S2C_LOGIN_SUCCESS {resumed: true, score, resume_token mới} rồi câu hỏi đang chờ;
+    //     thất bại (token sai/hết hạn): S2C_LOGIN_FAILURE, client đăng nhập lại bằng mật khẩu ---
+    const std::string C2S_RESUME_REQUEST = "C2S_RESUME_REQUEST";
+
+    // --- HEARTBEAT (server bật --heartbeat): kết nối im lặng quá lâu thì server gửi S2C_PING,
+    //     client trả lời C2S_PONG (payload rỗng). Câu hỏi quá hạn (--answer-timeout) được
+    //     tính là trả lời sai: kết quả có thêm "timed_out": true ---
+    const std::string S2C_PING = "S2C_PING";
+    const std::string C2S_PONG = "C2S_PONG";
+
+    // --- THỎA THUẬN ENCODING (client gửi HELLO bằng JSON, server trả lời bằng JSON
+    //     rồi chuyển sang encoding đã chọn cho các thông điệp sau) ---
+    const std::string C2S_HELLO = "C2S_HELLO";
+    const std::string S2C_HELLO = "S2C_HELLO";
+
+    // --- SERVER QUÁ TẢI (gửi xong sẽ đóng kết nối) ---
+    const std::string S2C_SERVER_BUSY = "S2C_SERVER_BUSY";
+
+    // --- SPEED ROUND (client gửi "speed_round": N trong C2S_LOGIN_REQUEST):
+    //     mỗi lượt server gửi N câu trong 1 frame, client trả lời cả N câu trong 1 frame ---
+    const std::string S2C_QUESTION_BATCH = "S2C_QUESTION_BATCH";
+    const std::string C2S_SUBMIT_BATCH = "C2S_SUBMIT_BATCH";
+    const std::string S2C_BATCH_RESULT = "S2C_BATCH_RESULT";
+    const int MAX_SPEED_ROUND = 50; // Số câu tối đa trong 1 lượt
+
+    // --- PHÒNG CHƠI NHIỀU NGƯỜI (client gửi "room": "<tên>" trong C2S_LOGIN_REQUEST):
+    //     cả phòng nhận cùng 1 S2C_NEW_QUESTION, ai trả lời đúng trước thắng lượt;
+    //     khi có người vào/ra và sau mỗi lượt server gửi bảng điểm của phòng ---
+    const std::string S2C_ROOM_STANDINGS = "S2C_ROOM_STANDINGS";
+    const size_t MAX_ROOM_NAME = 32; // Tên phòng dài hơn bị cắt bớt
+
+    // --- BẢNG XẾP HẠNG (chỉ sau khi đăng nhập, không ảnh hưởng lượt chơi):
+    //     C2S_LEADERBOARD_REQUEST {offset, limit} -> S2C_LEADERBOARD {total, entries: [{rank, username, score}]}
+    //     C2S_RANK_REQUEST {username (mặc định: user đang đăng nhập)} -> S2C_RANK {username, rank, score, total}
+    //     rank = 0 nếu không có user này ---
+    const std::string C2S_LEADERBOARD_REQUEST = "C2S_LEADERBOARD_REQUEST";
+    const std::string S2C_LEADERBOARD = "S2C_LEADERBOARD";
+    const std::string C2S_RANK_REQUEST = "C2S_RANK_REQUEST";
+    const std::string S2C_RANK = "S2C_RANK";
+    const size_t MAX_LEADERBOARD_LIMIT = 100; // Số dòng tối đa trong 1 S2C_LEADERBOARD
 }
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "protocol.hpp"
+
+/**
+ * @brief Định dạng file câu hỏi đã biên dịch (questions.bin), do
+ * tools/compile_questions.cpp tạo từ questions.json.
+ *
+ * [FileHeader][QuestionEntry x count][OptionEntry x option_count][string pool]
+ * Mọi chuỗi (id, nội dung, lựa chọn, và frame S2C_NEW_QUESTION mã hóa sẵn
+ * cho từng encoding) nằm trong string pool, tham chiếu bằng StrRef.
+ * Số nguyên theo byte order của máy (little-endian); magic sai cũng báo
+ * file được tạo trên máy khác byte order.
+ */
+namespace qbank {
+    const uint32_t MAGIC = 0x4B4E4251; // "QBNK"
+    const uint32_t VERSION = 1;
+
+    struct StrRef {
+        uint32_t offset; // Vị trí trong string pool
+        uint32_t length;
+    };
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;        // Số câu hỏi
+        uint32_t option_count; // Tổng số lựa chọn của mọi câu
+        uint64_t pool_offset;  // Vị trí string pool trong file
+        uint64_t pool_size;
+    };
+
+    struct QuestionEntry {
+        StrRef id;
+        StrRef text;
+        StrRef correct_answer;
+        uint32_t first_option; // Index trong bảng OptionEntry
+        uint32_t num_options;
+        StrRef frame[2];       // S2C_NEW_QUESTION (gồm 4-byte độ dài), theo thứ tự của Encoding
+    };
+
+    struct OptionEntry {
+        StrRef key;
+        StrRef value;
+    };
+
+    static_assert(sizeof(FileHeader) == 32, "FileHeader layout");
+    static_assert(sizeof(QuestionEntry) == 48, "QuestionEntry layout");
+    static_assert(sizeof(OptionEntry) == 16, "OptionEntry layout");
+}
+
+/**
+ * @brief Kho câu hỏi đọc thẳng từ file questions.bin qua mmap.
+ *
+ * open() chỉ kiểm tra header và kích thước các bảng (O(1), không đọc từng
+ * câu); trang nào được dùng mới được nạp và dùng chung giữa các process.
+ * Mọi chuỗi trả về trỏ thẳng vào vùng mmap (không chép).
+ */
+class QuestionBank {
+public:
+    /**
+     * @brief 1 câu hỏi (chỉ đọc, trỏ vào vùng mmap).
+     */
+    class Question {
+    public:
+        std::string_view id() const { return bank->str(entry->id); }
+        std::string_view text() const { return bank->str(entry->text); }
+        std::string_view correctAnswer() const { return bank->str(entry->correct_answer); }
+        size_t numOptions() const { return entry->num_options; }
+        std::string_view optionKey(size_t i) const;
+        std::string_view optionValue(size_t i) const;
+
+        /**
+         * @brief Frame S2C_NEW_QUESTION mã hóa sẵn, gửi thẳng từ vùng mmap.
+         */
+        protocol::FrameView frame() const;
+
+    private:
+        friend class QuestionBank;
+        Question(const QuestionBank* bank, const qbank::QuestionEntry* entry) : bank(bank), entry(entry) {}
+
+        const QuestionBank* bank;
+        const qbank::QuestionEntry* entry;
+    };
+
+    /**
+     * @brief mmap file và kiểm tra header.
+     * @return false (kèm log lỗi) nếu không mở được hoặc file không hợp lệ.
+     */
+    bool open(const std::string& path);
+
+    size_t size() const { return count; }
+    Question get(size_t index) const { return Question(this, &questions[index]); }
+
+    /**
+     * @brief Số thứ tự của bản này trong LiveQuestionBank (0 = chưa publish).
+     */
+    uint64_t version() const { return generation; }
+
+private:
+    friend class LiveQuestionBank;
+
+    // Vùng mmap, giải phóng khi không còn frame nào đang chờ gửi tham chiếu tới nó
+    struct Mapping {
+        void* base = nullptr;
+        size_t length = 0;
+        ~Mapping();
+    };
+
+    /**
+     * @brief Chuỗi trong string pool; StrRef vượt ngoài pool (file hỏng) trả về chuỗi rỗng.
+     */
+    std::string_view str(const qbank::StrRef& ref) const {
+        if (ref.offset > pool_size || ref.length > pool_size - ref.offset) return {};
+        return std::string_view(pool + ref.offset, ref.length);
+    }
+
+    std::shared_ptr<const Mapping> mapping;
+    const qbank::QuestionEntry* questions = nullptr;
+    const qbank::OptionEntry* options = nullptr;
+    const char* pool = nullptr;
+    size_t count = 0;
+    size_t option_count = 0;
+    uint64_t pool_size = 0;
+    uint64_t generation = 0;
+};
+
+/**
+ * @brief Bản đang dùng của kho câu hỏi, thay được khi server đang chạy (reload).
+ *
+ * Kiểu RCU: bản mới được mở và kiểm tra xong (ngoài đường nóng) rồi mới
+ * publish. Phiên/phòng giữ shared_ptr tới bản nó đang dùng (câu đang chờ trả
+ * lời là index trong bản đó) và chỉ chuyển sang bản mới khi rút câu mới.
+ * Bản cũ (và vùng mmap của nó) được giải phóng khi không còn ai giữ, kể cả
+ * các frame đang chờ gửi.
+ *
+ * refresh() trên đường nóng chỉ đọc 1 biến atomic; chỉ khi có bản mới mới
+ * phải lấy shared_ptr (std::atomic_load: C++17 chưa có std::atomic<std::shared_ptr>).
+ */
+class LiveQuestionBank {
+public:
+    using Ptr = std::shared_ptr<const QuestionBank>;
+
+    /**
+     * @brief Thay bản đang dùng (chỉ 1 thread gọi tại 1 thời điểm).
+     */
+    void publish(std::shared_ptr<QuestionBank> bank) {
+        uint64_t next = latest.load(std::memory_order_relaxed) + 1;
+        bank->generation = next;
+        std::atomic_store(&current, Ptr(std::move(bank)));
+        latest.store(next, std::memory_order_release);
+    }
+
+    /**
+     * @brief Bản mới nhất (có thể là nullptr trước lần publish đầu tiên).
+     */
+    Ptr get() const { return std::atomic_load(&current); }
+
+    /**
+     * @brief Chuyển 'pinned' sang bản mới nhất nếu nó đang giữ bản cũ (hoặc chưa giữ gì).
+     */
+    void refresh(Ptr& pinned) const {
+        if (!pinned || pinned->version() != latest.load(std::memory_order_acquire)) {
+            pinned = get();
+        }
+    }
+
+private:
+    Ptr current;
+    std::atomic<uint64_t> latest{0};
+};
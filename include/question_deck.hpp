@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief "Bộ bài" câu hỏi của 1 phiên chơi (hoặc 1 phòng): rút lần lượt các
+ * index trong [0, n) theo 1 hoán vị ngẫu nhiên, không lặp lại câu nào cho
+ * tới khi đã rút hết n câu (rồi xáo lại từ đầu).
+ *
+ * Hoán vị được xáo dần (Fisher-Yates lười): chỉ lưu các vị trí đã bị đổi
+ * chỗ, nên bộ nhớ tỉ lệ với số câu đã rút chứ không với kích thước
+ * QuestionBank, và mỗi lần rút là O(1). Nút của map được tái sử dụng: khi
+ * map đã đạt kích thước lớn nhất của nó, rút câu không còn cấp phát heap.
+ *
+ * Mỗi deck có bộ sinh số ngẫu nhiên riêng (SplitMix64, 8 byte), không dùng
+ * chung trạng thái với thread/phiên khác => không cần khóa. Deck không an
+ * toàn đa luồng: người gọi tự đảm bảo chỉ 1 thread dùng nó tại 1 thời điểm
+ * (inbox của kết nối, hoặc khóa của phòng).
+ */
+class QuestionDeck {
+public:
+    QuestionDeck();
+
+    /**
+     * @brief Rút câu tiếp theo trong bộ 'n' câu (n > 0).
+     * Nếu n khác lần rút trước (QuestionBank được nạp lại) thì bắt đầu bộ mới.
+     */
+    size_t draw(size_t n);
+
+private:
+    uint64_t next();
+
+    uint64_t rng_state;
+    size_t size = 0;  // Số câu của bộ hiện tại
+    size_t drawn = 0; // Số câu đã rút trong bộ hiện tại
+    std::unordered_map<uint32_t, uint32_t> swapped; // Vị trí -> index đã bị đổi chỗ tới đó
+    std::vector<std::unordered_map<uint32_t, uint32_t>::node_type> spare; // Nút đã gỡ khỏi 'swapped', dùng lại khi cần nút mới
+};
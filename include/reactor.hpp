@@ -0,0 +1,212 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <sys/socket.h> // Cho SOMAXCONN
+#include <nlohmann/json.hpp>
+#include "session.hpp"
+#include "executor.hpp"
+#include "protocol.hpp"
+#include "arena.hpp"
+#include "admission.hpp"
+#include "timing_wheel.hpp"
+
+class Reactor;
+
+/**
+ * @brief 1 kết nối client (non-blocking) do 1 Reactor quản lý.
+ * Reactor lo đọc/ghi socket; frame nhận được xếp vào inbox, giải mã và xử lý trên
+ * Executor, mỗi kết nối tối đa 1 task cùng lúc (giữ đúng thứ tự thông điệp).
+ */
+struct Connection : std::enable_shared_from_this<Connection> {
+    int fd = -1;
+    Reactor* owner = nullptr;
+    uint32_t peer_addr = 0; // IPv4 của client (network byte order), không đổi sau accept
+
+    // --- Chỉ thread của Reactor truy cập ---
+    protocol::FrameReader reader; // Bộ đệm nhận (có thể chứa frame dở dang)
+    bool want_write = false; // Đang đăng ký EPOLLOUT
+    uint64_t last_read = 0;  // Lần cuối nhận được dữ liệu (ms, TimingWheel::nowMs)
+    uint64_t last_ping = 0;  // Lần cuối gửi S2C_PING
+    TimingWheel::Timer idle_timer;     // Kiểm tra kết nối im lặng (heartbeat, idle timeout)
+    TimingWheel::Timer deadline_timer; // Hạn chót của phiên (setDeadline)
+    uint64_t timer_seq = 0;            // deadline_seq ứng với deadline_timer đang hẹn
+
+    // --- Reactor và worker cùng truy cập, bảo vệ bởi mutex ---
+    std::mutex mutex;
+    protocol::FrameWriter out;  // Các frame đang chờ gửi (gom lại, flush 1 lần)
+    bool closing = false;       // Đóng kết nối sau khi gửi hết out
+    bool closed = false;        // Reactor đã đóng socket
+    std::string inbox;          // Frame chờ worker giải mã và xử lý (4-byte độ dài theo byte order của máy + thân)
+    std::vector<std::function<void()>> callbacks; // Việc do thread khác gửi về (Reactor::post), chạy trước inbox
+    bool scheduled = false;     // Đang có task xử lý inbox trên Executor
+    bool close_pending = false; // Task đang chạy phải gọi onClose khi xong
+    protocol::Encoding encoding = protocol::Encoding::JSON; // Encoding của frame gửi đi
+    uint64_t deadline = 0;         // Hạn chót của phiên (ms, TimingWheel::nowMs), 0 = không có
+    uint64_t deadline_seq = 0;     // Tăng mỗi lần đặt lại hạn chót
+    bool deadline_changed = false; // Reactor cần hẹn lại deadline_timer
+
+    // --- Thread vừa đặt scheduled = true ghi, task xử lý inbox mà nó tạo ra đọc ---
+    std::shared_ptr<Connection> pinned; // Giữ kết nối sống khi task đang chờ trong Executor
+    uint64_t queued_at = 0;             // Lúc task được xếp hàng (metrics::now)
+
+    // --- Chỉ task đang xử lý inbox truy cập ---
+    Session session;
+    std::string batch; // Phần inbox đang xử lý (đổi chỗ với inbox, giữ lại bộ nhớ cho lần sau)
+    Arena arena;       // Chứa json của thông điệp đang xử lý (giải mã + trả lời), reset sau mỗi thông điệp
+
+    /**
+     * @brief Đưa 1 thông điệp JSON vào hàng đợi gửi (Reactor sẽ flush).
+     * Bản ArenaJson nhận quyền sở hữu: mã hóa xong thì hủy cây bằng protocol::clearTree.
+     */
+    void send(const json& j);
+    void send(ArenaJson&& j);
+
+    /**
+     * @brief Đưa frame đã mã hóa sẵn vào hàng đợi gửi (chỉ tham chiếu, không chép).
+     */
+    void send(const protocol::PreparedFrame& frame);
+    void send(const protocol::FrameView& frame);
+
+    /**
+     * @brief Gửi frame dùng chung cho kết nối KHÁC (broadcast), gọi được từ thread bất kỳ:
+     * xếp vào hàng đợi gửi rồi nhờ Reactor flush ngay. Kết nối đọc quá chậm
+     * (hàng đợi vượt MAX_SEND_QUEUE) bị đóng thay vì làm chậm người gửi.
+     * @return false nếu kết nối đã/đang đóng.
+     */
+    bool push(const protocol::PreparedFrame& frame);
+    bool push(const protocol::FrameView& frame);
+
+    // Số byte chờ gửi tối đa của 1 kết nối khi nhận broadcast
+    static const size_t MAX_SEND_QUEUE = 1024 * 1024;
+
+    /**
+     * @brief Đổi encoding cho các frame gửi sau (sau khi thỏa thuận HELLO).
+     */
+    void setEncoding(protocol::Encoding enc);
+
+    /**
+     * @brief Yêu cầu đóng kết nối sau khi gửi hết dữ liệu đang chờ.
+     */
+    void closeAfterFlush();
+
+    /**
+     * @brief Đặt hạn chót của phiên: hết 'timeout' mà chưa đặt lại thì
+     * ConnectionHandler::onDeadline chạy trong task xử lý inbox (0 = hủy).
+     * Gọi được từ thread bất kỳ; Reactor hẹn giờ ở lần flush kế tiếp của kết nối
+     * (cuối task xử lý inbox, hoặc sau push()).
+     */
+    void setDeadline(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Hạn chót đang đặt (ms, TimingWheel::nowMs), 0 = không có.
+     */
+    uint64_t deadlineAt();
+};
+
+/**
+ * @brief Giao diện xử lý sự kiện của kết nối (Server cài đặt).
+ * onMessage/onDeadline chạy trên worker của Executor; onOpen/onClose có thể
+ * chạy trên thread của Reactor hoặc của worker, nhưng không bao giờ song song
+ * với onMessage của cùng kết nối.
+ */
+class ConnectionHandler {
+public:
+    virtual ~ConnectionHandler() = default;
+    virtual void onOpen(Connection& conn) = 0;
+    virtual void onMessage(Connection& conn, const ArenaJson& msg) = 0;
+    virtual void onDeadline(Connection& conn) = 0; // Hết hạn chót đặt bằng setDeadline
+    virtual void onClose(Connection& conn) = 0;
+};
+
+/**
+ * @brief Tùy chọn cho socket của Reactor.
+ */
+struct ReactorOptions {
+    int backlog = SOMAXCONN;
+    bool tcp_nodelay = true; // Tắt Nagle trên kết nối client
+    AdmissionControl* admission = nullptr; // Giới hạn kết nối (nullptr = nhận mọi kết nối)
+    uint64_t idle_timeout_ms = 0; // Đóng kết nối im lặng quá lâu (0 = không)
+    uint64_t heartbeat_ms = 0;    // Gửi S2C_PING khi kết nối im lặng quá lâu (0 = không)
+};
+
+/**
+ * @brief Vòng lặp sự kiện epoll, mỗi Reactor chạy trên 1 thread.
+ * Mỗi Reactor có listener riêng (SO_REUSEPORT), kernel tự chia kết nối.
+ */
+class Reactor {
+public:
+    Reactor(int id, ConnectionHandler& handler, Executor& executor, const ReactorOptions& options);
+    ~Reactor();
+
+    /**
+     * @brief Tạo epoll, eventfd và listener (SO_REUSEPORT) trên port.
+     */
+    bool open(int port);
+
+    /**
+     * @brief Vòng lặp epoll_wait, không bao giờ trả về (trừ khi lỗi).
+     */
+    void run();
+
+    /**
+     * @brief Gọi từ thread bất kỳ: yêu cầu Reactor gửi các frame đang chờ của kết nối.
+     */
+    void requestFlush(std::shared_ptr<Connection> conn);
+
+    /**
+     * @brief Gọi từ thread bất kỳ: chạy 'callback' trong task xử lý inbox của kết nối
+     * (không song song với onMessage/onClose của nó). Callback luôn được chạy, kể cả
+     * khi kết nối đã đóng, để nó tự dọn tài nguyên đang giữ; luôn trên worker của
+     * Executor (Executor đầy thì Reactor thử xếp lại sau, không chạy trên thread gọi).
+     */
+    void post(const std::shared_ptr<Connection>& conn, std::function<void()> callback);
+
+private:
+    void acceptAll();
+    void reject(int fd, AdmissionControl::Verdict verdict);
+    bool shedWithoutFd();
+    void onReadable(Connection& conn);
+    bool dispatch(Connection& conn, const char* body, size_t len);
+    bool submitDrain(Connection& conn);
+    void drain(const std::shared_ptr<Connection>& conn);
+    void handleFrame(Connection& conn, const char* body, size_t len);
+    void runCallback(Connection& conn, const std::function<void()>& callback);
+    void onWakeup();
+    bool hasDrainRetries();
+    void retryDrains();
+    void flush(Connection& conn);
+    void updateInterest(Connection& conn, bool want_write);
+    void closeConnection(Connection& conn);
+    void armIdleTimer(Connection& conn);
+    void onIdleTimer(Connection& conn);
+    void syncDeadline(Connection& conn);
+    void scheduleDeadline(Connection& conn, uint64_t deadline, uint64_t seq);
+    void onDeadlineTimer(Connection& conn);
+
+    int id;
+    ConnectionHandler& handler;
+    Executor& executor;
+    ReactorOptions options;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd; // eventfd: worker đánh thức Reactor để flush
+    int spare_fd; // fd dự phòng: hết fd (EMFILE) thì nhả ra để accept rồi từ chối kết nối
+    std::unordered_map<int, std::shared_ptr<Connection>> connections;
+    // Kết nối đã đóng trong vòng epoll_wait hiện tại (giải phóng cuối vòng)
+    std::vector<std::shared_ptr<Connection>> graveyard;
+    TimingWheel wheel; // Timer của các kết nối (chỉ thread của Reactor dùng)
+    uint64_t now_ms;   // Đọc đồng hồ 1 lần mỗi vòng epoll_wait
+
+    std::mutex flush_mutex;           // Bảo vệ flush_requests và drain_retries
+    std::vector<std::shared_ptr<Connection>> flush_requests;
+    std::vector<std::shared_ptr<Connection>> flushing; // Đang flush (chỉ thread của Reactor dùng)
+    // Kết nối có callback (post) đang chờ mà Executor đầy: scheduled vẫn bật, Reactor thử lại
+    std::vector<std::shared_ptr<Connection>> drain_retries;
+    std::vector<std::shared_ptr<Connection>> retrying; // Đang thử lại (chỉ thread của Reactor dùng)
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "protocol.hpp"
+#include "question_deck.hpp"
+
+struct Connection;
+class QuestionBank;
+
+/**
+ * @brief 1 phòng chơi nhiều người: mọi thành viên nhận cùng 1 câu hỏi,
+ * ai trả lời đúng trước thắng lượt (+1 điểm phòng). Lượt kết thúc khi có
+ * người đúng hoặc mọi người đều đã trả lời sai.
+ *
+ * Mọi frame gửi cho cả phòng được mã hóa 1 lần (PreparedFrame/FrameView)
+ * rồi chỉ tham chiếu vào hàng đợi gửi của từng thành viên.
+ */
+struct Room {
+    explicit Room(std::string name) : name(std::move(name)) {}
+
+    struct Member {
+        std::shared_ptr<Connection> conn;
+        std::string username;
+        int points = 0;        // Điểm trong phòng (không ghi vào CSDL)
+        bool answered = false; // Đã trả lời câu của lượt hiện tại
+    };
+
+    const std::string name;
+
+    std::mutex mutex; // Bảo vệ các biến bên dưới
+    std::vector<Member> members;
+    std::shared_ptr<const QuestionBank> bank; // Bản kho câu hỏi của lượt hiện tại
+    size_t question_index = 0; // Câu hỏi của lượt hiện tại (index trong bank)
+    QuestionDeck deck;         // Thứ tự câu hỏi của phòng (không lặp lại)
+    uint64_t round = 0;
+    uint64_t round_started = 0; // Lúc mở lượt hiện tại (ms, TimingWheel::nowMs)
+    bool round_open = false;
+
+    /**
+     * @brief Thành viên ứng với kết nối 'conn' (nullptr nếu không có).
+     */
+    Member* find(const Connection* conn);
+
+    /**
+     * @brief true nếu mọi thành viên đều đã trả lời lượt hiện tại.
+     */
+    bool allAnswered() const;
+
+    /**
+     * @brief Bảng điểm phòng, sắp giảm dần theo điểm: [{username, points}, ...].
+     */
+    ArenaJson standings() const;
+
+    /**
+     * @brief Gửi frame cho mọi thành viên (không mã hóa lại, không chép).
+     */
+    void broadcast(const protocol::PreparedFrame& frame);
+    void broadcast(const protocol::FrameView& frame);
+};
@@ -5,52 +5,243 @@
 #include <map>
 #include <mutex> // Cần cho std::mutex
 #include <nlohmann/json.hpp>
-#include <set>   // <-- SỬA LỖI 1: Thêm thư viện <set>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <condition_variable>
+#include "reactor.hpp"
+#include "user_store.hpp"
+#include "question_bank.hpp"
+#include "room.hpp"
+#include "leaderboard.hpp"
+#include "session_registry.hpp"
 
-using json = nlohmann::json;
-
-// Struct đơn giản để chứa câu hỏi
-struct Question {
-    std::string id;
-    std::string text;
-    std::map<std::string, std::string> options;
-    std::string correct_answer;
+// Cấu hình server (đọc từ dòng lệnh trong main.cpp)
+struct ServerConfig {
+    int port = 8081;
+    std::string data_dir = "../data"; // Chứa questions.bin (và users.json để nhập vào CSDL lần đầu)
+    std::string questions_file;  // Kho câu hỏi đã biên dịch (rỗng = <data_dir>/questions.bin)
+    bool watch_questions = true; // Tự nạp lại kho câu hỏi khi file thay đổi (inotify); SIGHUP luôn nạp lại
+    std::string db_file = "../db/game.db"; // CSDL user (SQLite)
+    int num_reactors = 0;        // Số thread epoll (0 = số core của máy)
+    int num_workers = 0;         // Số worker xử lý phiên chơi (0 = 2 x số core)
+    size_t queue_depth = 10000;  // Số task tối đa chờ trong Executor
+    bool tcp_nodelay = true;     // TCP_NODELAY trên kết nối client
+    int db_commit_ms = 10;       // Chu kỳ commit thay đổi của user xuống SQLite
+    size_t db_batch = 512;       // Đủ số user thay đổi này thì commit sớm
+    size_t user_cache = 100000;  // Số record user tối đa giữ trong RAM (cache LRU)
+    std::string stats_file;      // File số liệu metrics (rỗng = <data_dir>/stats.txt)
+    int stats_interval_s = 5;    // Chu kỳ ghi file số liệu (0 = tắt)
+    int resume_timeout_s = 60;   // Giữ phiên bị rớt kết nối để khôi phục bằng resume token (0 = tắt)
+    int auth_workers = 0;        // Số thread kiểm tra mật khẩu (0 = 1/4 số core, ít nhất 1)
+    size_t auth_queue_depth = 1000; // Số lượt đăng nhập tối đa chờ kiểm tra mật khẩu
+    int auth_iterations = 100000;   // Số vòng PBKDF2 khi băm mật khẩu (~50ms/lần trên 1 core)
+    int backlog = 0;                // Hàng đợi kết nối chờ accept của listener (0 = SOMAXCONN)
+    size_t max_connections = 0;     // Tổng số kết nối mở (0 = theo giới hạn số fd của process)
+    size_t ip_connections = 64;     // Số kết nối mở của 1 IP (0 = không giới hạn)
+    double ip_connect_rate = 20;    // Số kết nối mới mỗi giây của 1 IP (0 = không giới hạn)
+    double ip_login_rate = 5;       // Số lần đăng nhập mỗi giây của 1 IP (0 = không giới hạn)
+    int login_timeout_s = 30;       // Thời gian tối đa từ lúc kết nối tới khi đăng nhập xong (0 = tắt)
+    int answer_timeout_s = 30;      // Thời gian trả lời 1 câu, quá hạn tính là sai (0 = tắt)
+    int idle_timeout_s = 120;       // Đóng kết nối không gửi gì trong chừng này giây (0 = tắt)
+    int heartbeat_s = 0;            // Gửi S2C_PING cho kết nối im lặng chừng này giây (0 = tắt)
 };
 
-class Server {
+class Server : public ConnectionHandler {
 public:
-    Server(int port);
+    explicit Server(const ServerConfig& config);
     ~Server();
     bool start();
-    void run(); // Vòng lặp chính để accept client
+    void run(); // Chạy các Reactor (mỗi Reactor 1 thread), không trả về
+
+    // --- SỰ KIỆN TỪ REACTOR (state machine của 1 phiên) ---
+    void onOpen(Connection& conn) override;
+    void onMessage(Connection& conn, const ArenaJson& msg) override;
+    void onDeadline(Connection& conn) override;
+    void onClose(Connection& conn) override;
 
 private:
     /**
-     * @brief Logic xử lý 1 client (Bao gồm Đăng nhập VÀ Chơi game).
+     * @brief C2S_HELLO: chọn encoding cho các thông điệp gửi client (JSON nếu client không đề nghị gì).
+     */
+    void handleHello(Connection& conn, const ArenaJson& hello);
+
+    /**
+     * @brief Trạng thái LOGIN: xử lý C2S_LOGIN_REQUEST.
+     */
+    void handleLogin(Connection& conn, const ArenaJson& request);
+
+    /**
+     * @brief Trạng thái LOGIN: xử lý C2S_RESUME_REQUEST (khôi phục phiên bằng resume token).
+     */
+    void handleResume(Connection& conn, const ArenaJson& request);
+
+    /**
+     * @brief Trạng thái AWAIT_ANSWER: xử lý C2S_SUBMIT_ANSWER ('timed_out': hết giờ, tính là sai).
+     */
+    void handleAnswer(Connection& conn, const ArenaJson& a_msg, bool timed_out = false);
+
+    /**
+     * @brief Chọn câu hỏi mới, gửi S2C_NEW_QUESTION và chuyển sang AWAIT_ANSWER.
+     */
+    void sendQuestion(Connection& conn);
+
+    /**
+     * @brief Trạng thái AWAIT_BATCH: chấm cả lượt speed round (1 lần cập nhật điểm).
+     */
+    void handleBatch(Connection& conn, const ArenaJson& b_msg, bool timed_out = false);
+
+    /**
+     * @brief Chọn N câu, gửi S2C_QUESTION_BATCH trong 1 frame và chuyển sang AWAIT_BATCH.
+     */
+    void sendBatch(Connection& conn);
+
+    /**
+     * @brief Gửi lại các câu đã chọn trong s.batch (S2C_QUESTION_BATCH).
+     */
+    void sendBatchQuestions(Connection& conn);
+
+    // --- PHÒNG CHƠI NHIỀU NGƯỜI ---
+    /**
+     * @brief Vào phòng 'name' (tạo phòng nếu chưa có) và chuyển sang IN_ROOM.
+     */
+    void joinRoom(Connection& conn, const std::string& name);
+
+    /**
+     * @brief Rời phòng khi kết nối đóng; phòng không còn ai thì bị xóa.
+     */
+    void leaveRoom(Connection& conn);
+
+    /**
+     * @brief Trạng thái IN_ROOM: xử lý C2S_SUBMIT_ANSWER cho câu hỏi chung của phòng.
+     */
+    void handleRoomAnswer(Connection& conn, const ArenaJson& a_msg);
+
+    /**
+     * @brief Trạng thái IN_ROOM: hết giờ mà chưa trả lời câu của lượt, tính là trả lời sai.
+     */
+    void handleRoomTimeout(Connection& conn);
+
+    /**
+     * @brief Tính 'me' là hết giờ ở lượt hiện tại (đang giữ room.mutex), kết thúc lượt nếu mọi người đã trả lời.
+     */
+    void timeOutMember(Room& room, Connection& conn, Room::Member& me);
+
+    /**
+     * @brief Kết thúc lượt (đang giữ room.mutex): gửi đáp án + bảng điểm, rồi sang lượt mới.
+     * 'winner' rỗng nếu không ai trả lời đúng.
+     */
+    void endRound(Room& room, const std::string& winner);
+
+    /**
+     * @brief Bắt đầu lượt mới (đang giữ room.mutex): gửi cùng 1 câu hỏi cho cả phòng.
+     */
+    void startRound(Room& room);
+
+    /**
+     * @brief Gửi bảng điểm cho cả phòng (đang giữ room.mutex), mã hóa 1 lần.
+     */
+    void broadcastStandings(Room& room, ArenaJson payload);
+
+    // --- BẢNG XẾP HẠNG ---
+    /**
+     * @brief C2S_LEADERBOARD_REQUEST: gửi 1 đoạn của bảng xếp hạng (O(log n + limit)).
+     */
+    void handleLeaderboard(Connection& conn, const ArenaJson& request);
+
+    /**
+     * @brief C2S_RANK_REQUEST: gửi hạng của 1 user (O(log n)).
+     */
+    void handleRank(Connection& conn, const ArenaJson& request);
+
+    /**
+     * @brief Lưu điểm mới của r vào CSDL và bảng xếp hạng (đang giữ khóa của record).
      */
-    void handleClient(int client_socket);
+    void saveScore(const UserRecord& r);
 
-    // --- PHẦN XỬ LÝ CÂU HỎI ---
-    void loadQuestions(const std::string& filename);
-    Question getRandomQuestion();
+    /**
+     * @brief Thread nền: dựng bảng xếp hạng từ CSDL sau khi server đã khởi động.
+     */
+    void loadLeaderboard();
+
+    // --- KHO CÂU HỎI ---
+    /**
+     * @brief mmap questions_file và publish làm bản đang dùng.
+     * @return false (giữ nguyên bản cũ) nếu file không mở được, hỏng hoặc rỗng.
+     */
+    bool loadQuestions();
+
+    /**
+     * @brief Thread nền: nạp lại kho câu hỏi khi nhận SIGHUP hoặc khi file được thay (inotify).
+     */
+    void reloadLoop();
 
     // --- PHẦN XỬ LÝ USER ---
-    void loadUsers(const std::string& filename);
-    bool saveUsers(const std::string& filename);
-    bool checkLogin(const std::string& user, const std::string& pass, int& attempts, std::string& fail_reason, int& user_db_index);
+    /**
+     * @brief Mở CSDL user; CSDL rỗng thì nhập users.json (lần chạy đầu tiên).
+     */
+    bool openUsers();
+
+    /**
+     * @brief Nhập users.json và WAL cũ (users.wal.old, users.wal) vào CSDL.
+     */
+    bool importUsers(const std::string& filename);
+
+    /**
+     * @brief Băm các mật khẩu dạng rõ của user vừa đọc từ users.json (song song).
+     */
+    bool hashPasswords(std::vector<UserRecord>& records);
+
+    /**
+     * @brief Thread nền: định kỳ ghi snapshot metrics ra stats_file.
+     */
+    void statsLoop();
+
+    /**
+     * @brief Thread nền: mỗi giây gỡ các phiên đỗ quá hạn (bỏ ghim record của chúng)
+     * và trạng thái giới hạn của các IP đã ngừng kết nối.
+     */
+    void reapLoop();
+
+    // --- ĐĂNG NHẬP (mật khẩu được kiểm tra trên auth_executor, không giữ khóa) ---
+    int lookupAccount(const std::string& user, int& attempts, std::string& fail_reason, std::string& stored_password);
+    bool checkLogin(int index, bool password_ok, const std::string& stored_password,
+                    const std::string& upgraded_password, int& attempts, std::string& fail_reason);
+    void finishLogin(Connection& conn, int index, const std::string& user, const std::string& room,
+                     bool password_ok, const std::string& stored_password, const std::string& upgraded_password);
+
+    /**
+     * @brief Gửi S2C_LOGIN_FAILURE; sai đủ 3 lần thì đóng kết nối.
+     */
+    void loginFailed(Connection& conn, const std::string& fail_reason);
 
     // --- BIẾN THÀNH VIÊN ---
     
-    // SỬA CẢNH BÁO -Wreorder: Đổi thứ tự port và server_fd
-    // để khớp với hàm khởi tạo Server::Server
-    int port;
-    int server_fd; 
-    
-    std::vector<Question> questions;
-    std::vector<json> loaded_users; 
-    std::mutex g_users_mutex;         
+    ServerConfig config;
+    std::unique_ptr<Executor> executor;             // Pool worker chạy onMessage
+    std::unique_ptr<Executor> auth_executor;        // Pool riêng cho việc băm mật khẩu (chậm)
+    std::unique_ptr<AdmissionControl> admission;    // Giới hạn kết nối/đăng nhập, Reactor kiểm tra khi accept
+    std::vector<std::unique_ptr<Reactor>> reactors; // Mỗi Reactor có listener riêng (SO_REUSEPORT)
+
+    LiveQuestionBank questions;       // mmap từ questions.bin (make questions), nạp lại được lúc chạy
+    std::unique_ptr<UserDb> db;       // CSDL user; mọi thay đổi score/status ghi vào đây (giữ khóa của record)
+    std::unique_ptr<UserStore> users; // Cache các user đang chơi (khóa theo từng record)
+    Leaderboard leaderboard;          // Điểm của mọi user, dựng từ CSDL ở thread nền (leaderboard_thread)
+
+    // Thread nền: ghi file số liệu, gỡ phiên đỗ quá hạn và IP không còn kết nối, dựng bảng xếp hạng
+    std::thread stats_thread;
+    std::thread reap_thread;
+    std::thread reload_thread;
+    std::thread leaderboard_thread;
+    int reload_fd = -1; // eventfd: SIGHUP (và lúc dừng server) đánh thức reload_thread
+    std::mutex background_mutex;
+    std::condition_variable background_cv;
+    bool stopping = false;
+
+    // User đang đăng nhập và phiên đang chờ khôi phục (chia shard, không có khóa chung)
+    SessionRegistry sessions;
 
-    // --- BIẾN THÀNH VIÊN MỚI ---
-    std::set<std::string> active_sessions; 
-    std::mutex g_session_mutex; // <-- SỬA LỖI 2: Thêm dấu ;
+    // Các phòng đang có người chơi. Thứ tự khóa: rooms_mutex -> Room::mutex -> Connection::mutex
+    std::unordered_map<std::string, std::shared_ptr<Room>> rooms;
+    std::mutex rooms_mutex;
 };
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include "question_deck.hpp"
+
+struct Room;
+class QuestionBank;
+
+/**
+ * @brief Các trạng thái của 1 phiên chơi (state machine thay cho handleClient).
+ * LOGIN -> AUTH_PENDING -> AWAIT_ANSWER (hoặc AWAIT_BATCH nếu chơi speed round) -> GAME_OVER
+ * LOGIN -> AUTH_PENDING -> IN_ROOM (chơi trong phòng đến khi ngắt kết nối)
+ * (AUTH_PENDING quay về LOGIN nếu sai mật khẩu)
+ */
+enum class SessionState {
+    LOGIN,         // Chờ C2S_LOGIN_REQUEST
+    AUTH_PENDING,  // Mật khẩu đang được kiểm tra trên pool xác thực
+    AWAIT_ANSWER,  // Đã gửi câu hỏi, chờ C2S_SUBMIT_ANSWER
+    AWAIT_BATCH,   // Đã gửi S2C_QUESTION_BATCH, chờ C2S_SUBMIT_BATCH
+    IN_ROOM,       // Đang ở phòng chơi nhiều người, chờ C2S_SUBMIT_ANSWER
+    GAME_OVER      // Kết thúc, chỉ chờ gửi nốt dữ liệu rồi đóng kết nối
+};
+
+/**
+ * @brief Dữ liệu của 1 phiên chơi, gắn với 1 kết nối.
+ * Thay cho các biến cục bộ trong handleClient trước đây.
+ */
+struct Session {
+    SessionState state = SessionState::LOGIN;
+    bool is_logged_in = false;
+    int login_attempts = 0;
+    int user_db_index = -1;         // Index của user trong UserStore
+    std::string logged_in_username; // Tên của user đã đăng nhập
+    int current_score = 0;
+    std::shared_ptr<const QuestionBank> bank; // Bản kho câu hỏi của câu/lượt đang chờ trả lời
+    size_t question_index = 0;      // Câu hỏi đang chờ trả lời (index trong bank)
+    int speed_round = 0;            // Số câu mỗi lượt speed round (0 = chơi từng câu)
+    std::vector<size_t> batch;      // Các câu của lượt speed round đang chờ trả lời
+    QuestionDeck deck;              // Thứ tự câu hỏi của phiên (không lặp lại)
+    std::shared_ptr<Room> room;     // Phòng đang chơi (nullptr = chơi 1 mình)
+};
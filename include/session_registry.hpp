@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "session.hpp"
+
+/**
+ * @brief Phần của 1 phiên chơi được giữ lại khi kết nối rớt giữa chừng,
+ * để client kết nối lại bằng resume token mà không phải đăng nhập lại.
+ * Record của user vẫn được ghim trong UserStore (user_db_index) cho tới
+ * khi phiên được khôi phục hoặc hết hạn.
+ */
+struct ResumeState {
+    std::string username;
+    int user_db_index = -1;
+    SessionState state = SessionState::LOGIN;
+    std::shared_ptr<const QuestionBank> bank; // Bản kho câu hỏi mà question_index/batch tham chiếu
+    size_t question_index = 0;  // Câu đang chờ trả lời (AWAIT_ANSWER)
+    int speed_round = 0;
+    std::vector<size_t> batch;  // Lượt speed round đang chờ trả lời (AWAIT_BATCH)
+    QuestionDeck deck;          // Các câu đã rút (phiên khôi phục không gặp lại chúng)
+    std::string room;           // Phòng đang chơi (IN_ROOM)
+    uint64_t deadline = 0;      // Hạn chót của câu/lượt đang chờ (ms, TimingWheel::nowMs), 0 = không có
+};
+
+/**
+ * @brief Danh sách user đang đăng nhập, chia thành SHARDS phần độc lập
+ * (mỗi phần 1 mutex) thay cho 1 std::set + 1 mutex chung.
+ *
+ * Mỗi lần đăng nhập/khôi phục, user nhận 1 resume token ngẫu nhiên (128 bit).
+ * Khi kết nối rớt, phiên được "đỗ" (park) theo token trong resume_timeout_s
+ * giây; resume() tìm lại nó bằng 1 lần tra bảng băm, không qua checkLogin.
+ *
+ * User được xếp vào shard theo hash(username), phiên đang đỗ theo hash(token).
+ * Không hàm nào giữ 2 khóa shard cùng lúc: ai lấy được phiên đỗ ra khỏi
+ * 'parked' thì người đó (và chỉ người đó) được đổi token của user.
+ */
+class SessionRegistry {
+public:
+    explicit SessionRegistry(int resume_timeout_s) : resume_timeout(resume_timeout_s) {}
+
+    /**
+     * @brief Ghi nhận user vừa đăng nhập bằng mật khẩu và cấp token mới.
+     * Nếu user đang có phiên đỗ, phiên đó bị thay thế và
+     * trả về qua 'replaced' để bỏ ghim record của nó.
+     * @return false nếu user đang chơi ở kết nối khác.
+     */
+    bool login(const std::string& username, std::string& token, std::optional<ResumeState>& replaced);
+
+    /**
+     * @brief Xóa user (phiên kết thúc, không giữ lại để khôi phục).
+     */
+    void logout(const std::string& username);
+
+    /**
+     * @brief Đỗ phiên của user vừa rớt kết nối, theo token đã cấp cho user.
+     */
+    void park(ResumeState state);
+
+    /**
+     * @brief Lấy lại phiên đang đỗ theo token và cấp token mới thay cho token cũ.
+     * @return false nếu token không hợp lệ hoặc phiên đã hết hạn.
+     */
+    bool resume(const std::string& token, ResumeState& out, std::string& new_token);
+
+    /**
+     * @brief Gỡ các phiên đỗ quá hạn (và user của chúng), trả về để bỏ ghim record.
+     */
+    std::vector<ResumeState> expire();
+
+    bool resumeEnabled() const { return resume_timeout.count() > 0; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Parked {
+        ResumeState state;
+        Clock::time_point expires;
+    };
+
+    // Căn theo cache line để mutex của các shard cạnh nhau không chia sẻ cache line
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::string> users; // username -> token hiện tại
+        std::unordered_map<std::string, Parked> parked;     // token -> phiên đang đỗ
+    };
+    static const size_t SHARDS = 64;
+
+    Shard& shardFor(const std::string& key) { return shards[std::hash<std::string>()(key) % SHARDS]; }
+    static std::string newToken();
+
+    const std::chrono::seconds resume_timeout;
+    Shard shards[SHARDS];
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/**
+ * @brief Timing wheel phân cấp (LEVELS tầng x SLOTS ô, mỗi tick TICK_MS ms):
+ * hẹn giờ và hủy O(1), không cấp phát (Timer nằm sẵn trong object sở hữu nó,
+ * ví dụ Connection), phù hợp với hàng trăm nghìn timer cùng lúc.
+ *
+ * Tầng 0 chứa timer hết hạn trong SLOTS tick tới; tầng l chứa timer xa hơn,
+ * mỗi ô ứng với SLOTS^l tick. Khi tầng dưới quay hết 1 vòng, ô tương ứng
+ * của tầng trên được "đổ" xuống (cascade) và xếp lại vào các tầng dưới.
+ * Timer xa hơn SLOTS^LEVELS tick bị kéo về hạn xa nhất đó (~46 giờ).
+ *
+ * Không an toàn đa luồng: mỗi Reactor có 1 wheel riêng, chỉ thread của nó dùng.
+ */
+class TimingWheel {
+public:
+    static const uint64_t TICK_MS = 10;
+
+    /**
+     * @brief 1 timer (intrusive). Không được hủy/di chuyển khi đang được hẹn giờ.
+     */
+    struct Timer {
+        std::function<void()> callback; // Chạy trên thread gọi advance()
+        uint64_t expires = 0;           // Tick hết hạn
+        Timer* prev = nullptr;
+        Timer* next = nullptr;
+
+        bool scheduled() const { return next != nullptr; }
+    };
+
+    explicit TimingWheel(uint64_t now_ms);
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    /**
+     * @brief Hẹn 'timer' chạy sau 'delay_ms' (làm tròn lên theo tick); đang hẹn thì hẹn lại.
+     */
+    void schedule(Timer& timer, uint64_t delay_ms);
+
+    /**
+     * @brief Như trên nhưng tính từ 'now_ms' do người gọi đưa vào (cùng đồng hồ với advance()).
+     */
+    void schedule(Timer& timer, uint64_t delay_ms, uint64_t now_ms);
+
+    /**
+     * @brief Hủy hẹn giờ (không làm gì nếu timer chưa được hẹn).
+     */
+    void cancel(Timer& timer);
+
+    /**
+     * @brief Tiến tới 'now_ms' và chạy các timer đã hết hạn.
+     * Callback được phép hẹn/hủy timer bất kỳ (kể cả chính nó).
+     */
+    void advance(uint64_t now_ms);
+
+    /**
+     * @brief Số ms tối đa có thể chờ (epoll_wait) trước lần advance() kế tiếp; -1 nếu không có timer.
+     */
+    int nextTimeoutMs(uint64_t now_ms) const;
+
+    size_t size() const { return count; }
+
+    /**
+     * @brief Đồng hồ của wheel (ms, steady_clock).
+     */
+    static uint64_t nowMs();
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const uint64_t SLOTS = 1 << SLOT_BITS;
+
+    void insert(Timer& timer);
+    void cascade(int level);
+    static void unlink(Timer& timer);
+
+    // Mỗi ô là 1 danh sách vòng có nút đầu giả (sentinel)
+    Timer slots[LEVELS][SLOTS];
+    uint64_t current; // Tick đã xử lý xong
+    size_t count = 0;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+enum class UserStatus : uint8_t {
+    ACTIVE,
+    BLOCKED
+};
+
+UserStatus statusFromString(const std::string& s);
+const char* statusToString(UserStatus s);
+
+/**
+ * @brief 1 tài khoản (1 dòng của bảng users).
+ */
+struct UserRecord {
+    std::string username;
+    std::string password; // Chuỗi băm (password.hpp), hoặc mật khẩu dạng rõ chưa chuyển đổi
+    int32_t score = 0;
+    UserStatus status = UserStatus::ACTIVE;
+};
+
+/**
+ * @brief CSDL user trên SQLite (journal_mode=WAL), thay cho users.json + WAL tự viết.
+ *
+ * load() đọc 1 user bằng prepared statement (không nạp cả bảng lúc khởi động).
+ * save*() chỉ ghi thay đổi vào bộ đệm trong RAM rồi trả về ngay; thread writer
+ * gom các thay đổi (nhiều lần đổi điểm của cùng 1 user chỉ ghi lần cuối) và
+ * ghi trong 1 transaction khi đủ batch_size user hoặc hết commit_interval_ms.
+ * load() luôn thấy cả thay đổi chưa commit, nên cache phía trên được phép bỏ
+ * record bất cứ lúc nào.
+ */
+class UserDb {
+public:
+    UserDb(int commit_interval_ms, size_t batch_size);
+    ~UserDb(); // Commit nốt thay đổi đang chờ, dừng thread writer
+
+    /**
+     * @brief Mở (hoặc tạo) file CSDL, tạo bảng, chuẩn bị statement, chạy thread writer.
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief true nếu bảng users chưa có dòng nào (kiểm tra O(1), không đếm cả bảng).
+     */
+    bool empty();
+
+    /**
+     * @brief Thêm nhiều user trong 1 transaction (dùng khi nhập users.json).
+     */
+    bool insertAll(const std::vector<UserRecord>& users);
+
+    /**
+     * @brief Đọc 1 user theo tên.
+     * @return false nếu không có user này.
+     */
+    bool load(const std::string& username, UserRecord& out);
+
+    /**
+     * @brief Gọi f(username, score) cho mọi user, điểm cao trước; f trả về false thì dừng.
+     * Đọc theo index users_by_score trên 1 kết nối riêng (không sắp xếp cả bảng, không
+     * chặn load()); chưa tính thay đổi chưa commit. Dùng để dựng bảng xếp hạng ở thread nền.
+     */
+    bool forEachScore(const std::function<bool(const std::string&, int32_t)>& f);
+
+    /**
+     * @brief Ghi thay đổi vào bộ đệm (không chờ đĩa).
+     * @return Số thứ tự của thay đổi, dùng cho waitDurable().
+     */
+    uint64_t saveScore(const std::string& username, int32_t score);
+    uint64_t saveStatus(const std::string& username, UserStatus status);
+    uint64_t savePassword(const std::string& username, const std::string& password);
+
+    /**
+     * @brief Chờ đến khi thay đổi 'seq' đã được commit xuống đĩa, tối đa 'timeout'.
+     * Writer được đánh thức để commit ngay (không đợi hết chu kỳ commit).
+     * @return false nếu hết thời gian (đĩa đang lỗi, writer đang thử lại) hoặc đang dừng.
+     */
+    bool waitDurable(uint64_t seq, std::chrono::milliseconds timeout);
+
+private:
+    // Thay đổi chưa commit của 1 user (chỉ giữ giá trị mới nhất)
+    struct PendingUser {
+        bool has_score = false;
+        int32_t score = 0;
+        bool has_status = false;
+        UserStatus status = UserStatus::ACTIVE;
+        bool has_password = false;
+        std::string password;
+    };
+    using PendingMap = std::unordered_map<std::string, PendingUser>;
+
+    static void apply(const PendingUser& change, UserRecord& r);
+    bool exec(const char* sql);
+    bool commitBatch(const PendingMap& batch);
+    void writerLoop();
+
+    int commit_interval_ms;
+    size_t batch_size;
+    std::string path;
+
+    // Kết nối đọc (load) và kết nối ghi (thread writer) tách riêng:
+    // ở chế độ WAL người đọc không chặn người ghi
+    std::mutex read_mutex;
+    sqlite3* read_db = nullptr;
+    sqlite3_stmt* select_user = nullptr;
+    sqlite3_stmt* select_any = nullptr;
+
+    sqlite3* write_db = nullptr;
+    sqlite3_stmt* insert_user = nullptr;
+    sqlite3_stmt* update_score = nullptr;
+    sqlite3_stmt* update_status = nullptr;
+    sqlite3_stmt* update_password = nullptr;
+
+    std::mutex mutex;                 // Bảo vệ các biến bên dưới
+    std::condition_variable commit_cv; // Đánh thức writer
+    std::condition_variable durable_cv;
+    PendingMap pending;               // Thay đổi chưa commit
+    PendingMap committing;            // Thay đổi đang được commit (load() vẫn phải thấy)
+    uint64_t next_seq = 1;
+    uint64_t durable_seq = 0;         // Mọi thay đổi <= durable_seq đã nằm trên đĩa
+    uint64_t urgent_seq = 0;          // Thay đổi lớn nhất đang có thread chờ ở waitDurable()
+    int failed_commits = 0;           // Số lần commit lỗi liên tiếp (writer lùi thời gian thử lại)
+    bool stopping = false;
+    std::thread writer;
+};
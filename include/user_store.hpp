@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "metrics.hpp"
+#include "user_db.hpp"
+
+/**
+ * @brief Cache LRU có giới hạn các record user đang dùng, đặt trước UserDb.
+ *
+ * acquire() trả về ô (slot) chứa record và "ghim" ô đó: record đang ghim
+ * (user đang chơi) không bao giờ bị bỏ khỏi cache, nên index dùng được cho
+ * tới release(). Ô không còn ai ghim nằm trong danh sách LRU và bị dùng lại
+ * cho user khác khi cache đầy. Mỗi record được bảo vệ bởi 1 trong
+ * LOCK_STRIPES mutex (chọn theo index) như trước.
+ *
+ * Index và LRU chia thành SHARDS phần theo hash của username, mỗi phần có mutex
+ * riêng: đăng nhập/đăng xuất của các user khác phần không tranh nhau 1 khóa chung.
+ * Ô thì dùng chung: ô trống lấy từ 1 danh sách chung (chỉ khi cache miss), cache
+ * đầy thì bỏ ô ít dùng nhất của phần mình, phần mình hết ô không ghim thì lấy của
+ * phần khác. LRU vì vậy là gần đúng (theo từng phần).
+ */
+class UserStore {
+public:
+    UserStore(UserDb& db, size_t capacity);
+
+    /**
+     * @brief Tìm user (trong cache, không có thì đọc CSDL) và ghim record.
+     * @return Index của record, NOT_FOUND nếu không có user, CACHE_FULL nếu
+     * mọi ô đều đang bị ghim.
+     */
+    int acquire(const std::string& username);
+
+    /**
+     * @brief Bỏ ghim record đã acquire().
+     */
+    void release(int index);
+
+    static const int NOT_FOUND = -1;
+    static const int CACHE_FULL = -2;
+
+    /**
+     * @brief Gọi f(UserRecord&) trong khi giữ khóa của record 'index' (phải đang ghim).
+     * Thời gian chờ khóa được ghi vào metrics::USER_LOCK_WAIT.
+     */
+    template <typename F>
+    auto withRecord(int index, F&& f) -> decltype(f(std::declval<UserRecord&>())) {
+        auto lock = metrics::lockTimed(stripeFor(index), metrics::USER_LOCK_WAIT);
+        return f(entries[index].record);
+    }
+
+private:
+    struct Entry {
+        UserRecord record;
+        size_t shard = 0;                 // Phần đang giữ ô (đổi khi ô không ghim bị phần khác lấy)
+        int pins = 0;
+        std::list<int>::iterator lru_pos; // Chỉ hợp lệ khi pins == 0
+    };
+
+    // 1 phần của index: user có hash % SHARDS bằng nhau
+    struct alignas(64) Shard {
+        std::mutex mutex;                 // Bảo vệ các biến bên dưới và pins/lru_pos của các ô trong phần
+        std::unordered_map<std::string, int> index_of;
+        std::list<int> lru;               // Ô không bị ghim của phần, cũ nhất ở cuối
+    };
+    static const size_t SHARDS = 64;
+
+    // Căn theo cache line để các mutex cạnh nhau không chia sẻ cache line
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+    };
+    static const size_t LOCK_STRIPES = 1024;
+
+    std::mutex& stripeFor(int index) const { return stripes[index % LOCK_STRIPES].mutex; }
+    void pin(Shard& shard, int index);
+    int takeSlot(size_t home);
+
+    UserDb& db;
+    std::vector<Entry> entries;       // Cấp sẵn 'capacity' ô, không bao giờ đổi kích thước
+    std::vector<Shard> shards;
+
+    std::mutex free_mutex;            // Chỉ bảo vệ free_slots (chỉ dùng khi cache miss)
+    std::vector<int> free_slots;      // Ô chưa dùng
+    mutable std::vector<Stripe> stripes;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * @brief 1 bản ghi thay đổi của user trong WAL cũ (users.wal, users.wal.old).
+ * Giá trị luôn là giá trị tuyệt đối (không phải +1) nên replay lại nhiều lần vẫn đúng.
+ */
+struct WalRecord {
+    enum Op : uint8_t {
+        SET_SCORE = 1,
+        SET_STATUS = 2
+    };
+    Op op;
+    std::string username;
+    int32_t score = 0;      // Dùng khi op == SET_SCORE
+    std::string status;     // Dùng khi op == SET_STATUS
+};
+
+/**
+ * @brief Đọc lại 1 file WAL của phiên bản lưu user bằng users.json, gọi 'apply'
+ * cho từng bản ghi hợp lệ. Chỉ dùng khi nhập dữ liệu cũ vào CSDL SQLite.
+ * Dừng ở bản ghi hỏng đầu tiên (đuôi file bị ghi dở khi crash).
+ *
+ * Định dạng mỗi bản ghi: [u32 độ dài payload][u32 checksum][payload]
+ * payload = [u8 op][u16 len][username] + [i32 score] hoặc [u16 len][status]
+ * (số nguyên lưu theo network byte order).
+ * @return Số bản ghi đã đọc, -1 nếu không mở được file.
+ */
+long replayWal(const std::string& path, const std::function<void(const WalRecord&)>& apply);
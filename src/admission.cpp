@@ -0,0 +1,109 @@
+#include "admission.hpp"
+#include "metrics.hpp"
+#include "protocol.hpp"
+#include <algorithm>
+
+// Bucket chứa tối đa BURST_SECONDS giây token (cho phép dồn dập ngắn hạn)
+static const double BURST_SECONDS = 2.0;
+
+bool AdmissionControl::Bucket::take(double rate, uint64_t now) {
+    double capacity = rate * BURST_SECONDS;
+    if (tokens < 0) {
+        tokens = capacity;
+    } else {
+        tokens = std::min(capacity, tokens + rate * static_cast<double>(now - updated) / 1e9);
+    }
+    updated = now;
+    if (tokens < 1) return false;
+    tokens -= 1;
+    return true;
+}
+
+bool AdmissionControl::Bucket::full(double rate, uint64_t now) const {
+    return tokens < 0 || tokens + rate * static_cast<double>(now - updated) / 1e9 >= rate * BURST_SECONDS;
+}
+
+AdmissionControl::AdmissionControl(const Limits& limits) : limits(limits) {
+    static const char* const MESSAGES[] = {
+        "",
+        "Server is full, please try again later.",
+        "Too many connections from your address.",
+        "Connecting too fast, please slow down.",
+    };
+    for (size_t i = 1; i < 4; ++i) {
+        json busy;
+        busy["action"] = protocol::S2C_SERVER_BUSY;
+        busy["payload"]["message"] = MESSAGES[i];
+        auto frame = std::make_shared<std::string>();
+        protocol::appendFrame(*frame, busy, protocol::Encoding::JSON);
+        frames[i] = std::move(frame);
+    }
+}
+
+AdmissionControl::Verdict AdmissionControl::admit(uint32_t ip) {
+    // Tổng số kết nối: tăng trước rồi trả lại nếu vượt (không cần khóa)
+    size_t total = active.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (limits.max_connections > 0 && total > limits.max_connections) {
+        active.fetch_sub(1, std::memory_order_relaxed);
+        metrics::add(metrics::SHED_SERVER_FULL);
+        return Verdict::SERVER_FULL;
+    }
+
+    Verdict verdict = Verdict::ADMITTED;
+    {
+        Shard& shard = shardFor(ip);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Peer& peer = shard.peers[ip];
+        if (limits.ip_connections > 0 && peer.connections >= limits.ip_connections) {
+            verdict = Verdict::IP_LIMIT;
+        } else if (limits.ip_connect_rate > 0 && !peer.connect.take(limits.ip_connect_rate, metrics::now())) {
+            verdict = Verdict::RATE_LIMIT;
+        } else {
+            peer.connections++;
+        }
+    }
+    if (verdict != Verdict::ADMITTED) {
+        active.fetch_sub(1, std::memory_order_relaxed);
+        metrics::add(verdict == Verdict::IP_LIMIT ? metrics::SHED_IP_LIMIT : metrics::SHED_RATE_LIMIT);
+    }
+    return verdict;
+}
+
+void AdmissionControl::release(uint32_t ip) {
+    active.fetch_sub(1, std::memory_order_relaxed);
+    Shard& shard = shardFor(ip);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.peers.find(ip);
+    if (it != shard.peers.end() && it->second.connections > 0) {
+        it->second.connections--;
+    }
+}
+
+bool AdmissionControl::allowLogin(uint32_t ip) {
+    if (limits.ip_login_rate <= 0) return true;
+    Shard& shard = shardFor(ip);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.peers[ip].login.take(limits.ip_login_rate, metrics::now())) return true;
+    metrics::add(metrics::LOGINS_THROTTLED);
+    return false;
+}
+
+void AdmissionControl::sweep() {
+    uint64_t now = metrics::now();
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.peers.begin(); it != shard.peers.end();) {
+            const Peer& peer = it->second;
+            if (peer.connections == 0 && peer.connect.full(limits.ip_connect_rate, now) &&
+                peer.login.full(limits.ip_login_rate, now)) {
+                it = shard.peers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+const std::string& AdmissionControl::rejection(Verdict verdict) const {
+    return *frames[static_cast<size_t>(verdict)];
+}
@@ -0,0 +1,103 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <new>
+
+static const size_t ALIGN = alignof(std::max_align_t);
+
+static size_t alignUp(size_t n) {
+    return (n + ALIGN - 1) & ~(ALIGN - 1);
+}
+
+// Arena hiện tại của thread (Arena::Scope đặt/khôi phục)
+static thread_local Arena* tls_current = nullptr;
+
+Arena::~Arena() {
+    freeBlocks();
+}
+
+void* Arena::allocate(size_t bytes) {
+    bytes = alignUp(bytes);
+    if (static_cast<size_t>(limit - cursor) < bytes) {
+        addBlock(bytes);
+    }
+    void* p = cursor;
+    cursor += bytes;
+    return p;
+}
+
+/**
+ * @brief Thêm block mới (gấp đôi block trước, tối thiểu MIN_BLOCK) và cấp phát từ đó.
+ */
+void Arena::addBlock(size_t min_bytes) {
+    size_t size = std::max({MIN_BLOCK, blocks ? blocks->size * 2 : 0, alignUp(min_bytes)});
+    Block* block = static_cast<Block*>(::operator new(alignUp(sizeof(Block)) + size));
+    block->next = blocks;
+    block->size = size;
+    blocks = block;
+    cursor = reinterpret_cast<char*>(block) + alignUp(sizeof(Block));
+    limit = cursor + size;
+    total += size;
+    ++block_count;
+}
+
+void Arena::freeBlocks() {
+    while (blocks) {
+        Block* next = blocks->next;
+        ::operator delete(blocks);
+        blocks = next;
+    }
+    cursor = limit = nullptr;
+    total = 0;
+    block_count = 0;
+}
+
+void Arena::reset(size_t idle_limit) {
+    if (!blocks) return;
+    if (block_count == 1 && total <= idle_limit) {
+        // Trường hợp thường gặp: quay con trỏ về đầu block, không gọi heap
+        cursor = reinterpret_cast<char*>(blocks) + alignUp(sizeof(Block));
+        return;
+    }
+    size_t needed = total;
+    freeBlocks();
+    if (needed <= idle_limit) {
+        addBlock(needed); // Lần sau cả thông điệp nằm gọn trong 1 block
+    }
+}
+
+Arena* Arena::current() {
+    return tls_current;
+}
+
+Arena::Scope::Scope(Arena& arena) : previous(tls_current) {
+    tls_current = &arena;
+}
+
+Arena::Scope::~Scope() {
+    tls_current = previous;
+}
+
+namespace {
+    // Đứng trước mỗi vùng do arena::allocate cấp: nơi cấp phát (nullptr = heap chung)
+    struct alignas(std::max_align_t) ChunkHeader {
+        Arena* arena;
+    };
+}
+
+void* arena::allocate(size_t bytes) {
+    Arena* owner = tls_current;
+    size_t size = sizeof(ChunkHeader) + bytes;
+    void* raw = owner ? owner->allocate(size) : ::operator new(size);
+    ChunkHeader* header = static_cast<ChunkHeader*>(raw);
+    header->arena = owner;
+    return header + 1;
+}
+
+void arena::deallocate(void* p) noexcept {
+    if (!p) return;
+    ChunkHeader* header = static_cast<ChunkHeader*>(p) - 1;
+    if (!header->arena) {
+        ::operator delete(header);
+    }
+    // Vùng của arena: thu hồi cả khối ở Arena::reset()
+}
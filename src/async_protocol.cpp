@@ -0,0 +1,42 @@
+#include "async_protocol.hpp"
+#include <cerrno>
+#include <iostream>
+
+coro::Task<bool> protocol::asyncSendMessage(coro::Socket& socket, const json& j, Encoding enc) {
+    FrameWriter writer;
+    writer.add(j, enc);
+    FrameWriter::Status status;
+    while ((status = writer.flush(socket.fd())) == FrameWriter::Status::WOULD_BLOCK) {
+        co_await socket.writable();
+    }
+    co_return status == FrameWriter::Status::DONE;
+}
+
+coro::Task<json> protocol::asyncReceiveMessage(coro::Socket& socket, FrameReader& reader) {
+    while (true) {
+        const char* body;
+        size_t len;
+        FrameReader::Next next = reader.next(body, len);
+        if (next == FrameReader::Next::FRAME) {
+            try {
+                co_return decodeBody(body, len);
+            } catch (json::exception& e) {
+                std::cerr << "JSON parse error: " << e.what() << std::endl;
+                co_return json{};
+            }
+        }
+        if (next == FrameReader::Next::TOO_LARGE) {
+            std::cerr << "Message size too large." << std::endl;
+            co_return json{};
+        }
+
+        ssize_t n = reader.fill(socket.fd());
+        if (n > 0) continue;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            co_await socket.readable();
+            continue;
+        }
+        co_return json{}; // 0 = ngắt kết nối, -1 = lỗi
+    }
+}
@@ -0,0 +1,132 @@
+#include "coro.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Số sự kiện tối đa lấy ra trong 1 lần epoll_wait
+static const int MAX_EVENTS = 256;
+// Thời gian chờ tối đa của epoll_wait (để kiểm tra cờ dừng)
+static const int MAX_WAIT_MS = 100;
+
+coro::EventLoop::EventLoop() : epoll_fd(epoll_create1(EPOLL_CLOEXEC)) {
+    if (epoll_fd < 0) {
+        throw std::runtime_error("epoll_create1 failed");
+    }
+}
+
+coro::EventLoop::~EventLoop() {
+    tasks.clear(); // Hủy frame trước khi đóng epoll: Socket trong frame tự đóng fd
+    ::close(epoll_fd);
+}
+
+/**
+ * @brief Bọc coroutine gốc: không ai co_await nó nên ngoại lệ phải được bắt ở đây.
+ */
+static coro::Task<void> guarded(coro::Task<void> task) {
+    try {
+        co_await task;
+    } catch (const std::exception& e) {
+        std::cerr << "Unhandled exception in coroutine: " << e.what() << std::endl;
+    }
+}
+
+void coro::EventLoop::spawn(Task<void> task) {
+    tasks.push_back(guarded(std::move(task)));
+    tasks.back().handle.resume();
+}
+
+void coro::EventLoop::run(const std::atomic<bool>& stop) {
+    epoll_event events[MAX_EVENTS];
+    while (!stop.load(std::memory_order_relaxed)) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, nextTimeoutMs());
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            return;
+        }
+        // Mỗi fd có nhiều nhất 1 sự kiện trong 1 lần epoll_wait, và coroutine
+        // được chạy tiếp chỉ có thể đóng socket của chính nó
+        for (int i = 0; i < n; ++i) {
+            static_cast<Socket*>(events[i].data.ptr)->onEvent(events[i].events);
+        }
+        runTimers();
+    }
+}
+
+void coro::EventLoop::SleepAwaiter::await_suspend(std::coroutine_handle<> h) {
+    loop.timers.push(Timer{due, loop.timer_seq++, h});
+}
+
+void coro::EventLoop::runTimers() {
+    Clock::time_point now = Clock::now();
+    while (!timers.empty() && timers.top().due <= now) {
+        std::coroutine_handle<> h = timers.top().handle;
+        timers.pop();
+        h.resume();
+    }
+}
+
+int coro::EventLoop::nextTimeoutMs() const {
+    if (timers.empty()) return MAX_WAIT_MS;
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(timers.top().due - Clock::now());
+    // Làm tròn lên: epoll_wait trả về sớm hơn hạn thì vòng sau lại phải chờ thêm
+    return static_cast<int>(std::clamp<long long>(wait.count() + 1, 0, MAX_WAIT_MS));
+}
+
+coro::Task<bool> coro::Socket::connect(const sockaddr_in& addr) {
+    close();
+    socket_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket_fd < 0) co_return false;
+
+    // Đăng ký 1 lần (edge-triggered) cho cả đọc lẫn ghi
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = this;
+    if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, socket_fd, &ev) < 0) {
+        close();
+        co_return false;
+    }
+
+    if (::connect(socket_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        if (errno != EINPROGRESS) {
+            close();
+            co_return false;
+        }
+        co_await writable();
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            close();
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+void coro::Socket::close() {
+    if (socket_fd >= 0) {
+        ::close(socket_fd); // Tự động gỡ khỏi epoll
+        socket_fd = -1;
+    }
+    waiter = nullptr;
+}
+
+coro::Socket::IoAwaiter coro::Socket::readable() {
+    return IoAwaiter{*this, EPOLLIN | EPOLLRDHUP};
+}
+
+coro::Socket::IoAwaiter coro::Socket::writable() {
+    return IoAwaiter{*this, EPOLLOUT};
+}
+
+void coro::Socket::onEvent(uint32_t events) {
+    // Lỗi/peer đóng đánh thức mọi kiểu chờ: lần đọc/ghi kế tiếp sẽ thấy lỗi
+    if (waiter && (events & (wait_events | EPOLLERR | EPOLLHUP))) {
+        std::coroutine_handle<> h = std::exchange(waiter, nullptr);
+        h.resume();
+    }
+}
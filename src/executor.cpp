@@ -0,0 +1,103 @@
+#include "executor.hpp"
+#include "logger.hpp"
+#include <cerrno>
+
+// Pool và index của worker đang chạy trên thread này (nullptr nếu là thread ngoài pool)
+static thread_local const Executor* tls_owner = nullptr;
+static thread_local size_t tls_index = 0;
+
+Executor::Executor(size_t num_workers, size_t queue_depth) : queue_depth(queue_depth) {
+    if (num_workers == 0) num_workers = 1;
+    sem_init(&ready, 0, 0);
+
+    for (size_t i = 0; i < num_workers; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < num_workers; ++i) {
+        threads.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+Executor::~Executor() {
+    stopping = true;
+    for (size_t i = 0; i < threads.size(); ++i) {
+        sem_post(&ready); // Đánh thức mọi worker để chúng thấy cờ stopping
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    sem_destroy(&ready);
+}
+
+/**
+ * @brief Task từ worker của pool vào deque của chính nó,
+ * task từ thread ngoài (Reactor) chia round-robin.
+ */
+bool Executor::trySubmit(std::function<void()> task) {
+    if (queued.fetch_add(1, std::memory_order_relaxed) >= queue_depth) {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return false; // Quá tải
+    }
+
+    size_t index = (tls_owner == this)
+        ? tls_index
+        : next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    sem_post(&ready);
+    return true;
+}
+
+/**
+ * @brief Lấy 1 task: ưu tiên cuối deque của mình (LIFO, cache còn nóng),
+ * sau đó trộm ở đầu deque của các worker khác.
+ */
+bool Executor::takeTask(size_t index, std::function<void()>& task) {
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < workers.size(); ++k) {
+        Worker& victim = *workers[(index + k) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Executor::workerLoop(size_t index) {
+    tls_owner = this;
+    tls_index = index;
+
+    while (true) {
+        // Mỗi lần sem_wait thành công đảm bảo có ít nhất 1 task trong các deque
+        if (sem_wait(&ready) != 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (stopping) return;
+
+        std::function<void()> task;
+        while (!takeTask(index, task)) {
+            std::this_thread::yield(); // Worker khác đang giữ deque, thử lại
+        }
+        queued.fetch_sub(1, std::memory_order_relaxed);
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("Exception in executor task: " << e.what());
+        }
+    }
+}
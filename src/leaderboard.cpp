@@ -0,0 +1,217 @@
+#include "leaderboard.hpp"
+#include <algorithm>
+#include <new>
+#include <unordered_map>
+
+Leaderboard::Node* Leaderboard::createNode(const std::string& username, int32_t score, int level) {
+    void* memory = ::operator new(sizeof(Node) + level * sizeof(Link));
+    Node* node = new (memory) Node(username, score, level);
+    for (int i = 0; i < level; ++i) {
+        new (&node->next()[i]) Link();
+    }
+    return node;
+}
+
+void Leaderboard::destroyNode(Node* node) {
+    node->~Node();
+    ::operator delete(node);
+}
+
+Leaderboard::Leaderboard() : head(createNode("", 0, MAX_LEVEL)), rng_state(0x9E3779B97F4A7C15ULL) {}
+
+Leaderboard::~Leaderboard() {
+    Node* node = head;
+    while (node) {
+        Node* next = node->next()[0].node;
+        destroyNode(node);
+        node = next;
+    }
+}
+
+/**
+ * @brief Số tầng của phần tử mới: lên thêm 1 tầng với xác suất 1/4 (xorshift64).
+ */
+int Leaderboard::randomLevel() {
+    int lvl = 1;
+    while (lvl < MAX_LEVEL) {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 7;
+        rng_state ^= rng_state << 17;
+        if ((rng_state & 3) != 0) break;
+        ++lvl;
+    }
+    return lvl;
+}
+
+void Leaderboard::insert(Node* node) {
+    Node* update[MAX_LEVEL]; // Phần tử cuối cùng đứng trước 'node' ở mỗi tầng
+    size_t rank[MAX_LEVEL];  // Hạng của update[i]
+    Node* cur = head;
+    for (int i = level - 1; i >= 0; --i) {
+        rank[i] = (i == level - 1) ? 0 : rank[i + 1];
+        while (cur->next()[i].node && before(cur->next()[i].node, node->score, node->username)) {
+            rank[i] += cur->next()[i].span;
+            cur = cur->next()[i].node;
+        }
+        update[i] = cur;
+    }
+
+    int node_level = node->level;
+    if (node_level > level) {
+        for (int i = level; i < node_level; ++i) {
+            rank[i] = 0;
+            update[i] = head;
+            head->next()[i].span = length;
+        }
+        level = node_level;
+    }
+
+    for (int i = 0; i < node_level; ++i) {
+        Link& prev = update[i]->next()[i];
+        node->next()[i].node = prev.node;
+        node->next()[i].span = prev.span - (rank[0] - rank[i]);
+        prev.node = node;
+        prev.span = rank[0] - rank[i] + 1;
+    }
+    // Các tầng cao hơn 'node' nhảy qua thêm 1 phần tử
+    for (int i = node_level; i < level; ++i) {
+        update[i]->next()[i].span++;
+    }
+    ++length;
+}
+
+void Leaderboard::erase(Node* node) {
+    Node* cur = head;
+    for (int i = level - 1; i >= 0; --i) {
+        while (cur->next()[i].node && before(cur->next()[i].node, node->score, node->username)) {
+            cur = cur->next()[i].node;
+        }
+        Link& prev = cur->next()[i];
+        if (prev.node == node) {
+            prev.span += node->next()[i].span - 1;
+            prev.node = node->next()[i].node;
+        } else {
+            prev.span--;
+        }
+    }
+    while (level > 1 && head->next()[level - 1].node == nullptr) {
+        --level;
+    }
+    --length;
+}
+
+void Leaderboard::update(const std::string& username, int32_t score) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(username);
+    if (it != index.end()) {
+        Node* node = it->second;
+        if (node->score == score) return;
+        // Gỡ ra rồi chèn lại đúng chỗ (giữ nguyên node, không cấp phát lại)
+        erase(node);
+        node->score = score;
+        insert(node);
+        return;
+    }
+
+    Node* node = createNode(username, score, randomLevel());
+    insert(node);
+    index.emplace(node->username, node);
+}
+
+void Leaderboard::insertIfAbsent(const std::string& username, int32_t score) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index.count(username)) return;
+    Node* node = createNode(username, score, randomLevel());
+    insert(node);
+    index.emplace(node->username, node);
+}
+
+Leaderboard::Entry Leaderboard::rank(const std::string& username) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry;
+    entry.username = username;
+    auto it = index.find(username);
+    if (it == index.end()) return entry;
+
+    const Node* node = it->second;
+    const Node* cur = head;
+    size_t r = 0;
+    for (int i = level - 1; i >= 0 && cur != node; --i) {
+        while (cur->next()[i].node &&
+               (cur->next()[i].node == node || before(cur->next()[i].node, node->score, node->username))) {
+            r += cur->next()[i].span;
+            cur = cur->next()[i].node;
+        }
+    }
+    entry.score = node->score;
+    entry.rank = r;
+    return entry;
+}
+
+std::vector<Leaderboard::Entry> Leaderboard::top(size_t offset, size_t count) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Entry> result;
+    if (offset >= length || count == 0) return result;
+
+    // Nhảy thẳng tới hạng offset + 1 theo span
+    const Node* cur = head;
+    size_t r = 0;
+    for (int i = level - 1; i >= 0 && r < offset + 1; --i) {
+        while (cur->next()[i].node && r + cur->next()[i].span <= offset + 1) {
+            r += cur->next()[i].span;
+            cur = cur->next()[i].node;
+        }
+    }
+
+    result.reserve(std::min(count, length - offset));
+    for (; cur && result.size() < count; cur = cur->next()[0].node, ++r) {
+        result.push_back(Entry{cur->username, cur->score, r});
+    }
+    return result;
+}
+
+size_t Leaderboard::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return length;
+}
+
+bool Leaderboard::checkInvariants() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (level < 1 || level > MAX_LEVEL) return false;
+    if (level > 1 && head->next()[level - 1].node == nullptr) return false; // Tầng trên cùng rỗng phải bị bỏ
+
+    // Tầng 0: đúng thứ tự, đủ 'length' phần tử, index trỏ đúng node; ghi lại hạng của từng node
+    std::unordered_map<const Node*, size_t> rank_of;
+    std::vector<size_t> taller(MAX_LEVEL, 0); // taller[i]: số node có hơn i tầng
+    size_t r = 0;
+    for (const Node* cur = head->next()[0].node, *prev = nullptr; cur; prev = cur, cur = cur->next()[0].node) {
+        if (prev && !before(prev, cur->score, cur->username)) return false;
+        if (cur->level < 1 || cur->level > level) return false;
+        auto it = index.find(cur->username);
+        if (it == index.end() || it->second != cur) return false;
+        rank_of[cur] = ++r;
+        for (int i = 0; i < cur->level; ++i) taller[i]++;
+    }
+    if (r != length || index.size() != length) return false;
+
+    // Mỗi tầng: đi qua đúng các node cao hơn nó, span = chênh lệch hạng (link cuối: tới hết bảng)
+    for (int i = 0; i < level; ++i) {
+        size_t from = 0;
+        size_t visited = 0;
+        for (const Node* cur = head; cur; ) {
+            const Link& link = cur->next()[i];
+            size_t to = length;
+            if (link.node) {
+                auto it = rank_of.find(link.node);
+                if (it == rank_of.end() || it->second <= from || link.node->level <= i) return false;
+                to = it->second;
+                ++visited;
+            }
+            if (link.span != to - from) return false;
+            cur = link.node;
+            from = to;
+        }
+        if (visited != taller[i]) return false;
+    }
+    return true;
+}
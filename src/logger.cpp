@@ -0,0 +1,215 @@
+#include "logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+std::atomic<int> logger::g_level{LOG_LEVEL_INFO};
+
+namespace {
+    // Header của 1 bản ghi trong ring: độ dài text, mức, thời điểm
+    struct RecordHeader {
+        uint32_t length;
+        uint8_t level;
+        int64_t time_ns; // system_clock (để in giờ thực)
+    };
+
+    // Ring buffer của 1 thread: thread đó ghi (tail), flusher đọc (head)
+    struct ThreadRing {
+        static const size_t SIZE = 256 * 1024;
+        char data[SIZE];
+        std::atomic<size_t> head{0}; // Tổng số byte flusher đã đọc
+        std::atomic<size_t> tail{0}; // Tổng số byte thread đã ghi
+        std::atomic<uint64_t> dropped{0};
+
+        void copyIn(size_t pos, const void* src, size_t len) {
+            size_t offset = pos % SIZE;
+            size_t first = std::min(len, SIZE - offset);
+            std::memcpy(data + offset, src, first);
+            std::memcpy(data, static_cast<const char*>(src) + first, len - first);
+        }
+
+        void copyOut(size_t pos, void* dst, size_t len) const {
+            size_t offset = pos % SIZE;
+            size_t first = std::min(len, SIZE - offset);
+            std::memcpy(dst, data + offset, first);
+            std::memcpy(static_cast<char*>(dst) + first, data, len - first);
+        }
+    };
+
+    // Ring của mọi thread; không giải phóng để flusher đọc được cả dòng của thread đã kết thúc
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<ThreadRing>>& registry() {
+        static std::vector<std::unique_ptr<ThreadRing>> rings;
+        return rings;
+    }
+
+    ThreadRing& localRing() {
+        static thread_local ThreadRing* ring = []() {
+            auto owned = std::make_unique<ThreadRing>();
+            ThreadRing* raw = owned.get();
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            registry().push_back(std::move(owned));
+            return raw;
+        }();
+        return *ring;
+    }
+
+    // Buffer định dạng của thread (1 dòng đang dựng)
+    thread_local char line_buf[logger::Line::MAX_LINE];
+
+    // Thread flusher
+    std::mutex flusher_mutex;
+    std::condition_variable flusher_cv;
+    std::thread flusher;
+    bool stopping = false;
+
+    const char* levelName(uint8_t level) {
+        switch (level) {
+            case LOG_LEVEL_DEBUG: return "DEBUG";
+            case LOG_LEVEL_INFO: return "INFO ";
+            case LOG_LEVEL_WARN: return "WARN ";
+            default: return "ERROR";
+        }
+    }
+
+    struct PendingLine {
+        int64_t time_ns;
+        uint8_t level;
+        std::string text;
+    };
+
+    void writeAll(int fd, const std::string& data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return; // Không có chỗ nào để báo lỗi của chính logger
+            }
+            done += n;
+        }
+    }
+
+    /**
+     * @brief Lấy hết dòng đang chờ của mọi thread, sắp theo thời gian và ghi ra
+     * stdout (DEBUG/INFO) hoặc stderr (WARN/ERROR), mỗi nơi 1 lần write().
+     */
+    void drainAll() {
+        std::vector<PendingLine> lines;
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (const auto& ring : registry()) {
+                size_t head = ring->head.load(std::memory_order_relaxed);
+                size_t tail = ring->tail.load(std::memory_order_acquire);
+                while (head < tail) {
+                    RecordHeader header;
+                    ring->copyOut(head, &header, sizeof(header));
+                    PendingLine line{header.time_ns, header.level, std::string(header.length, '\0')};
+                    ring->copyOut(head + sizeof(header), &line.text[0], header.length);
+                    head += sizeof(header) + header.length;
+                    lines.push_back(std::move(line));
+                }
+                ring->head.store(head, std::memory_order_release);
+                dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+            }
+        }
+        if (lines.empty() && dropped == 0) return;
+
+        std::stable_sort(lines.begin(), lines.end(), [](const PendingLine& a, const PendingLine& b) {
+            return a.time_ns < b.time_ns;
+        });
+
+        std::string out, err;
+        for (const auto& line : lines) {
+            time_t seconds = static_cast<time_t>(line.time_ns / 1000000000);
+            int millis = static_cast<int>((line.time_ns / 1000000) % 1000);
+            tm local;
+            localtime_r(&seconds, &local);
+            char stamp[40];
+            size_t n = std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+            std::snprintf(stamp + n, sizeof(stamp) - n, ".%03d ", millis);
+
+            std::string& target = line.level >= LOG_LEVEL_WARN ? err : out;
+            target += stamp;
+            target += levelName(line.level);
+            target += ' ';
+            target += line.text;
+            target += '\n';
+        }
+        if (dropped > 0) {
+            err += "[logger] " + std::to_string(dropped) + " log lines dropped (ring buffer full)\n";
+        }
+        writeAll(STDOUT_FILENO, out);
+        writeAll(STDERR_FILENO, err);
+    }
+}
+
+void logger::setLevel(Level level) {
+    g_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool logger::parseLevel(const std::string& name, Level& level) {
+    if (name == "debug") level = Level::DEBUG;
+    else if (name == "info") level = Level::INFO;
+    else if (name == "warn") level = Level::WARN;
+    else if (name == "error") level = Level::ERROR;
+    else return false;
+    return true;
+}
+
+void logger::start(int flush_interval_ms) {
+    std::lock_guard<std::mutex> lock(flusher_mutex);
+    if (flusher.joinable()) return;
+    stopping = false;
+    flusher = std::thread([flush_interval_ms]() {
+        std::unique_lock<std::mutex> lock(flusher_mutex);
+        while (!stopping) {
+            flusher_cv.wait_for(lock, std::chrono::milliseconds(flush_interval_ms));
+            lock.unlock();
+            drainAll();
+            lock.lock();
+        }
+    });
+}
+
+void logger::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex);
+        stopping = true;
+    }
+    flusher_cv.notify_one();
+    if (flusher.joinable()) flusher.join();
+    drainAll(); // Các dòng ghi sau lần drain cuối của flusher
+}
+
+logger::Line::Line(Level level) : level(level), buf(line_buf, MAX_LINE), out(&buf) {}
+
+logger::Line::~Line() {
+    ThreadRing& ring = localRing();
+    RecordHeader header;
+    header.length = static_cast<uint32_t>(buf.size());
+    header.level = static_cast<uint8_t>(level);
+    header.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    size_t head = ring.head.load(std::memory_order_acquire);
+    size_t needed = sizeof(header) + header.length;
+    if (ThreadRing::SIZE - (tail - head) < needed) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed); // Ring đầy: bỏ dòng, không chờ
+        return;
+    }
+    ring.copyIn(tail, &header, sizeof(header));
+    ring.copyIn(tail + sizeof(header), line_buf, header.length);
+    ring.tail.store(tail + needed, std::memory_order_release);
+}
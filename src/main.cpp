@@ -1,26 +1,123 @@
 #include "server.hpp"
+#include "logger.hpp"
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 // Đặt cổng mặc định
-#define PORT 8081 
+#define PORT 8081
 
-int main() {
-    // Khởi tạo Server
-    Server gameServer(PORT);
+static void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --port N             Listening port (default " << PORT << ")\n"
+              << "  --data-dir DIR       Directory with questions.bin; users.json is imported into an empty database (default ../data)\n"
+              << "  --questions PATH     Compiled question bank from 'make questions' (default <data-dir>/questions.bin)\n"
+              << "  --watch-questions 0|1 Reload the question bank when the file changes (default 1; SIGHUP always reloads)\n"
+              << "  --db PATH            SQLite user database (default ../db/game.db)\n"
+              << "  --reactors N         Epoll threads (default: number of cores)\n"
+              << "  --workers N          Session worker threads (default: 2 x cores)\n"
+              << "  --queue-depth N      Max queued session tasks; clients beyond it are rejected\n"
+              << "  --tcp-nodelay 0|1    Disable Nagle on client sockets (default 1)\n"
+              << "  --db-commit-ms N     Interval between batched user update transactions (default 10, >= 1)\n"
+              << "  --db-batch N         Commit early once N users have pending updates (default 512, >= 1)\n"
+              << "  --user-cache N       Max user records kept in memory (default 100000)\n"
+              << "  --stats-file PATH    Metrics snapshot file (default <data-dir>/stats.txt)\n"
+              << "  --stats-interval N   Seconds between metrics snapshots, 0 = off (default 5)\n"
+              << "  --resume-timeout N   Seconds a dropped session can be resumed, 0 = off (default 60)\n"
+              << "  --auth-workers N     Password hashing threads (default: cores / 4, at least 1)\n"
+              << "  --auth-queue N       Max logins waiting for password check (default 1000)\n"
+              << "  --auth-iterations N  PBKDF2 iterations for stored passwords (default 100000)\n"
+              << "  --backlog N          Listen backlog of each reactor (default SOMAXCONN)\n"
+              << "  --max-connections N  Max open client connections (default: fd limit - 64)\n"
+              << "  --ip-connections N   Max open connections per client IP, 0 = unlimited (default 64)\n"
+              << "  --ip-connect-rate R  New connections per second per client IP, 0 = unlimited (default 20)\n"
+              << "  --ip-login-rate R    Login attempts per second per client IP, 0 = unlimited (default 5)\n"
+              << "  --login-timeout N    Seconds to finish logging in after connecting, 0 = off (default 30)\n"
+              << "  --answer-timeout N   Seconds to answer a question (counts as wrong), 0 = off (default 30)\n"
+              << "  --idle-timeout N     Close connections silent for N seconds, 0 = off (default 120)\n"
+              << "  --heartbeat N        Ping connections silent for N seconds, 0 = off (default 0)\n"
+              << "  --log-level LEVEL    debug, info, warn or error (default info)\n";
+}
 
-    // Bắt đầu (tải data, bind, listen)
-    if (!gameServer.start()) {
-        std::cerr << "Failed to start the server." << std::endl;
+/**
+ * @brief Đọc cấu hình từ dòng lệnh.
+ * @return false nếu tham số không hợp lệ.
+ */
+static bool parseArgs(int argc, char* argv[], ServerConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false; // Mọi tùy chọn đều cần 1 giá trị
+        std::string value = argv[++i];
+        try {
+            if (arg == "--port") config.port = std::stoi(value);
+            else if (arg == "--data-dir") config.data_dir = value;
+            else if (arg == "--reactors") config.num_reactors = std::stoi(value);
+            else if (arg == "--workers") config.num_workers = std::stoi(value);
+            else if (arg == "--queue-depth") config.queue_depth = std::stoul(value);
+            else if (arg == "--tcp-nodelay") config.tcp_nodelay = std::stoi(value) != 0;
+            else if (arg == "--questions") config.questions_file = value;
+            else if (arg == "--watch-questions") config.watch_questions = std::stoi(value) != 0;
+            else if (arg == "--db") config.db_file = value;
+            else if (arg == "--db-commit-ms") config.db_commit_ms = std::stoi(value);
+            else if (arg == "--db-batch") config.db_batch = std::stoul(value);
+            else if (arg == "--user-cache") config.user_cache = std::stoul(value);
+            else if (arg == "--stats-file") config.stats_file = value;
+            else if (arg == "--stats-interval") config.stats_interval_s = std::stoi(value);
+            else if (arg == "--resume-timeout") config.resume_timeout_s = std::stoi(value);
+            else if (arg == "--auth-workers") config.auth_workers = std::stoi(value);
+            else if (arg == "--auth-queue") config.auth_queue_depth = std::stoul(value);
+            else if (arg == "--auth-iterations") config.auth_iterations = std::stoi(value);
+            else if (arg == "--backlog") config.backlog = std::stoi(value);
+            else if (arg == "--max-connections") config.max_connections = std::stoul(value);
+            else if (arg == "--ip-connections") config.ip_connections = std::stoul(value);
+            else if (arg == "--ip-connect-rate") config.ip_connect_rate = std::stod(value);
+            else if (arg == "--ip-login-rate") config.ip_login_rate = std::stod(value);
+            else if (arg == "--login-timeout") config.login_timeout_s = std::stoi(value);
+            else if (arg == "--answer-timeout") config.answer_timeout_s = std::stoi(value);
+            else if (arg == "--idle-timeout") config.idle_timeout_s = std::stoi(value);
+            else if (arg == "--heartbeat") config.heartbeat_s = std::stoi(value);
+            else if (arg == "--log-level") {
+                logger::Level level;
+                if (!logger::parseLevel(value, level)) return false;
+                logger::setLevel(level);
+            }
+            else return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    // Chu kỳ 0 hoặc batch 0 làm thread writer của UserDb quay liên tục
+    return config.db_commit_ms >= 1 && config.db_batch >= 1;
+}
+
+int main(int argc, char* argv[]) {
+    ServerConfig config;
+    config.port = PORT;
+    if (!parseArgs(argc, argv, config)) {
+        printUsage(argv[0]);
         return 1;
     }
+    logger::start(); // Thread ghi log nền
+
+    int status = 0;
+    {
+        // Khởi tạo Server
+        Server gameServer(config);
 
-    // Chạy vòng lặp accept
-    try {
-        gameServer.run();
-    } catch (const std::exception& e) {
-        std::cerr << "Server runtime error: " << e.what() << std::endl;
+        // Bắt đầu (tải data, tạo pool worker, bind, listen)
+        if (!gameServer.start()) {
+            LOG_ERROR("Failed to start the server.");
+            status = 1;
+        } else {
+            // Chạy các Reactor
+            try {
+                gameServer.run();
+            } catch (const std::exception& e) {
+                LOG_ERROR("Server runtime error: " << e.what());
+            }
+        }
     }
 
-    return 0;
+    logger::shutdown(); // Ghi nốt các dòng log còn trong buffer
+    return status;
 }
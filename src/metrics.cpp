@@ -0,0 +1,195 @@
+#include "metrics.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+// Histogram: giá trị < 16 mỗi giá trị 1 ô; sau đó mỗi lũy thừa của 2 có 16 ô.
+// Giá trị từ 2^MAX_EXPONENT ns (~18 phút) trở lên dồn vào ô cuối.
+static const int SUB_BUCKET_BITS = 4;
+static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+static const int MAX_EXPONENT = 40;
+static const size_t NUM_BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+static const char* const COUNTER_NAMES[metrics::NUM_COUNTERS] = {
+    "connections_accepted",
+    "connections_closed",
+    "messages_in",
+    "bytes_in",
+    "logins_ok",
+    "logins_failed",
+    "answers_correct",
+    "answers_wrong",
+    "server_busy",
+    "db_commits",
+    "user_cache_hits",
+    "user_cache_misses",
+    "frames_broadcast",
+    "slow_consumers",
+    "sessions_parked",
+    "sessions_resumed",
+    "sessions_expired",
+    "auth_busy",
+    "passwords_upgraded",
+    "shed_server_full",
+    "shed_ip_limit",
+    "shed_rate_limit",
+    "logins_throttled",
+    "idle_closed",
+    "heartbeats_sent",
+    "login_timeouts",
+    "answer_timeouts",
+    "question_reloads",
+};
+
+static const char* const HISTOGRAM_NAMES[metrics::NUM_HISTOGRAMS] = {
+    "accept",
+    "message_decode",
+    "queue_wait",
+    "login_check",
+    "question_send",
+    "answer_handle",
+    "db_load",
+    "db_commit",
+    "user_lock_wait",
+    "session_lock_wait",
+    "password_verify",
+};
+
+namespace {
+    // Chỉ thread sở hữu ghi (load + store, không cần lệnh atomic RMW);
+    // atomic để thread đọc snapshot không bị data race.
+    inline void bump(std::atomic<uint64_t>& v, uint64_t n) {
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    struct HistogramData {
+        std::atomic<uint64_t> buckets[NUM_BUCKETS] = {};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+    // Căn theo cache line: khối của 2 thread không chia sẻ cache line
+    struct alignas(64) ThreadBlock {
+        std::atomic<uint64_t> counters[metrics::NUM_COUNTERS] = {};
+        HistogramData histograms[metrics::NUM_HISTOGRAMS];
+    };
+
+    // Khối của mọi thread; không bao giờ giải phóng để số liệu còn lại sau khi thread kết thúc
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<ThreadBlock>>& registry() {
+        static std::vector<std::unique_ptr<ThreadBlock>> blocks;
+        return blocks;
+    }
+
+    ThreadBlock& localBlock() {
+        static thread_local ThreadBlock* block = []() {
+            auto owned = std::make_unique<ThreadBlock>();
+            ThreadBlock* raw = owned.get();
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            registry().push_back(std::move(owned));
+            return raw;
+        }();
+        return *block;
+    }
+
+    size_t bucketIndex(uint64_t v) {
+        if (v < static_cast<uint64_t>(SUB_BUCKETS)) return static_cast<size_t>(v);
+        int exponent = 63 - __builtin_clzll(v);
+        if (exponent > MAX_EXPONENT) return NUM_BUCKETS - 1;
+        size_t sub = (v >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    // Giá trị đại diện (giữa ô) của 1 ô
+    double bucketValue(size_t index) {
+        if (index < static_cast<size_t>(SUB_BUCKETS)) return static_cast<double>(index);
+        int exponent = static_cast<int>(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+        uint64_t sub = index % SUB_BUCKETS;
+        uint64_t width = 1ull << (exponent - SUB_BUCKET_BITS);
+        return static_cast<double>((SUB_BUCKETS + sub) * width) + width / 2.0;
+    }
+}
+
+void metrics::add(Counter c, uint64_t n) {
+    bump(localBlock().counters[c], n);
+}
+
+void metrics::record(Histogram h, uint64_t nanos) {
+    HistogramData& data = localBlock().histograms[h];
+    bump(data.buckets[bucketIndex(nanos)], 1);
+    bump(data.count, 1);
+    bump(data.sum, nanos);
+    if (nanos > data.max.load(std::memory_order_relaxed)) {
+        data.max.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+std::string metrics::snapshotText() {
+    uint64_t counters[NUM_COUNTERS] = {};
+    std::vector<uint64_t> buckets(NUM_HISTOGRAMS * NUM_BUCKETS, 0);
+    uint64_t count[NUM_HISTOGRAMS] = {}, sum[NUM_HISTOGRAMS] = {}, max[NUM_HISTOGRAMS] = {};
+
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const auto& block : registry()) {
+            for (int c = 0; c < NUM_COUNTERS; ++c) {
+                counters[c] += block->counters[c].load(std::memory_order_relaxed);
+            }
+            for (int h = 0; h < NUM_HISTOGRAMS; ++h) {
+                const HistogramData& data = block->histograms[h];
+                for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+                    buckets[h * NUM_BUCKETS + b] += data.buckets[b].load(std::memory_order_relaxed);
+                }
+                count[h] += data.count.load(std::memory_order_relaxed);
+                sum[h] += data.sum.load(std::memory_order_relaxed);
+                max[h] = std::max(max[h], data.max.load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    for (int c = 0; c < NUM_COUNTERS; ++c) {
+        out << "counter " << COUNTER_NAMES[c] << " " << counters[c] << "\n";
+    }
+    out << "counter connections_open " << counters[CONNECTIONS_ACCEPTED] - counters[CONNECTIONS_CLOSED] << "\n";
+
+    // Histogram: số mẫu, trung bình và các phân vị, đơn vị micro giây
+    for (int h = 0; h < NUM_HISTOGRAMS; ++h) {
+        out << "histogram " << HISTOGRAM_NAMES[h] << "_us count=" << count[h];
+        if (count[h] > 0) {
+            auto percentile = [&](double p) {
+                uint64_t target = static_cast<uint64_t>(p * (count[h] - 1)) + 1;
+                uint64_t seen = 0;
+                for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+                    seen += buckets[h * NUM_BUCKETS + b];
+                    if (seen >= target) return std::min(bucketValue(b), static_cast<double>(max[h])) / 1000.0;
+                }
+                return max[h] / 1000.0;
+            };
+            out << " mean=" << static_cast<double>(sum[h]) / count[h] / 1000.0
+                << " p50=" << percentile(0.50)
+                << " p90=" << percentile(0.90)
+                << " p99=" << percentile(0.99)
+                << " p999=" << percentile(0.999)
+                << " max=" << max[h] / 1000.0;
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+bool metrics::writeSnapshot(const std::string& path) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream o(tmp);
+        o << snapshotText();
+        if (!o) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
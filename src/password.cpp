@@ -0,0 +1,106 @@
+#include "password.hpp"
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+static const std::string PREFIX = "pbkdf2-sha256$";
+static const size_t SALT_BYTES = 16;
+static const size_t HASH_BYTES = 32; // = kích thước SHA-256
+
+namespace {
+    // 1 giá trị đã băm, tách từ chuỗi lưu trong CSDL
+    struct Parsed {
+        int iterations = 0;
+        std::vector<unsigned char> salt;
+        std::vector<unsigned char> digest;
+    };
+}
+
+static std::string toHex(const unsigned char* data, size_t len) {
+    static const char HEX[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(len * 2);
+    for (size_t i = 0; i < len; ++i) {
+        out.push_back(HEX[data[i] >> 4]);
+        out.push_back(HEX[data[i] & 0xF]);
+    }
+    return out;
+}
+
+static bool fromHex(const std::string& hex, std::vector<unsigned char>& out) {
+    if (hex.size() % 2 != 0) return false;
+    out.clear();
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int value = 0;
+        for (size_t k = i; k < i + 2; ++k) {
+            char c = hex[k];
+            int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+            if (digit < 0) return false;
+            value = value * 16 + digit;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+    return true;
+}
+
+/**
+ * @brief Tách "pbkdf2-sha256$<iter>$<salt>$<hash>".
+ * @return false nếu là mật khẩu dạng rõ hoặc chuỗi băm hỏng.
+ */
+static bool parse(const std::string& stored, Parsed& out) {
+    if (stored.compare(0, PREFIX.size(), PREFIX) != 0) return false;
+    size_t salt_pos = stored.find('$', PREFIX.size());
+    if (salt_pos == std::string::npos) return false;
+    size_t hash_pos = stored.find('$', salt_pos + 1);
+    if (hash_pos == std::string::npos) return false;
+
+    std::string iterations = stored.substr(PREFIX.size(), salt_pos - PREFIX.size());
+    char* end = nullptr;
+    long n = std::strtol(iterations.c_str(), &end, 10);
+    if (iterations.empty() || *end != '\0' || n <= 0 || n > 100000000) return false;
+    out.iterations = static_cast<int>(n);
+    return fromHex(stored.substr(salt_pos + 1, hash_pos - salt_pos - 1), out.salt) && !out.salt.empty() &&
+           fromHex(stored.substr(hash_pos + 1), out.digest) && out.digest.size() == HASH_BYTES;
+}
+
+static void derive(const std::string& plain, const unsigned char* salt, size_t salt_len, int iterations,
+                   unsigned char* digest) {
+    if (PKCS5_PBKDF2_HMAC(plain.data(), static_cast<int>(plain.size()), salt, static_cast<int>(salt_len),
+                          iterations, EVP_sha256(), static_cast<int>(HASH_BYTES), digest) != 1) {
+        throw std::runtime_error("PKCS5_PBKDF2_HMAC failed");
+    }
+}
+
+std::string password::hash(const std::string& plain, int iterations) {
+    unsigned char salt[SALT_BYTES];
+    if (RAND_bytes(salt, sizeof(salt)) != 1) {
+        throw std::runtime_error("RAND_bytes failed");
+    }
+    unsigned char digest[HASH_BYTES];
+    derive(plain, salt, sizeof(salt), iterations, digest);
+    return PREFIX + std::to_string(iterations) + "$" + toHex(salt, sizeof(salt)) + "$" + toHex(digest, sizeof(digest));
+}
+
+bool password::isHashed(const std::string& stored) {
+    return stored.compare(0, PREFIX.size(), PREFIX) == 0;
+}
+
+bool password::verify(const std::string& plain, const std::string& stored) {
+    if (!isHashed(stored)) {
+        // Mật khẩu dạng rõ (chưa chuyển đổi)
+        return plain.size() == stored.size() && CRYPTO_memcmp(plain.data(), stored.data(), plain.size()) == 0;
+    }
+    Parsed parsed;
+    if (!parse(stored, parsed)) return false;
+    unsigned char digest[HASH_BYTES];
+    derive(plain, parsed.salt.data(), parsed.salt.size(), parsed.iterations, digest);
+    return CRYPTO_memcmp(digest, parsed.digest.data(), HASH_BYTES) == 0;
+}
+
+bool password::needsRehash(const std::string& stored, int iterations) {
+    Parsed parsed;
+    return !parse(stored, parsed) || parsed.iterations != iterations;
+}
@@ -1,71 +1,784 @@
 #include "protocol.hpp"
 #include <sys/socket.h>
+#include <sys/uio.h>     // Cho iovec
+#include <netinet/in.h>
+#include <netinet/tcp.h> // Cho TCP_NODELAY
 #include <arpa/inet.h> // Cho htonl, ntohl
 #include <unistd.h>    // Cho read, write, close
 #include <iostream>
 #include <vector>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <charconv>
 
-bool protocol::sendMessage(int socket, const json& j) {
-    // 1. Chuyển JSON thành chuỗi
-    std::string msg_str = j.dump();
+// Byte đầu của thân MessagePack: fixarray 2 phần tử [opcode, payload]
+static const uint8_t MSGPACK_FRAME_TAG = 0x92;
+
+/**
+ * @brief Bảng opcode của chế độ MessagePack: opcode = vị trí trong bảng.
+ * KHÔNG đổi thứ tự, chỉ thêm action mới vào cuối (client cũ dựa vào số này).
+ */
+static const std::string* const OPCODES[] = {
+    nullptr, // 0: không dùng
+    &protocol::C2S_HELLO,
+    &protocol::S2C_HELLO,
+    &protocol::C2S_LOGIN_REQUEST,
+    &protocol::S2C_LOGIN_SUCCESS,
+    &protocol::S2C_LOGIN_FAILURE,
+    &protocol::S2C_NEW_QUESTION,
+    &protocol::C2S_SUBMIT_ANSWER,
+    &protocol::S2C_ANSWER_RESULT,
+    &protocol::S2C_SERVER_BUSY,
+    &protocol::S2C_QUESTION_BATCH,
+    &protocol::C2S_SUBMIT_BATCH,
+    &protocol::S2C_BATCH_RESULT,
+    &protocol::S2C_ROOM_STANDINGS,
+    &protocol::C2S_LEADERBOARD_REQUEST,
+    &protocol::S2C_LEADERBOARD,
+    &protocol::C2S_RANK_REQUEST,
+    &protocol::S2C_RANK,
+    &protocol::C2S_RESUME_REQUEST,
+    &protocol::S2C_PING,
+    &protocol::C2S_PONG,
+};
+static const size_t NUM_OPCODES = sizeof(OPCODES) / sizeof(OPCODES[0]);
+
+static int actionToOpcode(std::string_view action) {
+    for (size_t i = 1; i < NUM_OPCODES; ++i) {
+        if (*OPCODES[i] == action) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+const char* protocol::encodingName(Encoding enc) {
+    return enc == Encoding::MSGPACK ? "msgpack" : "json";
+}
+
+/**
+ * @brief Output adapter ghi thẳng vào cuối 'out' cho serializer/binary_writer của nlohmann.
+ * dump()/to_msgpack() tự tạo adapter bằng make_shared (1 lần cấp phát heap mỗi lần
+ * mã hóa, dump() còn thêm 1 chuỗi tạm); tạo qua ArenaAllocator thì trong Arena::Scope
+ * nó nằm trong arena (adapter chỉ sống trong lần mã hóa này).
+ */
+static nlohmann::detail::output_adapter_t<char> appendTo(std::string& out) {
+    return std::allocate_shared<nlohmann::detail::output_string_adapter<char, std::string>>(
+        ArenaAllocator<char>(), out);
+}
+
+template <typename Json>
+static void encodeBodyOf(std::string& out, const Json& j, protocol::Encoding enc) {
+    if (enc == protocol::Encoding::JSON) {
+        nlohmann::detail::serializer<Json>(appendTo(out), ' ').dump(j, false, false, 0);
+        return;
+    }
+
+    // MessagePack: [opcode, payload]; action lạ (không có trong bảng) giữ nguyên dạng chuỗi
+    nlohmann::detail::binary_writer<Json, char> writer(appendTo(out));
+    out.push_back(static_cast<char>(MSGPACK_FRAME_TAG));
+    auto action = j.find("action");
+    int opcode = (action != j.end() && action->is_string())
+                     ? actionToOpcode(action->template get_ref<const typename Json::string_t&>()) : -1;
+    // Không dùng "cond ? *it : Json()": kết quả là 1 bản chép của cả cây
+    if (opcode > 0) {
+        out.push_back(static_cast<char>(opcode)); // positive fixint (< 128)
+    } else if (action != j.end()) {
+        writer.write_msgpack(*action);
+    } else {
+        writer.write_msgpack(Json());
+    }
+    auto payload = j.find("payload");
+    if (payload != j.end()) {
+        writer.write_msgpack(*payload);
+    } else {
+        writer.write_msgpack(Json::object());
+    }
+}
+
+void protocol::encodeBody(std::string& out, const json& j, Encoding enc) {
+    encodeBodyOf(out, j, enc);
+}
+
+void protocol::encodeBody(std::string& out, const ArenaJson& j, Encoding enc) {
+    encodeBodyOf(out, j, enc);
+}
+
+/**
+ * @brief SAX handler dựng cây json (như json_sax_dom_parser của nlohmann) nhưng
+ * ngăn xếp cấp phát qua ArenaAllocator (nằm trong arena khi giải mã trong Arena::Scope).
+ */
+template <typename Json>
+class DomBuilder {
+public:
+    explicit DomBuilder(Json& root) : root(root) {}
+
+    bool null() { add(nullptr); return true; }
+    bool boolean(bool v) { add(v); return true; }
+    bool number_integer(typename Json::number_integer_t v) { add(v); return true; }
+    bool number_unsigned(typename Json::number_unsigned_t v) { add(v); return true; }
+    bool number_float(typename Json::number_float_t v, const typename Json::string_t&) { add(v); return true; }
+    bool string(typename Json::string_t& v) { add(std::move(v)); return true; }
+    bool binary(typename Json::binary_t& v) { add(std::move(v)); return true; }
+
+    bool start_object(std::size_t) {
+        checkDepth();
+        stack.push_back(add(Json::value_t::object));
+        return true;
+    }
+    bool key(typename Json::string_t& k) {
+        element = &(*stack.back())[std::move(k)];
+        return true;
+    }
+    bool end_object() {
+        stack.pop_back();
+        return true;
+    }
+    bool start_array(std::size_t) {
+        checkDepth();
+        stack.push_back(add(Json::value_t::array));
+        return true;
+    }
+    bool end_array() {
+        stack.pop_back();
+        return true;
+    }
+
+    template <typename Exception>
+    bool parse_error(std::size_t, const std::string&, const Exception& e) {
+        throw e;
+    }
+
+private:
+    // Giới hạn cả độ sâu đệ quy của binary_reader (MessagePack) và của clearTree()
+    void checkDepth() const {
+        if (stack.size() >= protocol::MAX_DEPTH) {
+            throw Json::parse_error::create(113, 0, "nesting deeper than " + std::to_string(protocol::MAX_DEPTH) +
+                                                    " levels", nullptr);
+        }
+    }
+
+    template <typename Value>
+    Json* add(Value&& v) {
+        if (stack.empty()) {
+            root = Json(std::forward<Value>(v));
+            return &root;
+        }
+        Json& parent = *stack.back();
+        if (parent.is_array()) {
+            parent.emplace_back(std::forward<Value>(v));
+            return &parent.back();
+        }
+        *element = Json(std::forward<Value>(v));
+        return element;
+    }
+
+    Json& root;
+    std::vector<Json*, ArenaAllocator<Json*>> stack; // Object/mảng đang mở
+    Json* element = nullptr;                         // Chỗ của giá trị ứng với key vừa đọc
+};
+
+/**
+ * @brief Đọc JSON dạng chữ từ bộ nhớ và gọi các sự kiện SAX của DomBuilder.
+ * Thay cho lexer/parser của nlohmann: chúng giữ token và trạng thái trong std::vector
+ * (heap chung, vài lần cấp phát mỗi thông điệp); ở đây chuỗi đọc thẳng vào string_t
+ * của Json (arena) và số đổi bằng std::from_chars, không cấp phát thêm gì.
+ * Cú pháp theo RFC 8259 (chuỗi phải là UTF-8 hợp lệ), lỗi thì ném parse_error như nlohmann.
+ */
+template <typename Json>
+class TextReader {
+public:
+    TextReader(const char* begin, const char* end, DomBuilder<Json>& sax) : begin(begin), pos(begin), end(end), sax(sax) {}
+
+    void parse() {
+        skipSpace();
+        value();
+        skipSpace();
+        if (pos != end) fail("unexpected data after the value");
+    }
+
+private:
+    using string_t = typename Json::string_t;
+
+    void value() {
+        if (pos == end) fail("unexpected end of input");
+        switch (*pos) {
+        case '{': object(); break;
+        case '[': array(); break;
+        case '"': {
+            string_t s;
+            string(s);
+            sax.string(s);
+            break;
+        }
+        case 't': literal("true"); sax.boolean(true); break;
+        case 'f': literal("false"); sax.boolean(false); break;
+        case 'n': literal("null"); sax.null(); break;
+        default: number(); break;
+        }
+    }
+
+    void object() {
+        ++pos;
+        sax.start_object(static_cast<std::size_t>(-1));
+        skipSpace();
+        if (pos != end && *pos == '}') {
+            ++pos;
+            sax.end_object();
+            return;
+        }
+        while (true) {
+            if (pos == end || *pos != '"') fail("expected a string key");
+            string_t key;
+            string(key);
+            sax.key(key);
+            skipSpace();
+            expect(':');
+            skipSpace();
+            value();
+            skipSpace();
+            if (pos != end && *pos == ',') {
+                ++pos;
+                skipSpace();
+                continue;
+            }
+            expect('}');
+            sax.end_object();
+            return;
+        }
+    }
+
+    void array() {
+        ++pos;
+        sax.start_array(static_cast<std::size_t>(-1));
+        skipSpace();
+        if (pos != end && *pos == ']') {
+            ++pos;
+            sax.end_array();
+            return;
+        }
+        while (true) {
+            value();
+            skipSpace();
+            if (pos != end && *pos == ',') {
+                ++pos;
+                skipSpace();
+                continue;
+            }
+            expect(']');
+            sax.end_array();
+            return;
+        }
+    }
+
+    void string(string_t& out) {
+        ++pos; // Dấu '"' mở
+        while (true) {
+            // Đoạn ký tự thường: chép 1 lần
+            const char* run = pos;
+            while (pos != end && *pos != '"' && *pos != '\\' && static_cast<unsigned char>(*pos) >= 0x20) ++pos;
+            if (pos != run) {
+                validateUtf8(run, pos);
+                out.append(run, pos);
+            }
+            if (pos == end) fail("unterminated string");
+            if (*pos == '"') {
+                ++pos;
+                return;
+            }
+            if (*pos != '\\') fail("control character in string");
+            ++pos;
+            if (pos == end) fail("unterminated string");
+            char c = *pos++;
+            switch (c) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': appendCodePoint(out, codePoint()); break;
+            default: fail("invalid escape in string");
+            }
+        }
+    }
+
+    // \uXXXX (đã đọc "\u"), ghép cặp surrogate thành 1 code point
+    uint32_t codePoint() {
+        uint32_t cp = hex4();
+        if (cp >= 0xDC00 && cp <= 0xDFFF) fail("unpaired surrogate in string");
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+            if (end - pos < 2 || pos[0] != '\\' || pos[1] != 'u') fail("unpaired surrogate in string");
+            pos += 2;
+            uint32_t low = hex4();
+            if (low < 0xDC00 || low > 0xDFFF) fail("unpaired surrogate in string");
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        return cp;
+    }
+
+    uint32_t hex4() {
+        if (end - pos < 4) fail("truncated \\u escape");
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = *pos++;
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= c - '0';
+            else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+            else fail("invalid \\u escape");
+        }
+        return v;
+    }
+
+    static void appendCodePoint(string_t& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    // UTF-8 hợp lệ theo RFC 3629: không có dạng dài thừa, surrogate hay code point > U+10FFFF
+    void validateUtf8(const char* p, const char* e) {
+        while (p != e) {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c < 0x80) {
+                ++p;
+                continue;
+            }
+            size_t n;
+            unsigned char lo = 0x80, hi = 0xBF; // Khoảng hợp lệ của byte tiếp theo thứ nhất
+            if (c >= 0xC2 && c <= 0xDF) n = 1;
+            else if (c >= 0xE0 && c <= 0xEF) {
+                n = 2;
+                if (c == 0xE0) lo = 0xA0;
+                if (c == 0xED) hi = 0x9F;
+            } else if (c >= 0xF0 && c <= 0xF4) {
+                n = 3;
+                if (c == 0xF0) lo = 0x90;
+                if (c == 0xF4) hi = 0x8F;
+            } else {
+                pos = p;
+                fail("invalid UTF-8 byte in string");
+            }
+            if (static_cast<size_t>(e - p) <= n) {
+                pos = p;
+                fail("invalid UTF-8 byte in string");
+            }
+            for (size_t i = 1; i <= n; ++i) {
+                unsigned char b = static_cast<unsigned char>(p[i]);
+                if (b < (i == 1 ? lo : 0x80) || b > (i == 1 ? hi : 0xBF)) {
+                    pos = p + i;
+                    fail("invalid UTF-8 byte in string");
+                }
+            }
+            p += n + 1;
+        }
+    }
+
+    void number() {
+        const char* start = pos;
+        bool negative = pos != end && *pos == '-';
+        if (negative) ++pos;
+        if (pos == end || !isDigit(*pos)) fail("invalid literal");
+        if (*pos == '0') ++pos;
+        else skipDigits();
+        bool integer = true;
+        if (pos != end && *pos == '.') {
+            integer = false;
+            ++pos;
+            if (pos == end || !isDigit(*pos)) fail("invalid number");
+            skipDigits();
+        }
+        if (pos != end && (*pos == 'e' || *pos == 'E')) {
+            integer = false;
+            ++pos;
+            if (pos != end && (*pos == '+' || *pos == '-')) ++pos;
+            if (pos == end || !isDigit(*pos)) fail("invalid number");
+            skipDigits();
+        }
+
+        // Như nlohmann: số nguyên không âm là unsigned, âm là integer, tràn thì thành số thực
+        if (integer && negative) {
+            typename Json::number_integer_t v;
+            if (std::from_chars(start, pos, v).ec == std::errc()) {
+                sax.number_integer(v);
+                return;
+            }
+        } else if (integer) {
+            typename Json::number_unsigned_t v;
+            if (std::from_chars(start, pos, v).ec == std::errc()) {
+                sax.number_unsigned(v);
+                return;
+            }
+        }
+        typename Json::number_float_t v;
+        if (std::from_chars(start, pos, v).ec != std::errc()) fail("number out of range");
+        sax.number_float(v, string_t());
+    }
+
+    void literal(const char* word) {
+        size_t n = std::strlen(word);
+        if (static_cast<size_t>(end - pos) < n || std::memcmp(pos, word, n) != 0) fail("invalid literal");
+        pos += n;
+    }
+
+    void expect(char c) {
+        if (pos == end || *pos != c) fail(pos == end ? "unexpected end of input" : "unexpected character");
+        ++pos;
+    }
+
+    void skipSpace() {
+        while (pos != end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) ++pos;
+    }
+    void skipDigits() {
+        while (pos != end && isDigit(*pos)) ++pos;
+    }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    [[noreturn]] void fail(const char* what) const {
+        throw Json::parse_error::create(101, static_cast<size_t>(pos - begin) + 1,
+                                        std::string("syntax error while parsing JSON - ") + what, nullptr);
+    }
+
+    const char* begin;
+    const char* pos;
+    const char* end;
+    DomBuilder<Json>& sax;
+};
+
+template <typename Json>
+static void clearTreeOf(Json& j) {
+    if (!j.is_object() && !j.is_array()) return;
+    for (auto& item : j) clearTreeOf(item); // Duyệt giá trị của cả object lẫn mảng
+    j.clear(); // Mọi phần tử giờ là giá trị đơn hoặc object/mảng rỗng: destroy() không cần ngăn xếp tạm
+    j = nullptr;
+}
+
+void protocol::clearTree(ArenaJson& j) {
+    clearTreeOf(j);
+}
+
+template <typename Json>
+Json protocol::decodeBody(const char* data, size_t len) {
+    Json frame;
+    DomBuilder<Json> builder(frame);
+    if (len == 0 || static_cast<uint8_t>(data[0]) != MSGPACK_FRAME_TAG) {
+        TextReader<Json>(data, data + len, builder).parse();
+        return frame;
+    }
+
+    Json::sax_parse(data, data + len, &builder, Json::input_format_t::msgpack);
+    Json msg;
+    const Json& op = frame[0];
+    if (op.is_number_unsigned() && op.template get<size_t>() > 0 && op.template get<size_t>() < NUM_OPCODES) {
+        msg["action"] = *OPCODES[op.template get<size_t>()];
+    } else if (op.is_string()) {
+        msg["action"] = op;
+    } else {
+        msg["action"] = ""; // Opcode không biết: để logic phía trên từ chối
+    }
+    msg["payload"] = std::move(frame[1]);
+    clearTreeOf(frame);
+    return msg;
+}
+
+template json protocol::decodeBody<json>(const char* data, size_t len);
+template ArenaJson protocol::decodeBody<ArenaJson>(const char* data, size_t len);
+
+template <typename Json>
+static std::string_view actionOfMessage(const Json& msg) {
+    if (!msg.is_object()) return {};
+    auto action = msg.find("action");
+    if (action == msg.end() || !action->is_string()) return {};
+    return action->template get_ref<const typename Json::string_t&>();
+}
+
+std::string_view protocol::actionOf(const json& msg) {
+    return actionOfMessage(msg);
+}
+
+std::string_view protocol::actionOf(const ArenaJson& msg) {
+    return actionOfMessage(msg);
+}
+
+/**
+ * @brief Gửi toàn bộ các iovec, gọi lại sendmsg khi chỉ gửi được 1 phần.
+ * @return Số byte chưa gửi được khi socket non-blocking đầy (0 = xong), -1 nếu lỗi.
+ */
+static ssize_t sendAll(int socket, iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                ssize_t left = 0;
+                for (int i = 0; i < iovcnt; ++i) left += iov[i].iov_len;
+                return left;
+            }
+            return -1;
+        }
+
+        // Bỏ qua các iovec đã gửi xong, cắt bớt iovec gửi dở
+        while (iovcnt > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+bool protocol::sendMessage(int socket, const json& j, Encoding enc) {
+    // 1. Mã hóa thông điệp (JSON hoặc MessagePack)
+    std::string msg_str;
+    encodeBody(msg_str, j, enc);
     
     // 2. Lấy độ dài và chuyển sang Network Byte Order
     uint32_t len = msg_str.length();
     uint32_t n_len = htonl(len); // Host To Network Long
 
-    // 3. Gửi 4 bytes độ dài
-    if (send(socket, &n_len, sizeof(n_len), 0) == -1) {
-        perror("send(length)");
+    // 3. Gửi 4 bytes độ dài + thân trong cùng 1 syscall (không tách thành 2 gói TCP)
+    iovec iov[2];
+    iov[0].iov_base = &n_len;
+    iov[0].iov_len = sizeof(n_len);
+    iov[1].iov_base = const_cast<char*>(msg_str.data());
+    iov[1].iov_len = len;
+    if (sendAll(socket, iov, 2) != 0) {
+        perror("send");
         return false;
     }
+    
+    return true;
+}
+
+template <typename Json>
+static protocol::PreparedFrame prepareFrameOf(const Json& j) {
+    // Frame dùng chung giữa các kết nối: chuỗi đã mã hóa luôn nằm trên heap, không trong arena
+    protocol::PreparedFrame frame;
+    for (protocol::Encoding enc : {protocol::Encoding::JSON, protocol::Encoding::MSGPACK}) {
+        auto encoded = std::make_shared<std::string>();
+        protocol::appendFrame(*encoded, j, enc);
+        frame.encoded[static_cast<size_t>(enc)] = std::move(encoded);
+    }
+    return frame;
+}
+
+protocol::PreparedFrame protocol::prepareFrame(const json& j) {
+    return prepareFrameOf(j);
+}
+
+protocol::PreparedFrame protocol::prepareFrame(const ArenaJson& j) {
+    return prepareFrameOf(j);
+}
+
+void protocol::FrameWriter::add(const json& j, Encoding enc) {
+    size_t start = owned.size();
+    appendFrame(owned, j, enc);
+    addOwned(start);
+}
+
+void protocol::FrameWriter::add(const ArenaJson& j, Encoding enc) {
+    size_t start = owned.size();
+    appendFrame(owned, j, enc);
+    addOwned(start);
+}
+
+void protocol::FrameWriter::addOwned(size_t start) {
+    queued += owned.size() - start;
+    // Gộp với segment trước nếu nó cũng nằm liền kề trong 'owned'
+    if (!segments.empty() && !segments.back().data &&
+        segments.back().offset + segments.back().length == start) {
+        segments.back().length += owned.size() - start;
+    } else {
+        segments.push_back(Segment{start, owned.size() - start, nullptr, nullptr});
+    }
+}
+
+void protocol::FrameWriter::addShared(std::shared_ptr<const std::string> frame) {
+    if (!frame || frame->empty()) return;
+    const char* data = frame->data();
+    size_t len = frame->size();
+    addView(std::move(frame), data, len);
+}
+
+void protocol::FrameWriter::addView(std::shared_ptr<const void> owner, const char* data, size_t len) {
+    if (!data || len == 0) return;
+    queued += len;
+    segments.push_back(Segment{0, len, data, std::move(owner)});
+}
+
+protocol::FrameWriter::Status protocol::FrameWriter::flush(int socket) {
+    // Số iovec tối đa cho 1 lần sendmsg
+    static const size_t MAX_IOV = 64;
+
+    while (!segments.empty()) {
+        iovec iov[MAX_IOV];
+        size_t count = std::min(segments.size(), MAX_IOV);
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const Segment& seg = segments[i];
+            const char* base = seg.data ? seg.data : owned.data() + seg.offset;
+            size_t skip = (i == 0) ? head_sent : 0;
+            iov[i].iov_base = const_cast<char*>(base + skip);
+            iov[i].iov_len = seg.length - skip;
+            total += iov[i].iov_len;
+        }
+
+        ssize_t left = sendAll(socket, iov, static_cast<int>(count));
+        if (left < 0) {
+            return Status::FAILED;
+        }
+
+        // Bỏ các segment đã gửi xong
+        queued -= total - left;
+        size_t sent = total - left + head_sent;
+        size_t done = 0;
+        while (done < count && sent >= segments[done].length) {
+            sent -= segments[done].length;
+            ++done;
+        }
+        segments.erase(segments.begin(), segments.begin() + done);
+        head_sent = sent;
+
+        if (left > 0) {
+            return Status::WOULD_BLOCK;
+        }
+    }
 
-    // 4. Gửi chuỗi JSON
-    if (send(socket, msg_str.c_str(), len, 0) == -1) {
-        perror("send(data)");
+    owned.clear();
+    head_sent = 0;
+    return Status::DONE;
+}
+
+void protocol::FrameWriter::release(size_t idle_limit) {
+    if (empty() && owned.capacity() > idle_limit) {
+        std::string().swap(owned);
+    }
+}
+
+bool protocol::setNoDelay(int socket, bool enabled) {
+    int opt = enabled ? 1 : 0;
+    if (setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt(TCP_NODELAY)");
         return false;
     }
-    
     return true;
 }
 
-json protocol::receiveMessage(int socket) {
-    // 1. Nhận 4 bytes độ dài
-    uint32_t n_len;
-    ssize_t len_bytes_read = recv(socket, &n_len, sizeof(n_len), 0);
-    
-    if (len_bytes_read <= 0) {
-        // 0 = client ngắt kết nối, -1 = lỗi
-        return json{}; // Trả về JSON rỗng
+template <typename Json>
+static void appendFrameOf(std::string& out, const Json& j, protocol::Encoding enc) {
+    // Chừa chỗ cho 4-byte độ dài, mã hóa thẳng vào 'out' rồi điền độ dài sau
+    size_t start = out.size();
+    out.append(sizeof(uint32_t), '\0');
+    protocol::encodeBody(out, j, enc);
+    uint32_t n_len = htonl(out.size() - start - sizeof(uint32_t));
+    std::memcpy(&out[start], &n_len, sizeof(n_len));
+}
+
+void protocol::appendFrame(std::string& out, const json& j, Encoding enc) {
+    appendFrameOf(out, j, enc);
+}
+
+void protocol::appendFrame(std::string& out, const ArenaJson& j, Encoding enc) {
+    appendFrameOf(out, j, enc);
+}
+
+ssize_t protocol::FrameReader::fill(int socket) {
+    if (head == tail) {
+        head = tail = 0; // Buffer rỗng: đọc lại từ đầu
     }
+    if (capacity - tail < MIN_READ) {
+        if (head > 0) {
+            // Dồn phần chưa xử lý về đầu buffer
+            std::memmove(data.get(), data.get() + head, tail - head);
+            tail -= head;
+            head = 0;
+        }
+        if (capacity - tail < MIN_READ) {
+            // Nới gấp đôi (frame lớn chỉ làm buffer lớn dần theo dữ liệu đã nhận)
+            size_t new_capacity = std::max(capacity * 2, MIN_READ);
+            std::unique_ptr<char[]> bigger(new char[new_capacity]);
+            std::memcpy(bigger.get(), data.get(), tail);
+            data = std::move(bigger);
+            capacity = new_capacity;
+        }
+    }
+    ssize_t n = recv(socket, data.get() + tail, capacity - tail, 0);
+    if (n > 0) {
+        tail += n;
+    }
+    return n;
+}
 
-    // 2. Chuyển về Host Byte Order
-    uint32_t len = ntohl(n_len); // Network To Host Long
+protocol::FrameReader::Next protocol::FrameReader::next(const char*& body, size_t& len) {
+    if (tail - head < sizeof(uint32_t)) {
+        return Next::INCOMPLETE;
+    }
+    uint32_t n_len;
+    std::memcpy(&n_len, data.get() + head, sizeof(n_len));
+    uint32_t frame_len = ntohl(n_len);
+    if (frame_len > MAX_MESSAGE_SIZE) {
+        return Next::TOO_LARGE;
+    }
+    if (tail - head - sizeof(n_len) < frame_len) {
+        return Next::INCOMPLETE;
+    }
+    body = data.get() + head + sizeof(n_len);
+    len = frame_len;
+    head += sizeof(n_len) + frame_len;
+    return Next::FRAME;
+}
 
-    // Giới hạn an toàn, tránh bị tấn công OOM
-    if (len > 10 * 1024 * 1024) { // 10MB
-        std::cerr << "Message size too large: " << len << std::endl;
-        return json{};
+void protocol::FrameReader::release(size_t idle_limit) {
+    if (empty() && capacity > idle_limit) {
+        data.reset();
+        capacity = head = tail = 0;
     }
+}
 
-    // 3. Đọc chính xác 'len' bytes
-    std::vector<char> buffer(len);
-    ssize_t total_bytes_read = 0;
-    
-    while (total_bytes_read < len) {
-        ssize_t bytes_read = recv(socket, buffer.data() + total_bytes_read, len - total_bytes_read, 0);
-        if (bytes_read <= 0) {
-            // Lỗi hoặc ngắt kết nối khi đang đọc dở
+json protocol::receiveMessage(int socket, FrameReader& reader) {
+    while (true) {
+        const char* body;
+        size_t len;
+        FrameReader::Next next = reader.next(body, len);
+        if (next == FrameReader::Next::FRAME) {
+            try {
+                return decodeBody(body, len);
+            } catch (json::exception& e) {
+                std::cerr << "JSON parse error: " << e.what() << std::endl;
+                return json{};
+            }
+        }
+        if (next == FrameReader::Next::TOO_LARGE) {
+            std::cerr << "Message size too large." << std::endl;
             return json{};
         }
-        total_bytes_read += bytes_read;
-    }
 
-    // 4. Chuyển buffer thành chuỗi và parse JSON
-    std::string msg_str(buffer.data(), len);
-    try {
-        return json::parse(msg_str);
-    } catch (json::parse_error& e) {
-        std::cerr << "JSON parse error: " << e.what() << std::endl;
-        return json{};
+        ssize_t n = reader.fill(socket);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            // 0 = ngắt kết nối, -1 = lỗi
+            return json{};
+        }
     }
-}
\ No newline at end of file
+}
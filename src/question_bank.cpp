@@ -0,0 +1,82 @@
+#include "question_bank.hpp"
+#include "logger.hpp"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+QuestionBank::Mapping::~Mapping() {
+    if (base) munmap(base, length);
+}
+
+bool QuestionBank::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Cannot open question bank " << path << ": " << std::strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(qbank::FileHeader)) {
+        LOG_ERROR("Question bank " << path << " is too small.");
+        close(fd);
+        return false;
+    }
+
+    auto map = std::make_shared<Mapping>();
+    map->length = static_cast<size_t>(st.st_size);
+    map->base = mmap(nullptr, map->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // Vùng mmap vẫn còn sau khi đóng fd
+    if (map->base == MAP_FAILED) {
+        map->base = nullptr;
+        LOG_ERROR("mmap(" << path << "): " << std::strerror(errno));
+        return false;
+    }
+    madvise(map->base, map->length, MADV_RANDOM); // Câu hỏi được chọn ngẫu nhiên
+
+    const char* base = static_cast<const char*>(map->base);
+    const auto* header = reinterpret_cast<const qbank::FileHeader*>(base);
+    if (header->magic != qbank::MAGIC || header->version != qbank::VERSION) {
+        LOG_ERROR("Question bank " << path << " has an unknown format (rebuild it with make questions).");
+        return false;
+    }
+
+    // Kiểm tra các bảng nằm trong file (không đọc từng câu: O(1) theo số câu hỏi)
+    uint64_t tables = sizeof(qbank::FileHeader) +
+                      static_cast<uint64_t>(header->count) * sizeof(qbank::QuestionEntry) +
+                      static_cast<uint64_t>(header->option_count) * sizeof(qbank::OptionEntry);
+    if (tables > header->pool_offset || header->pool_offset > map->length ||
+        header->pool_size > map->length - header->pool_offset) {
+        LOG_ERROR("Question bank " << path << " is truncated or corrupt.");
+        return false;
+    }
+
+    questions = reinterpret_cast<const qbank::QuestionEntry*>(base + sizeof(qbank::FileHeader));
+    options = reinterpret_cast<const qbank::OptionEntry*>(questions + header->count);
+    pool = base + header->pool_offset;
+    count = header->count;
+    option_count = header->option_count;
+    pool_size = header->pool_size;
+    mapping = std::move(map);
+    return true;
+}
+
+std::string_view QuestionBank::Question::optionKey(size_t i) const {
+    size_t index = static_cast<size_t>(entry->first_option) + i;
+    return index < bank->option_count ? bank->str(bank->options[index].key) : std::string_view();
+}
+
+std::string_view QuestionBank::Question::optionValue(size_t i) const {
+    size_t index = static_cast<size_t>(entry->first_option) + i;
+    return index < bank->option_count ? bank->str(bank->options[index].value) : std::string_view();
+}
+
+protocol::FrameView QuestionBank::Question::frame() const {
+    protocol::FrameView view;
+    view.owner = bank->mapping;
+    for (size_t enc = 0; enc < 2; ++enc) {
+        view.encoded[enc] = bank->str(entry->frame[enc]);
+    }
+    return view;
+}
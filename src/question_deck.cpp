@@ -0,0 +1,82 @@
+#include "question_deck.hpp"
+#include <cerrno>
+#include <stdexcept>
+#include <sys/random.h>
+
+/**
+ * @brief Hạt giống cho deck mới: mỗi thread lấy 1 giá trị từ getrandom lần
+ * đầu rồi cộng dần hằng số Weyl, nên tạo deck không cần system call hay khóa.
+ */
+static uint64_t nextSeed() {
+    thread_local uint64_t seed = [] {
+        uint64_t value = 0;
+        while (getrandom(&value, sizeof(value), 0) != static_cast<ssize_t>(sizeof(value))) {
+            if (errno != EINTR) throw std::runtime_error("getrandom failed");
+        }
+        return value;
+    }();
+    seed += 0x9E3779B97F4A7C15ULL;
+    return seed;
+}
+
+QuestionDeck::QuestionDeck() : rng_state(nextSeed()) {}
+
+/**
+ * @brief SplitMix64.
+ */
+uint64_t QuestionDeck::next() {
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+size_t QuestionDeck::draw(size_t n) {
+    if (n != size || drawn == size) {
+        // Bộ mới (lần đầu, đã rút hết, hoặc QuestionBank đổi kích thước)
+        size = n;
+        drawn = 0;
+        while (!swapped.empty()) {
+            spare.push_back(swapped.extract(swapped.begin())); // Giữ nút lại cho bộ mới
+        }
+    }
+
+    // Chọn 1 vị trí ngẫu nhiên trong phần chưa rút [drawn, size)
+    // (nhân 128 bit thay cho phép chia lấy dư)
+    uint64_t remaining = size - drawn;
+    uint32_t pick = static_cast<uint32_t>(drawn + static_cast<uint64_t>(
+        (static_cast<unsigned __int128>(next()) * remaining) >> 64));
+    uint32_t front = static_cast<uint32_t>(drawn);
+
+    // Vị trí chưa bị đổi chỗ thì chứa chính index của nó
+    auto pick_it = swapped.find(pick);
+    uint32_t result = pick_it != swapped.end() ? pick_it->second : pick;
+
+    // Đổi chỗ: phần tử ở 'front' chuyển tới 'pick' (front sẽ không bao giờ được đọc lại,
+    // nút của nó được tách ra để dùng lại thay vì cấp phát nút mới)
+    auto front_node = swapped.extract(front);
+    if (pick != front) {
+        uint32_t front_value = front_node ? front_node.mapped() : front;
+        if (pick_it != swapped.end()) {
+            pick_it->second = front_value;
+        } else {
+            if (!front_node && !spare.empty()) {
+                front_node = std::move(spare.back());
+                spare.pop_back();
+            }
+            if (front_node) {
+                front_node.key() = pick;
+                front_node.mapped() = front_value;
+                swapped.insert(std::move(front_node));
+            } else {
+                swapped.emplace(pick, front_value);
+            }
+        }
+    }
+    if (front_node) {
+        spare.push_back(std::move(front_node));
+    }
+
+    ++drawn;
+    return result;
+}
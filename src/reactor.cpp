@@ -0,0 +1,777 @@
+#include "reactor.hpp"
+#include "protocol.hpp"
+#include "metrics.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h> // Cho ntohl
+#include <unistd.h>
+
+// Số sự kiện tối đa lấy ra trong 1 lần epoll_wait
+static const int MAX_EVENTS = 256;
+// Nếu buffer của kết nối rảnh mà vẫn giữ nhiều hơn mức này thì trả lại bộ nhớ
+static const size_t IDLE_BUFFER_LIMIT = 4 * 1024;
+// Executor đầy khi post(): thử tạo lại task xử lý inbox sau chừng này ms
+static const int DRAIN_RETRY_MS = 5;
+
+void Connection::send(const json& j) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.add(j, encoding);
+}
+
+void Connection::send(ArenaJson&& j) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.add(j, encoding);
+    }
+    protocol::clearTree(j);
+}
+
+void Connection::send(const protocol::PreparedFrame& frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.add(frame, encoding);
+}
+
+void Connection::send(const protocol::FrameView& frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.add(frame, encoding);
+}
+
+/**
+ * @brief Chung cho 2 bản push(): frame chỉ được tham chiếu, không chép.
+ */
+template <typename Frame>
+static bool pushFrame(Connection& conn, const Frame& frame) {
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        if (conn.closing || conn.closed) return false;
+        if (conn.out.pending() > Connection::MAX_SEND_QUEUE) {
+            // Client không đọc kịp: bỏ phần chưa gửi và đóng (Reactor đóng sau khi flush)
+            LOG_WARN("Client " << conn.fd << " is too slow (" << conn.out.pending()
+                     << " bytes queued), disconnecting.");
+            metrics::add(metrics::SLOW_CONSUMERS);
+            conn.out = protocol::FrameWriter();
+            conn.closing = true;
+        } else {
+            conn.out.add(frame, conn.encoding);
+        }
+    }
+    conn.owner->requestFlush(conn.shared_from_this());
+    return true;
+}
+
+bool Connection::push(const protocol::PreparedFrame& frame) {
+    return pushFrame(*this, frame);
+}
+
+bool Connection::push(const protocol::FrameView& frame) {
+    return pushFrame(*this, frame);
+}
+
+void Connection::setEncoding(protocol::Encoding enc) {
+    std::lock_guard<std::mutex> lock(mutex);
+    encoding = enc;
+}
+
+void Connection::closeAfterFlush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+}
+
+void Connection::setDeadline(std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    deadline = timeout.count() > 0 ? TimingWheel::nowMs() + timeout.count() : 0;
+    deadline_seq++;
+    deadline_changed = true;
+}
+
+uint64_t Connection::deadlineAt() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return deadline;
+}
+
+/**
+ * @brief S2C_PING dùng chung cho mọi kết nối (mã hóa 1 lần).
+ */
+static const protocol::PreparedFrame& pingFrame() {
+    static const protocol::PreparedFrame frame = [] {
+        json ping;
+        ping["action"] = protocol::S2C_PING;
+        ping["payload"] = json::object();
+        return protocol::prepareFrame(ping);
+    }();
+    return frame;
+}
+
+Reactor::Reactor(int id, ConnectionHandler& handler, Executor& executor, const ReactorOptions& options)
+    : id(id), handler(handler), executor(executor), options(options), listen_fd(-1), epoll_fd(-1), wake_fd(-1),
+      spare_fd(-1), wheel(TimingWheel::nowMs()), now_ms(TimingWheel::nowMs()) {}
+
+Reactor::~Reactor() {
+    for (auto& [fd, conn] : connections) {
+        close(fd);
+    }
+    if (listen_fd != -1) close(listen_fd);
+    if (wake_fd != -1) close(wake_fd);
+    if (spare_fd != -1) close(spare_fd);
+    if (epoll_fd != -1) close(epoll_fd);
+}
+
+/**
+ * @brief Tạo listener non-blocking với SO_REUSEPORT và đăng ký vào epoll.
+ */
+bool Reactor::open(int port) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        LOG_ERROR("epoll_create1: " << std::strerror(errno));
+        return false;
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        LOG_ERROR("eventfd: " << std::strerror(errno));
+        return false;
+    }
+    epoll_event wev{};
+    wev.events = EPOLLIN;
+    wev.data.ptr = &wake_fd; // Đánh dấu sự kiện của eventfd
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wev) < 0) {
+        LOG_ERROR("epoll_ctl(eventfd): " << std::strerror(errno));
+        return false;
+    }
+
+    spare_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        LOG_ERROR("socket failed: " << std::strerror(errno));
+        return false;
+    }
+
+    // SO_REUSEADDR: tái sử dụng port ngay; SO_REUSEPORT: nhiều listener chung 1 port
+    int opt = 1;
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        LOG_ERROR("setsockopt: " << std::strerror(errno));
+        return false;
+    }
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        LOG_ERROR("bind failed: " << std::strerror(errno));
+        return false;
+    }
+
+    if (listen(listen_fd, options.backlog) < 0) {
+        LOG_ERROR("listen: " << std::strerror(errno));
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr; // nullptr = listener
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        LOG_ERROR("epoll_ctl(listen): " << std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Vòng lặp sự kiện chính của Reactor.
+ */
+void Reactor::run() {
+    epoll_event events[MAX_EVENTS];
+
+    while (true) {
+        // Không có timer thì chờ vô hạn; có thì thức dậy đúng tick của timer gần nhất
+        int timeout = wheel.nextTimeoutMs(TimingWheel::nowMs());
+        if (hasDrainRetries() && (timeout < 0 || timeout > DRAIN_RETRY_MS)) timeout = DRAIN_RETRY_MS;
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait: " << std::strerror(errno));
+            return;
+        }
+        now_ms = TimingWheel::nowMs();
+
+        for (int i = 0; i < n; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == nullptr) {
+                acceptAll();
+                continue;
+            }
+            if (tag == &wake_fd) {
+                onWakeup();
+                continue;
+            }
+
+            // Kết nối có thể đã bị đóng bởi sự kiện trước trong cùng vòng
+            // (vẫn còn sống trong graveyard)
+            Connection* conn = static_cast<Connection*>(tag);
+            if (conn->closed) continue;
+
+            uint32_t ev = events[i].events;
+            if (ev & (EPOLLERR | EPOLLHUP)) {
+                closeConnection(*conn);
+                continue;
+            }
+            if (ev & (EPOLLIN | EPOLLRDHUP)) {
+                onReadable(*conn);
+                if (conn->closed) continue;
+            }
+            if (ev & EPOLLOUT) {
+                flush(*conn);
+            }
+        }
+        wheel.advance(now_ms);
+        retryDrains();
+        graveyard.clear();
+    }
+}
+
+/**
+ * @brief Accept tất cả kết nối đang chờ (listener là non-blocking).
+ */
+void Reactor::acceptAll() {
+    while (true) {
+        sockaddr_in client_address;
+        socklen_t addrlen = sizeof(client_address);
+        uint64_t accept_start = metrics::now();
+        int client_socket = accept4(listen_fd, (struct sockaddr *)&client_address, &addrlen,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return; // Hết kết nối chờ
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if ((errno == EMFILE || errno == ENFILE) && spare_fd != -1) {
+                // accept báo EMFILE cả khi hàng đợi đã rỗng: dừng khi không còn kết nối để bỏ
+                if (shedWithoutFd()) continue;
+                return;
+            }
+            LOG_ERROR("accept: " << std::strerror(errno));
+            return; // Thử lại ở lần epoll_wait sau
+        }
+
+        uint32_t peer_addr = client_address.sin_addr.s_addr;
+        if (options.admission) {
+            AdmissionControl::Verdict verdict = options.admission->admit(peer_addr);
+            if (verdict != AdmissionControl::Verdict::ADMITTED) {
+                reject(client_socket, verdict);
+                continue;
+            }
+        }
+
+        if (options.tcp_nodelay) {
+            protocol::setNoDelay(client_socket);
+        }
+
+        auto conn = std::make_shared<Connection>();
+        conn->fd = client_socket;
+        conn->owner = this;
+        conn->peer_addr = peer_addr;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = conn.get();
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) < 0) {
+            LOG_ERROR("epoll_ctl(client): " << std::strerror(errno));
+            close(client_socket);
+            if (options.admission) options.admission->release(peer_addr);
+            continue;
+        }
+
+        LOG_INFO("New client connected (socket fd: " << client_socket << ") on reactor " << id << ".");
+        connections.emplace(client_socket, conn);
+        Connection* raw = conn.get();
+        conn->idle_timer.callback = [this, raw]() { onIdleTimer(*raw); };
+        conn->deadline_timer.callback = [this, raw]() { onDeadlineTimer(*raw); };
+        conn->last_read = now_ms;
+        handler.onOpen(*conn);
+        armIdleTimer(*conn);
+        syncDeadline(*conn);
+        metrics::add(metrics::CONNECTIONS_ACCEPTED);
+        metrics::record(metrics::ACCEPT, metrics::now() - accept_start);
+    }
+}
+
+/**
+ * @brief Từ chối kết nối vừa accept: gửi frame mã hóa sẵn (không chờ) rồi đóng.
+ * Không tạo Connection, không đăng ký epoll.
+ */
+void Reactor::reject(int fd, AdmissionControl::Verdict verdict) {
+    const std::string& frame = options.admission->rejection(verdict);
+    ssize_t ignored = ::send(fd, frame.data(), frame.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    (void)ignored;
+    // Bỏ dữ liệu client đã kịp gửi (ví dụ C2S_HELLO): close() khi còn dữ liệu
+    // chưa đọc sẽ gửi RST và client có thể mất luôn frame từ chối
+    char discard[512];
+    for (int i = 0; i < 4 && recv(fd, discard, sizeof(discard), MSG_DONTWAIT) > 0; ++i) {}
+    close(fd);
+    LOG_DEBUG("Rejected a connection on reactor " << id << " (verdict " << static_cast<int>(verdict) << ").");
+}
+
+/**
+ * @brief Hết fd: nhả fd dự phòng để accept được kết nối đang chờ, đóng nó ngay
+ * (không thì listener báo sẵn sàng mãi và epoll_wait quay vòng vô ích).
+ * @return false nếu không còn kết nối nào đang chờ.
+ */
+bool Reactor::shedWithoutFd() {
+    close(spare_fd);
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0) close(fd);
+    spare_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    metrics::add(metrics::SHED_SERVER_FULL);
+    LOG_WARN("Out of file descriptors, dropped a connection on reactor " << id << ".");
+    return true;
+}
+
+/**
+ * @brief Đọc hết dữ liệu đang có, tách các frame hoàn chỉnh và chuyển cho Executor.
+ * Mỗi lần recv đọc thẳng vào buffer của kết nối; các frame được giải mã tại chỗ
+ * trước lần recv kế tiếp nên buffer chỉ cần chứa 1 frame dở dang.
+ */
+void Reactor::onReadable(Connection& conn) {
+    bool peer_closed = false;
+    bool overloaded = false;
+
+    while (!overloaded) {
+        ssize_t n = conn.reader.fill(conn.fd);
+        if (n == 0) {
+            peer_closed = true; // Client ngắt kết nối
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                peer_closed = true; // Lỗi socket
+            }
+            break;
+        }
+        metrics::add(metrics::BYTES_IN, n);
+        conn.last_read = now_ms; // Idle timer tự hẹn lại khi hết hạn (không hẹn lại mỗi lần đọc)
+
+        // Tách frame: 4-byte độ dài (network byte order) + thân JSON/MessagePack
+        const char* body;
+        size_t len;
+        protocol::FrameReader::Next next;
+        while ((next = conn.reader.next(body, len)) == protocol::FrameReader::Next::FRAME) {
+            metrics::add(metrics::MESSAGES_IN);
+            if (!dispatch(conn, body, len)) {
+                overloaded = true;
+                break;
+            }
+        }
+        if (next == protocol::FrameReader::Next::TOO_LARGE) {
+            LOG_WARN("Message size too large from client " << conn.fd);
+            closeConnection(conn);
+            return;
+        }
+    }
+    conn.reader.release(IDLE_BUFFER_LIMIT); // Giữ bộ nhớ phẳng cho kết nối rảnh
+
+    if (peer_closed) {
+        closeConnection(conn);
+    } else if (overloaded) {
+        flush(conn); // Gửi S2C_SERVER_BUSY rồi đóng
+    }
+}
+
+/**
+ * @brief Chép thân frame vào inbox (worker giải mã trong arena của kết nối);
+ * nếu kết nối chưa có task thì tạo task mới.
+ * @return false nếu Executor quá tải (đã xếp S2C_SERVER_BUSY và đánh dấu đóng).
+ */
+bool Reactor::dispatch(Connection& conn, const char* body, size_t len) {
+    std::unique_lock<std::mutex> lock(conn.mutex);
+    if (conn.closing) return true; // Sắp đóng, bỏ qua thông điệp
+    uint32_t n_len = static_cast<uint32_t>(len);
+    conn.inbox.append(reinterpret_cast<const char*>(&n_len), sizeof(n_len));
+    conn.inbox.append(body, len);
+    if (conn.scheduled) return true; // Task đang chạy sẽ xử lý tiếp
+    conn.scheduled = true;
+    lock.unlock();
+
+    if (submitDrain(conn)) {
+        return true;
+    }
+    metrics::add(metrics::SERVER_BUSY);
+
+    // Hàng đợi đầy: từ chối nhanh thay vì để tải dồn lên
+    LOG_WARN("Executor queue full, rejecting client " << conn.fd);
+    json busy;
+    busy["action"] = protocol::S2C_SERVER_BUSY;
+    busy["payload"]["message"] = "Server is busy, please try again later.";
+
+    lock.lock();
+    conn.scheduled = false;
+    conn.inbox.clear();
+    conn.out.add(busy, conn.encoding);
+    conn.closing = true;
+    return false;
+}
+
+/**
+ * @brief Chạy trên worker: xử lý hết inbox theo thứ tự, rồi nhờ Reactor flush.
+ * Callback (Reactor::post) chạy trước các thông điệp, kể cả khi kết nối đang đóng.
+ */
+void Reactor::drain(const std::shared_ptr<Connection>& conn) {
+    bool call_close = false;
+    std::string& batch = conn->batch;
+    while (true) {
+        std::vector<std::function<void()>> callbacks;
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            callbacks.swap(conn->callbacks);
+            if (conn->closing || conn->closed) {
+                conn->inbox.clear();
+            } else {
+                batch.swap(conn->inbox);
+            }
+            if (callbacks.empty() && batch.empty()) {
+                conn->scheduled = false;
+                call_close = conn->close_pending;
+                conn->close_pending = false; // onClose chỉ được gọi 1 lần
+                break;
+            }
+        }
+
+        for (auto& callback : callbacks) {
+            runCallback(*conn, callback);
+        }
+        size_t offset = 0;
+        while (offset < batch.size()) {
+            uint32_t len;
+            std::memcpy(&len, batch.data() + offset, sizeof(len));
+            const char* body = batch.data() + offset + sizeof(len);
+            offset += sizeof(len) + len;
+
+            std::unique_lock<std::mutex> lock(conn->mutex);
+            if (conn->closing || conn->closed) break;
+            lock.unlock();
+            handleFrame(*conn, body, len);
+        }
+    }
+    // Inbox và batch đổi chỗ cho nhau nên cả 2 đều đi qua đây
+    if (batch.capacity() > IDLE_BUFFER_LIMIT) {
+        std::string().swap(batch);
+    }
+
+    if (call_close) {
+        // Reactor đã đóng socket trong lúc task đang chạy: logout ở đây
+        handler.onClose(*conn);
+    } else {
+        requestFlush(conn);
+    }
+}
+
+/**
+ * @brief Giải mã và xử lý 1 frame: thông điệp và các trả lời tạo ra trong lúc xử lý
+ * là ArenaJson nằm trong arena của kết nối, thu hồi ngay khi xử lý xong.
+ */
+void Reactor::handleFrame(Connection& conn, const char* body, size_t len) {
+    {
+        Arena::Scope scope(conn.arena);
+        ArenaJson msg;
+        bool decoded = true;
+        try {
+            metrics::ScopedTimer timer(metrics::MESSAGE_DECODE);
+            msg = protocol::decodeBody<ArenaJson>(body, len);
+        } catch (json::exception& e) {
+            LOG_WARN("JSON parse error: " << e.what());
+            conn.closeAfterFlush();
+            decoded = false;
+        }
+        try {
+            if (decoded) handler.onMessage(conn, msg);
+        } catch (const std::exception& e) {
+            // Bắt ngoại lệ (ví dụ: thiếu trường trong JSON)
+            LOG_ERROR("Exception in client handler (socket " << conn.fd << "): " << e.what());
+            conn.closeAfterFlush();
+        }
+        protocol::clearTree(msg);
+    }
+    conn.arena.reset(IDLE_BUFFER_LIMIT);
+}
+
+/**
+ * @brief Chạy 1 callback (Reactor::post) như 1 thông điệp: cũng dùng arena của kết nối.
+ */
+void Reactor::runCallback(Connection& conn, const std::function<void()>& callback) {
+    {
+        Arena::Scope scope(conn.arena);
+        try {
+            callback();
+        } catch (const std::exception& e) {
+            LOG_ERROR("Exception in callback (socket " << conn.fd << "): " << e.what());
+            conn.closeAfterFlush();
+        }
+    }
+    conn.arena.reset(IDLE_BUFFER_LIMIT);
+}
+
+/**
+ * @brief Tạo task xử lý inbox (caller vừa đặt scheduled = true). Task chỉ giữ con trỏ
+ * thô nên vừa bộ đệm sẵn của std::function (không cấp phát); kết nối được giữ sống
+ * bằng 'pinned' cho tới khi task chạy.
+ * @return false nếu Executor quá tải.
+ */
+bool Reactor::submitDrain(Connection& conn) {
+    conn.pinned = conn.shared_from_this();
+    conn.queued_at = metrics::now();
+    Connection* target = &conn;
+    if (executor.trySubmit([this, target]() {
+            std::shared_ptr<Connection> self = std::move(target->pinned);
+            metrics::record(metrics::QUEUE_WAIT, metrics::now() - self->queued_at);
+            drain(self);
+        })) {
+        return true;
+    }
+    conn.pinned.reset();
+    return false;
+}
+
+void Reactor::post(const std::shared_ptr<Connection>& conn, std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->callbacks.push_back(std::move(callback));
+        if (conn->scheduled) return; // Task đang chạy sẽ xử lý tiếp
+        conn->scheduled = true;
+    }
+    if (!submitDrain(*conn)) {
+        // Hàng đợi đầy: không chạy callback trên thread gọi (có thể là Reactor hay pool
+        // xác thực); giữ scheduled và để Reactor thử tạo task lại ở các vòng sau
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex);
+            drain_retries.push_back(conn);
+        }
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+bool Reactor::hasDrainRetries() {
+    std::lock_guard<std::mutex> lock(flush_mutex);
+    return !drain_retries.empty();
+}
+
+/**
+ * @brief Tạo lại task cho các kết nối mà post() chưa xếp được vào Executor.
+ * Executor vẫn đầy thì giữ phần còn lại cho vòng sau (theo thứ tự cũ).
+ */
+void Reactor::retryDrains() {
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        if (drain_retries.empty()) return;
+        retrying.swap(drain_retries);
+    }
+    size_t done = 0;
+    while (done < retrying.size() && submitDrain(*retrying[done])) ++done;
+    if (done < retrying.size()) {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        drain_retries.insert(drain_retries.begin(), std::make_move_iterator(retrying.begin() + done),
+                             std::make_move_iterator(retrying.end()));
+    }
+    retrying.clear();
+}
+
+void Reactor::requestFlush(std::shared_ptr<Connection> conn) {
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        flush_requests.push_back(std::move(conn));
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+/**
+ * @brief eventfd báo có kết nối cần flush (do worker yêu cầu).
+ */
+void Reactor::onWakeup() {
+    uint64_t count;
+    while (read(wake_fd, &count, sizeof(count)) > 0) {}
+
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        flushing.swap(flush_requests); // 2 vector đổi chỗ, giữ lại bộ nhớ cho lần sau
+    }
+    for (auto& conn : flushing) {
+        if (!conn->closed) flush(*conn);
+    }
+    flushing.clear();
+}
+
+/**
+ * @brief Gửi các frame đang chờ nhiều nhất có thể; nếu socket đầy thì chờ EPOLLOUT.
+ * Mọi frame do 1 lần xử lý inbox tạo ra (ví dụ kết quả + câu hỏi mới) đi chung 1 syscall.
+ */
+void Reactor::flush(Connection& conn) {
+    protocol::FrameWriter::Status status;
+    bool close_now = false;
+    bool deadline_changed;
+    uint64_t deadline, deadline_seq;
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        status = conn.out.flush(conn.fd);
+        if (status == protocol::FrameWriter::Status::DONE) {
+            conn.out.release(IDLE_BUFFER_LIMIT);
+            close_now = conn.closing;
+        }
+        deadline_changed = conn.deadline_changed;
+        conn.deadline_changed = false;
+        deadline = conn.deadline;
+        deadline_seq = conn.deadline_seq;
+    }
+    if (deadline_changed) {
+        scheduleDeadline(conn, deadline, deadline_seq);
+    }
+
+    if (status == protocol::FrameWriter::Status::FAILED) {
+        LOG_ERROR("send: " << std::strerror(errno));
+        closeConnection(conn);
+        return;
+    }
+    if (close_now) {
+        closeConnection(conn);
+        return;
+    }
+    // Socket đầy: chờ EPOLLOUT
+    updateInterest(conn, status == protocol::FrameWriter::Status::WOULD_BLOCK);
+}
+
+void Reactor::updateInterest(Connection& conn, bool want_write) {
+    if (conn.want_write == want_write) return;
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    if (want_write) ev.events |= EPOLLOUT;
+    ev.data.ptr = &conn;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev) == 0) {
+        conn.want_write = want_write;
+    }
+}
+
+/**
+ * @brief Gỡ kết nối khỏi epoll, đóng socket và logout.
+ * Nếu đang có task xử lý inbox thì task đó sẽ gọi onClose khi xong.
+ */
+void Reactor::closeConnection(Connection& conn) {
+    int fd = conn.fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    wheel.cancel(conn.idle_timer);
+    wheel.cancel(conn.deadline_timer);
+    metrics::add(metrics::CONNECTIONS_CLOSED);
+    if (options.admission) options.admission->release(conn.peer_addr);
+
+    bool call_close = false;
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        conn.closed = true;
+        if (conn.scheduled) {
+            conn.close_pending = true;
+        } else {
+            call_close = true;
+        }
+    }
+    if (call_close) {
+        try {
+            handler.onClose(conn);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Exception in close handler (socket " << fd << "): " << e.what());
+        }
+    }
+
+    // Giữ đối tượng đến cuối vòng epoll_wait (có thể còn sự kiện trỏ tới nó)
+    auto it = connections.find(fd);
+    if (it != connections.end()) {
+        graveyard.push_back(std::move(it->second));
+        connections.erase(it);
+    }
+    LOG_INFO("Client " << fd << " disconnected.");
+}
+
+/**
+ * @brief Hẹn idle_timer tới mốc gần nhất cần xét: gửi S2C_PING hoặc đóng vì im lặng.
+ */
+void Reactor::armIdleTimer(Connection& conn) {
+    if (options.idle_timeout_ms == 0 && options.heartbeat_ms == 0) return;
+    uint64_t due = UINT64_MAX;
+    if (options.idle_timeout_ms > 0) {
+        due = conn.last_read + options.idle_timeout_ms;
+    }
+    if (options.heartbeat_ms > 0) {
+        due = std::min(due, std::max(conn.last_read, conn.last_ping) + options.heartbeat_ms);
+    }
+    wheel.schedule(conn.idle_timer, due > now_ms ? due - now_ms : 0);
+}
+
+void Reactor::onIdleTimer(Connection& conn) {
+    uint64_t silent = now_ms - conn.last_read;
+    if (options.idle_timeout_ms > 0 && silent >= options.idle_timeout_ms) {
+        LOG_INFO("Client " << conn.fd << " was idle for " << silent / 1000 << "s, disconnecting.");
+        metrics::add(metrics::IDLE_CLOSED);
+        closeConnection(conn);
+        return;
+    }
+    if (options.heartbeat_ms > 0 && now_ms - std::max(conn.last_read, conn.last_ping) >= options.heartbeat_ms) {
+        conn.last_ping = now_ms;
+        conn.send(pingFrame());
+        metrics::add(metrics::HEARTBEATS_SENT);
+        flush(conn);
+        if (conn.closed) return;
+    }
+    armIdleTimer(conn); // Có dữ liệu mới từ lần hẹn trước: hẹn lại theo last_read
+}
+
+void Reactor::syncDeadline(Connection& conn) {
+    uint64_t deadline, deadline_seq;
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        if (!conn.deadline_changed) return;
+        conn.deadline_changed = false;
+        deadline = conn.deadline;
+        deadline_seq = conn.deadline_seq;
+    }
+    scheduleDeadline(conn, deadline, deadline_seq);
+}
+
+void Reactor::scheduleDeadline(Connection& conn, uint64_t deadline, uint64_t seq) {
+    if (deadline == 0) {
+        wheel.cancel(conn.deadline_timer);
+        return;
+    }
+    conn.timer_seq = seq;
+    wheel.schedule(conn.deadline_timer, deadline > now_ms ? deadline - now_ms : 0);
+}
+
+/**
+ * @brief Hết hạn chót: chuyển cho task xử lý inbox (không chạy song song với onMessage).
+ * Trong lúc chờ, phiên có thể đã đặt hạn chót mới: khi đó bỏ qua.
+ */
+void Reactor::onDeadlineTimer(Connection& conn) {
+    uint64_t seq = conn.timer_seq;
+    std::shared_ptr<Connection> self = conn.shared_from_this();
+    post(self, [this, self, seq]() {
+        {
+            std::lock_guard<std::mutex> lock(self->mutex);
+            if (self->deadline_seq != seq || self->closing || self->closed) return;
+            self->deadline = 0;
+        }
+        handler.onDeadline(*self);
+    });
+}
@@ -0,0 +1,42 @@
+#include "room.hpp"
+#include "reactor.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+
+Room::Member* Room::find(const Connection* conn) {
+    for (auto& m : members) {
+        if (m.conn.get() == conn) return &m;
+    }
+    return nullptr;
+}
+
+bool Room::allAnswered() const {
+    return std::all_of(members.begin(), members.end(), [](const Member& m) { return m.answered; });
+}
+
+ArenaJson Room::standings() const {
+    std::vector<const Member*> order;
+    order.reserve(members.size());
+    for (const auto& m : members) order.push_back(&m);
+    std::sort(order.begin(), order.end(), [](const Member* a, const Member* b) {
+        return a->points != b->points ? a->points > b->points : a->username < b->username;
+    });
+
+    ArenaJson list = ArenaJson::array();
+    for (const Member* m : order) {
+        ArenaJson& row = list.emplace_back();
+        row["username"] = m->username;
+        row["points"] = m->points;
+    }
+    return list;
+}
+
+void Room::broadcast(const protocol::PreparedFrame& frame) {
+    for (auto& m : members) m.conn->push(frame);
+    metrics::add(metrics::FRAMES_BROADCAST, members.size());
+}
+
+void Room::broadcast(const protocol::FrameView& frame) {
+    for (auto& m : members) m.conn->push(frame);
+    metrics::add(metrics::FRAMES_BROADCAST, members.size());
+}
@@ -1,128 +1,218 @@
 #include "server.hpp"   // Header của lớp Server
 #include "protocol.hpp" // Header định nghĩa các gói tin (protocol)
-#include <iostream>
-#include <fstream>       // Để đọc/ghi file
-#include <stdexcept>
-#include <sys/socket.h>
-#include <netinet/in.h>
+#include "metrics.hpp"  // Bộ đếm và histogram độ trễ
+#include "logger.hpp"   // Log bất đồng bộ
+#include "wal.hpp"      // Đọc WAL cũ khi nhập users.json
+#include "password.hpp" // Băm và kiểm tra mật khẩu
+#include <fstream>       // Để đọc file
+#include <unordered_map>
+#include <algorithm>
+#include <sys/resource.h> // Cho getrlimit/setrlimit
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <csignal>
+#include <cstring>
 #include <unistd.h>
-#include <random>        // Để lấy câu hỏi ngẫu nhiên
-#include <thread>        // Để dùng std::thread
+#include <thread>        // Mỗi Reactor chạy trên 1 std::thread
 #include <mutex>         // Để dùng std::mutex và std::lock_guard
+#include <atomic>
 
-// Sử dụng namespace cho thư viện JSON
-using json = nlohmann::json;
+// Số fd chừa cho CSDL, listener, epoll, log... khi tính max_connections mặc định
+static const rlim_t RESERVED_FDS = 64;
+
+// Đăng nhập khóa tài khoản chờ commit tối đa chừng này (CSDL lỗi thì không giữ worker mãi)
+static const std::chrono::milliseconds DURABLE_WAIT(2000);
+
+// eventfd của reload_thread cho handler SIGHUP (chỉ 1 Server trong process)
+static volatile sig_atomic_t reload_signal_fd = -1;
+
+static void onSighup(int) {
+    int saved_errno = errno;
+    uint64_t one = 1;
+    ssize_t ignored = write(reload_signal_fd, &one, sizeof(one)); // write an toàn trong signal handler
+    (void)ignored;
+    errno = saved_errno;
+}
+
+/**
+ * @brief Trường 'key' trong payload của thông điệp client (nullptr nếu thiếu).
+ * Không dùng operator[] trên ArenaJson const: thiếu key là assert và dừng cả server.
+ */
+static const ArenaJson* payloadField(const ArenaJson& msg, const char* key) {
+    if (!msg.is_object()) return nullptr;
+    auto payload = msg.find("payload");
+    if (payload == msg.end() || !payload->is_object()) return nullptr;
+    auto field = payload->find(key);
+    return field == payload->end() ? nullptr : &*field;
+}
+
+/**
+ * @brief Trường chuỗi 'key' của 1 object; không phải object, thiếu hoặc sai kiểu
+ * thì trả về chuỗi rỗng (không ném như value()).
+ */
+static std::string_view stringField(const ArenaJson& obj, const char* key) {
+    if (!obj.is_object()) return {};
+    auto field = obj.find(key);
+    if (field == obj.end() || !field->is_string()) return {};
+    return field->get_ref<const ArenaJson::string_t&>();
+}
+
+/**
+ * @brief Trường chuỗi trong payload; thiếu hoặc sai kiểu thì trả về chuỗi rỗng.
+ */
+static std::string_view payloadString(const ArenaJson& msg, const char* key) {
+    const ArenaJson* field = payloadField(msg, key);
+    if (!field || !field->is_string()) return {};
+    return field->get_ref<const ArenaJson::string_t&>();
+}
 
 /**
  * @brief Hàm khởi tạo (Constructor)
- * Khởi tạo theo thứ tự đã khai báo trong .hpp (server_fd trước, port sau)
- * để tránh cảnh báo -Wreorder.
  */
-Server::Server(int port) : server_fd(-1), port(port) {}
+Server::Server(const ServerConfig& config)
+    : config(config), sessions(config.resume_timeout_s) {
+    if (this->config.questions_file.empty()) {
+        this->config.questions_file = config.data_dir + "/questions.bin";
+    }
+    if (this->config.stats_file.empty()) {
+        this->config.stats_file = config.data_dir + "/stats.txt";
+    }
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    if (this->config.num_reactors <= 0) {
+        this->config.num_reactors = cores; // Mặc định: 1 Reactor cho mỗi core
+    }
+    if (this->config.num_workers <= 0) {
+        // Worker có thể phải chờ đĩa (đọc user từ CSDL, chờ commit khi khóa tài khoản) nên dùng nhiều hơn số core
+        this->config.num_workers = 2 * cores;
+    }
+    if (this->config.auth_workers <= 0) {
+        // Băm mật khẩu chỉ dùng CPU: giới hạn để đợt đăng nhập dồn dập không chiếm hết core của gameplay
+        this->config.auth_workers = std::max(1, cores / 4);
+    }
+    this->config.auth_iterations = std::max(1, this->config.auth_iterations);
+}
 
 /**
  * @brief Hàm hủy (Destructor)
- * Đảm bảo socket chính được đóng khi server tắt.
+ * Các Reactor tự đóng listener và kết nối của mình; Executor join các worker.
  */
 Server::~Server() {
-    if (server_fd != -1) {
-        close(server_fd);
+    auth_executor.reset(); // Task xác thực gửi kết quả về Reactor: dừng trước Reactor
+    reactors.clear();
+    executor.reset();
+    {
+        std::lock_guard<std::mutex> lock(background_mutex);
+        stopping = true;
+    }
+    background_cv.notify_all();
+    if (reload_fd >= 0) {
+        signal(SIGHUP, SIG_DFL);
+        reload_signal_fd = -1;
+        uint64_t one = 1;
+        ssize_t ignored = write(reload_fd, &one, sizeof(one)); // Đánh thức reload_thread để nó thấy 'stopping'
+        (void)ignored;
     }
+    if (reload_thread.joinable()) reload_thread.join();
+    if (reload_fd >= 0) close(reload_fd);
+    if (stats_thread.joinable()) stats_thread.join();
+    if (reap_thread.joinable()) reap_thread.join();
+    if (leaderboard_thread.joinable()) leaderboard_thread.join();
+    users.reset();
+    db.reset(); // Commit nốt các thay đổi còn trong bộ đệm
 }
 
 /**
- * @brief Tải CSDL, tạo socket, bind và listen.
+ * @brief Tải CSDL, tạo các Reactor (mỗi Reactor 1 listener SO_REUSEPORT).
  */
 bool Server::start() {
-    // 1. Tải câu hỏi
-    loadQuestions("../data/questions.json"); 
-    if (questions.empty()) {
-        std::cerr << "Failed to load questions or no questions found." << std::endl;
+    // 1. mmap kho câu hỏi đã biên dịch (không parse, không phụ thuộc số câu hỏi);
+    //    SIGHUP hoặc file mới (make questions) thì nạp lại mà không dừng server
+    if (!loadQuestions()) {
         return false;
     }
-    std::cout << "Loaded " << questions.size() << " questions." << std::endl;
-
-    // 2. Tải User
-    loadUsers("../data/users.json");
-    if (loaded_users.empty()) {
-        std::cerr << "Failed to load users or no users found." << std::endl;
-        return false;
+    reload_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (reload_fd >= 0) {
+        reload_signal_fd = reload_fd;
+        struct sigaction sa{};
+        sa.sa_handler = onSighup;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGHUP, &sa, nullptr);
+        reload_thread = std::thread([this]() { reloadLoop(); });
+    } else {
+        LOG_WARN("eventfd: " << std::strerror(errno) << "; question bank reload is disabled.");
     }
-    std::cout << "Loaded " << loaded_users.size() << " users." << std::endl;
 
-    // 3. Tạo socket
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd == 0) {
-        perror("socket failed");
+    // 2. Mở CSDL user (không nạp user nào: user được đọc khi đăng nhập)
+    if (!openUsers()) {
         return false;
     }
+    users = std::make_unique<UserStore>(*db, config.user_cache);
 
-    // 4. Setsockopt (để tái sử dụng port ngay lập tức)
-    int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-        perror("setsockopt");
-        return false;
+    if (config.stats_interval_s > 0) {
+        stats_thread = std::thread([this]() { statsLoop(); });
     }
 
-    // 5. Bind socket vào địa chỉ và port
-    sockaddr_in address; 
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY; // Chấp nhận kết nối từ mọi IP
-    address.sin_port = htons(port);       // Chuyển port sang network byte order
-
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        perror("bind failed");
-        return false;
+    // 3. Nâng giới hạn số fd (mỗi kết nối 1 fd) lên mức tối đa cho phép
+    rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
     }
+    AdmissionControl::Limits limits;
+    limits.max_connections = config.max_connections;
+    if (limits.max_connections == 0 && getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY &&
+        rl.rlim_cur > 2 * RESERVED_FDS) {
+        // Từ chối sớm (có frame báo lỗi) thay vì để accept gặp EMFILE
+        limits.max_connections = rl.rlim_cur - RESERVED_FDS;
+    }
+    limits.ip_connections = config.ip_connections;
+    limits.ip_connect_rate = config.ip_connect_rate;
+    limits.ip_login_rate = config.ip_login_rate;
+    admission = std::make_unique<AdmissionControl>(limits);
+    reap_thread = std::thread([this]() { reapLoop(); });
 
-    // 6. Listen
-    if (listen(server_fd, 10) < 0) { // Tăng backlog (hàng đợi) lên 10
-        perror("listen");
-        return false;
+    // 4. Tạo pool worker (số thread và độ sâu hàng đợi cố định)
+    executor = std::make_unique<Executor>(config.num_workers, config.queue_depth);
+    auth_executor = std::make_unique<Executor>(config.auth_workers, config.auth_queue_depth);
+
+    // 5. Tạo Reactor: socket, SO_REUSEPORT, bind, listen, epoll
+    ReactorOptions options;
+    options.tcp_nodelay = config.tcp_nodelay;
+    if (config.backlog > 0) options.backlog = config.backlog;
+    options.admission = admission.get();
+    options.idle_timeout_ms = static_cast<uint64_t>(std::max(0, config.idle_timeout_s)) * 1000;
+    options.heartbeat_ms = static_cast<uint64_t>(std::max(0, config.heartbeat_s)) * 1000;
+    for (int i = 0; i < config.num_reactors; ++i) {
+        auto reactor = std::make_unique<Reactor>(i, *this, *executor, options);
+        if (!reactor->open(config.port)) {
+            return false;
+        }
+        reactors.push_back(std::move(reactor));
     }
 
-    std::cout << "Server listening on port " << port << std::endl;
+    LOG_INFO("Server listening on port " << config.port << " with " << config.num_reactors
+             << " reactor(s), " << config.num_workers << " worker(s), queue depth "
+             << config.queue_depth << ", " << config.auth_workers << " auth worker(s), max "
+             << limits.max_connections << " connection(s)");
     return true;
 }
 
 /**
- * @brief Vòng lặp chính của server, chấp nhận kết nối mới.
+ * @brief Chạy mỗi Reactor trên 1 thread riêng (Reactor 0 chạy trên thread hiện tại).
  */
 void Server::run() {
-    sockaddr_in client_address;
-    int addrlen = sizeof(client_address);
-    
-    std::cout << "Server ready to accept concurrent connections..." << std::endl;
+    LOG_INFO("Server ready to accept concurrent connections...");
 
-    // Vòng lặp accept client vĩnh viễn
-    while (true) {
-        // Chờ và chấp nhận kết nối mới (blocking)
-        int client_socket = accept(server_fd, (struct sockaddr *)&client_address, (socklen_t*)&addrlen);
-        if (client_socket < 0) {
-            perror("accept");
-            continue; // Lỗi -> bỏ qua và tiếp tục chờ
-        }
-        
-        std::cout << "New client connected (socket fd: " << client_socket << "). Handing to new thread." << std::endl;
-        
-        // Tạo một thread mới để xử lý client này
-        // [this] để lambda capture con trỏ 'this' (để gọi các hàm thành viên)
-        std::thread clientThread([this, client_socket]() {
-            try {
-                // Toàn bộ logic của client sẽ nằm trong hàm này
-                handleClient(client_socket);
-            } catch (const std::exception& e) {
-                // Bắt ngoại lệ (ví dụ: lỗi parse JSON)
-                std::cerr << "Exception in client thread (socket " << client_socket << "): " << e.what() << std::endl;
-            }
-            
-            // Dù thành công hay thất bại, đóng socket và kết thúc luồng
-            close(client_socket);
-            std::cout << "Handler thread for " << client_socket << " finished. Client disconnected." << std::endl;
-        });
-        
-        // detach() để thread tự chạy, server quay lại accept() ngay lập tức
-        clientThread.detach();
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < reactors.size(); ++i) {
+        threads.emplace_back([this, i]() { reactors[i]->run(); });
+    }
+    reactors[0]->run();
+
+    for (auto& t : threads) {
+        t.join();
     }
 }
 
@@ -131,293 +221,1131 @@ void Server::run() {
 // ==========================================================
 
 /**
- * @brief Tải file data/users.json vào vector loaded_users.
- * Dùng mutex để đảm bảo an toàn khi server vừa khởi động.
+ * @brief Mở db_file. Lần chạy đầu tiên (CSDL chưa có user nào) nhập users.json;
+ * các lần sau khởi động không phụ thuộc số tài khoản.
+ */
+bool Server::openUsers() {
+    db = std::make_unique<UserDb>(config.db_commit_ms, config.db_batch);
+    if (!db->open(config.db_file)) {
+        LOG_ERROR("Cannot open user database: " << config.db_file);
+        return false;
+    }
+    if (db->empty() && !importUsers(config.data_dir + "/users.json")) {
+        return false;
+    }
+    LOG_INFO("User database: " << config.db_file << " (cache " << config.user_cache << " users)");
+    // Bảng xếp hạng dựng ở thread nền để khởi động không phụ thuộc số tài khoản;
+    // sau đó chỉ cập nhật tại chỗ đổi điểm (saveScore)
+    leaderboard_thread = std::thread([this]() { loadLeaderboard(); });
+    return true;
+}
+
+/**
+ * @brief Đọc điểm của mọi user (theo index, điểm cao trước) vào bảng xếp hạng.
+ * Trong lúc đọc, bảng chỉ có các user đã đọc và các user vừa đổi điểm.
  */
-void Server::loadUsers(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(g_users_mutex); // Khóa
+void Server::loadLeaderboard() {
+    auto started = std::chrono::steady_clock::now();
+    size_t scanned = 0;
+    bool ok = db->forEachScore([this, &scanned](const std::string& username, int32_t score) {
+        leaderboard.insertIfAbsent(username, score); // Điểm vừa đổi qua saveScore mới hơn CSDL
+        if (++scanned % 4096 != 0) return true;
+        std::lock_guard<std::mutex> lock(background_mutex);
+        return !stopping;
+    });
+    if (!ok) {
+        LOG_ERROR("Cannot build the leaderboard; it only lists users whose score changed since startup.");
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    LOG_INFO("Leaderboard ready: " << leaderboard.size() << " ranked user(s) in " << elapsed.count() << "ms");
+}
+
+void Server::saveScore(const UserRecord& r) {
+    db->saveScore(r.username, r.score);
+    leaderboard.update(r.username, r.score);
+}
+
+/**
+ * @brief Nhập users.json, rồi áp dụng các thay đổi còn nằm trong WAL của
+ * phiên bản cũ (chưa kịp gộp vào users.json) để không mất điểm nào, và băm
+ * mật khẩu trước khi ghi vào CSDL.
+ * Chạy 1 lần lúc khởi động, trước khi có kết nối nào.
+ */
+bool Server::importUsers(const std::string& filename) {
     std::ifstream f(filename);
     if (!f.is_open()) {
-        std::cerr << "Cannot open user file: " << filename << std::endl;
-        return;
+        LOG_ERROR("User database is empty and cannot open user file: " << filename);
+        return false;
     }
+
+    std::vector<UserRecord> records;
+    std::unordered_map<std::string, size_t> index_of;
     try {
         json data = json::parse(f);
-        loaded_users = data.get<std::vector<json>>(); 
-    } catch (json::parse_error& e) {
-        std::cerr << "Failed to parse users file: " << e.what() << std::endl;
+        for (const auto& u : data) {
+            UserRecord r;
+            r.username = u.value("username", "");
+            r.password = u.value("password", "");
+            r.score = u.value("score", 0);
+            r.status = statusFromString(u.value("status", "active"));
+            if (r.username.empty()) continue;
+            if (!index_of.emplace(r.username, records.size()).second) {
+                LOG_WARN("Duplicate user ignored: " << r.username);
+                continue;
+            }
+            records.push_back(std::move(r));
+        }
+    } catch (json::exception& e) {
+        LOG_ERROR("Failed to parse users file: " << e.what());
+        return false;
+    }
+    if (records.empty()) {
+        LOG_ERROR("No users found in " << filename);
+        return false;
+    }
+
+    // Bản ghi WAL là giá trị tuyệt đối: replay cả phần đã có trong users.json vẫn đúng
+    long replayed = 0;
+    for (const char* log : {"/users.wal.old", "/users.wal"}) {
+        long n = replayWal(config.data_dir + log, [&](const WalRecord& r) {
+            auto it = index_of.find(r.username);
+            if (it == index_of.end()) return;
+            UserRecord& u = records[it->second];
+            if (r.op == WalRecord::SET_SCORE) {
+                u.score = r.score;
+            } else {
+                u.status = statusFromString(r.status);
+            }
+        });
+        if (n > 0) replayed += n;
+    }
+
+    // Băm mật khẩu trước khi ghi: CSDL không bao giờ chứa mật khẩu dạng rõ
+    if (!hashPasswords(records)) {
+        return false;
+    }
+    if (!db->insertAll(records)) {
+        return false;
     }
+    LOG_INFO("Imported " << records.size() << " users from " << filename
+             << " (" << replayed << " WAL record(s) replayed).");
+    return true;
 }
 
 /**
- * @brief Lưu lại vector loaded_users vào file users.json.
- * Hàm này PHẢI được gọi khi đang giữ g_users_mutex.
+ * @brief Băm mọi mật khẩu dạng rõ trong 'records' (PBKDF2, auth_iterations vòng),
+ * chia cho mọi core vì chưa có kết nối nào phải phục vụ. Chạy 1 lần khi nhập users.json.
  */
-bool Server::saveUsers(const std::string& filename) {
-    // Hàm này không cần lock, vì nó được gọi bởi checkLogin/handleClient
-    // (những hàm đã lock g_users_mutex từ trước)
-    try {
-        json j_users(loaded_users);
-        std::ofstream o(filename);
-        o << std::setw(2) << j_users << std::endl;
-        o.close();
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "ERROR saving users.json: " << e.what() << std::endl;
+bool Server::hashPasswords(std::vector<UserRecord>& records) {
+    size_t count = std::count_if(records.begin(), records.end(),
+                                 [](const UserRecord& r) { return !password::isHashed(r.password); });
+    if (count == 0) return true;
+    size_t num_threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    LOG_INFO("Hashing " << count << " imported password(s) with " << num_threads << " thread(s)...");
+
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            try {
+                for (size_t i = t; i < records.size() && !failed; i += num_threads) {
+                    if (!password::isHashed(records[i].password)) {
+                        records[i].password = password::hash(records[i].password, config.auth_iterations);
+                    }
+                }
+            } catch (std::exception& e) {
+                LOG_ERROR("Cannot hash imported passwords: " << e.what());
+                failed = true;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return !failed;
+}
+
+bool Server::loadQuestions() {
+    auto bank = std::make_shared<QuestionBank>();
+    if (!bank->open(config.questions_file)) {
+        return false;
+    }
+    if (bank->size() == 0) {
+        LOG_ERROR("No questions found in " << config.questions_file);
         return false;
     }
+    size_t count = bank->size();
+    questions.publish(std::move(bank));
+    LOG_INFO("Loaded " << count << " questions.");
+    return true;
 }
 
 /**
- * @brief Logic kiểm tra đăng nhập (chỉ kiểm tra CSDL).
- * Hàm này dùng g_users_mutex để đọc/ghi file an toàn.
+ * @brief Theo dõi thư mục chứa questions_file (compile_questions ghi file tạm rồi
+ * rename đè lên, nên file cũ không bao giờ bị sửa dưới chân các phiên đang mmap nó).
  */
-bool Server::checkLogin(const std::string& user, const std::string& pass, int& attempts, std::string& fail_reason, int& user_db_index) {
-    // Khóa mutex để bảo vệ CSDL user (loaded_users)
-    std::lock_guard<std::mutex> lock(g_users_mutex);
-    
-    bool found_user = false;
-    for (int i = 0; i < loaded_users.size(); ++i) {
-        if (loaded_users[i]["username"] == user) {
-            found_user = true;
-
-            // 1. Kiểm tra trạng thái "blocked"
-            if (loaded_users[i]["status"] == "blocked") {
-                fail_reason = "Your account is permanently blocked.";
-                return false; 
-            }
-            
-            // 2. Kiểm tra mật khẩu
-            if (loaded_users[i]["password"] == pass) {
-                user_db_index = i; // Trả về index của user trong CSDL
-                return true; // THÀNH CÔNG
+void Server::reloadLoop() {
+    std::string dir = ".";
+    std::string name = config.questions_file;
+    size_t slash = name.rfind('/');
+    if (slash != std::string::npos) {
+        dir = slash == 0 ? "/" : name.substr(0, slash);
+        name = name.substr(slash + 1);
+    }
+    int inotify_fd = -1;
+    if (config.watch_questions) {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0 || inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            LOG_WARN("Cannot watch " << dir << " for question bank changes: " << std::strerror(errno)
+                     << "; send SIGHUP to reload.");
+            if (inotify_fd >= 0) close(inotify_fd);
+            inotify_fd = -1;
+        }
+    }
+
+    pollfd fds[2] = {{reload_fd, POLLIN, 0}, {inotify_fd, POLLIN, 0}}; // poll bỏ qua fd âm
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("poll: " << std::strerror(errno));
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(background_mutex);
+            if (stopping) break;
+        }
+
+        bool reload = false;
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(reload_fd, &count, sizeof(count)) == sizeof(count)) {
+                LOG_INFO("SIGHUP received, reloading " << config.questions_file << ".");
+                reload = true;
             }
-            
-            // 3. Sai mật khẩu
-            attempts++; // Tăng số lần sai (của phiên này)
-            if (attempts >= 3) {
-                // KHÓA TÀI KHOẢN
-                loaded_users[i]["status"] = "blocked";
-                saveUsers("../data/users.json"); // Lưu vĩnh viễn
-                fail_reason = "Too many failed attempts. Your account is now blocked.";
-            } else {
-                fail_reason = "Invalid password. " + std::to_string(3 - attempts) + " attempts left.";
+        }
+        if (fds[1].revents & POLLIN) {
+            alignas(inotify_event) char buffer[4096];
+            ssize_t len;
+            while ((len = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+                for (ssize_t pos = 0; pos < len;) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(buffer + pos);
+                    if (event->len > 0 && name == event->name) reload = true;
+                    pos += sizeof(inotify_event) + event->len;
+                }
             }
-            return false; 
+            if (reload) LOG_INFO(config.questions_file << " changed, reloading.");
         }
+
+        if (!reload) continue;
+        if (loadQuestions()) {
+            metrics::add(metrics::QUESTION_RELOADS);
+        } else {
+            LOG_WARN("Reload failed; still serving the previous question bank.");
+        }
+    }
+    if (inotify_fd >= 0) close(inotify_fd);
+}
+
+void Server::statsLoop() {
+    std::unique_lock<std::mutex> lock(background_mutex);
+    while (!stopping) {
+        background_cv.wait_for(lock, std::chrono::seconds(config.stats_interval_s),
+                               [this]() { return stopping; });
+        lock.unlock();
+        if (!metrics::writeSnapshot(config.stats_file)) {
+            LOG_WARN("Cannot write stats file: " << config.stats_file);
+        }
+        lock.lock();
+    }
+}
+
+void Server::reapLoop() {
+    std::unique_lock<std::mutex> lock(background_mutex);
+    while (!stopping) {
+        background_cv.wait_for(lock, std::chrono::seconds(1), [this]() { return stopping; });
+        lock.unlock();
+        for (const ResumeState& state : sessions.expire()) {
+            users->release(state.user_db_index);
+            metrics::add(metrics::SESSIONS_EXPIRED);
+            LOG_INFO("Parked session of " << state.username << " expired.");
+        }
+        admission->sweep();
+        lock.lock();
+    }
+}
+
+/**
+ * @brief Bước 1 của đăng nhập (trên worker, nhanh): tìm user và kiểm tra trạng thái.
+ * Lấy record qua cache (đọc CSDL nếu chưa có) và ghim nó; chép mật khẩu đã lưu
+ * ra để kiểm tra trên pool xác thực, không giữ khóa record trong lúc băm.
+ * @return Index của record (đang ghim), hoặc -1 (fail_reason cho biết lý do).
+ */
+int Server::lookupAccount(const std::string& user, int& attempts, std::string& fail_reason, std::string& stored_password) {
+    int index = users->acquire(user);
+
+    // Cache đầy (mọi record đều thuộc user đang chơi): không tính là 1 lần sai
+    if (index == UserStore::CACHE_FULL) {
+        fail_reason = "Server is full. Please try again later.";
+        return -1;
     }
 
-    // 4. Không tìm thấy user
-    if (!found_user) {
+    // Không tìm thấy user
+    if (index < 0) {
         attempts++;
         fail_reason = "User not found. " + std::to_string(3 - attempts) + " attempts left.";
-        return false; 
+        return -1;
+    }
+
+    bool blocked = users->withRecord(index, [&](UserRecord& r) {
+        stored_password = r.password;
+        return r.status == UserStatus::BLOCKED;
+    });
+    if (blocked) {
+        fail_reason = "Your account is permanently blocked.";
+        users->release(index);
+        return -1;
+    }
+    return index;
+}
+
+/**
+ * @brief Bước 3 của đăng nhập: áp dụng kết quả kiểm tra mật khẩu vào record.
+ * Đúng: lưu chuỗi băm mới nếu có (chuyển đổi mật khẩu dạng rõ / đổi số vòng).
+ * Sai: tăng số lần sai, sai 3 lần thì khóa tài khoản. Thất bại thì bỏ ghim record.
+ */
+bool Server::checkLogin(int index, bool password_ok, const std::string& stored_password,
+                        const std::string& upgraded_password, int& attempts, std::string& fail_reason) {
+    uint64_t block_seq = 0;
+    std::string blocked_user;
+    bool ok = users->withRecord(index, [&](UserRecord& r) {
+        // 1. Kiểm tra trạng thái "blocked" (có thể bị khóa trong lúc chờ kiểm tra mật khẩu)
+        if (r.status == UserStatus::BLOCKED) {
+            fail_reason = "Your account is permanently blocked.";
+            return false;
+        }
+
+        // 2. Mật khẩu đúng
+        if (password_ok) {
+            // Chỉ thay nếu chưa ai đổi mật khẩu đã lưu trong lúc ta băm
+            if (!upgraded_password.empty() && r.password == stored_password) {
+                r.password = upgraded_password;
+                db->savePassword(r.username, r.password);
+                metrics::add(metrics::PASSWORDS_UPGRADED);
+            }
+            return true; // THÀNH CÔNG
+        }
+
+        // 3. Sai mật khẩu
+        attempts++; // Tăng số lần sai (của phiên này)
+        if (attempts >= 3) {
+            // KHÓA TÀI KHOẢN
+            r.status = UserStatus::BLOCKED;
+            block_seq = db->saveStatus(r.username, r.status);
+            blocked_user = r.username;
+            fail_reason = "Too many failed attempts. Your account is now blocked.";
+        } else {
+            fail_reason = "Invalid password. " + std::to_string(3 - attempts) + " attempts left.";
+        }
+        return false;
+    });
+
+    if (!ok) {
+        users->release(index);
     }
-    return false;
+    if (block_seq != 0 && !db->waitDurable(block_seq, DURABLE_WAIT)) {
+        // Lưu vĩnh viễn (chờ commit, không giữ khóa); CSDL lỗi thì không giữ worker mãi:
+        // tài khoản vẫn bị khóa trong bộ nhớ, writer tự thử lại
+        LOG_WARN("Block of account '" << blocked_user << "' is not on disk yet (database commit failing).");
+    }
+    return ok;
 }
 
 
 // ==========================================================
-// HÀM XỬ LÝ CLIENT CHÍNH
+// STATE MACHINE CỦA 1 PHIÊN (LOGIN -> AWAIT_ANSWER/AWAIT_BATCH -> GAME_OVER)
 // ==========================================================
 
 /**
- * @brief Logic chính xử lý toàn bộ phiên làm việc của 1 client.
+ * @brief Kết nối mới: phiên bắt đầu ở trạng thái LOGIN, chờ client gửi yêu cầu.
  */
-void Server::handleClient(int client_socket) {
-    bool is_logged_in = false;
-    int login_attempts = 0;
-    int user_db_index = -1; // Index của user trong loaded_users
-    std::string logged_in_username = ""; // Tên của user đã đăng nhập
-
-    // --- GIAI ĐOẠN 1: VÒNG LẶP ĐĂNG NHẬP ---
-    while (!is_logged_in) {
-        json request = protocol::receiveMessage(client_socket);
-        if (request.empty()) return; // Client ngắt kết nối
-
-        std::cout << "Received login attempt from client " << client_socket << std::endl;
-
-        if (request["action"] == protocol::C2S_LOGIN_REQUEST) {
-            std::string user = request["payload"]["username"];
-            std::string pass = request["payload"]["password"];
-            std::string fail_reason = "";
-
-            // BƯỚC 1: Kiểm tra CSDL (username, pass, status)
-            // (Hàm này dùng g_users_mutex)
-            if (checkLogin(user, pass, login_attempts, fail_reason, user_db_index)) {
-                
-                // --- BƯỚC 2: KIỂM TRA SESSION (LOGIC MỚI) ---
-                std::lock_guard<std::mutex> session_lock(g_session_mutex); // Khóa session
-                
-                // Kiểm tra xem user này đã login ở client khác chưa
-                if (active_sessions.count(user) > 0) {
-                    // Đã có người đăng nhập
-                    json r_msg;
-                    r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
-                    r_msg["payload"]["message"] = "This account is already logged in elsewhere.";
-                    protocol::sendMessage(client_socket, r_msg);
-                } else {
-                    // Đăng nhập thành công, session hợp lệ
-                    is_logged_in = true;
-                    logged_in_username = user; // Lưu lại username
-                    active_sessions.insert(user); // Thêm user vào set các session đang hoạt động
-                    
-                    json r_msg;
-                    r_msg["action"] = protocol::S2C_LOGIN_SUCCESS;
-                    r_msg["payload"]["message"] = "Login successful!";
-                    protocol::sendMessage(client_socket, r_msg);
-                }
-                // (Mutex g_session_mutex tự động unlock)
+void Server::onOpen(Connection& conn) {
+    conn.session.state = SessionState::LOGIN;
+    conn.setDeadline(std::chrono::seconds(config.login_timeout_s));
+}
 
+/**
+ * @brief Điều phối 1 thông điệp theo trạng thái hiện tại của phiên.
+ */
+void Server::onMessage(Connection& conn, const ArenaJson& msg) {
+    const std::string_view action = protocol::actionOf(msg);
+    if (action == protocol::C2S_PONG) {
+        return; // Chỉ để giữ kết nối (Reactor đã ghi nhận lần đọc)
+    }
+    if (action == protocol::C2S_HELLO) {
+        handleHello(conn, msg);
+        return;
+    }
+    // Bảng xếp hạng: chỉ sau khi đăng nhập (không đổi trạng thái của phiên). Khi còn
+    // LOGIN thì rơi xuống handleLogin ("Please login first.") để không dò được username
+    // mà né được allowLogin và bộ đếm số lần sai
+    const SessionState state = conn.session.state;
+    const bool logged_in = state == SessionState::AWAIT_ANSWER || state == SessionState::AWAIT_BATCH ||
+                           state == SessionState::IN_ROOM;
+    if (logged_in && action == protocol::C2S_LEADERBOARD_REQUEST) {
+        handleLeaderboard(conn, msg);
+        return;
+    }
+    if (logged_in && action == protocol::C2S_RANK_REQUEST) {
+        handleRank(conn, msg);
+        return;
+    }
+
+    switch (conn.session.state) {
+        case SessionState::LOGIN:
+            if (action == protocol::C2S_RESUME_REQUEST) {
+                handleResume(conn, msg);
             } else {
-                // Đăng nhập thất bại (sai pass, bị khóa, v.v. - từ checkLogin)
-                json r_msg;
-                r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
-                r_msg["payload"]["message"] = fail_reason;
-                protocol::sendMessage(client_socket, r_msg);
-
-                if (login_attempts >= 3) {
-                    std::cout << "Client " << client_socket << " failed login 3 times. Disconnecting." << std::endl;
-                    return; // Đóng thread
-                }
+                handleLogin(conn, msg);
             }
-        } else {
-            // Gửi lệnh khác khi chưa đăng nhập
-            json r_msg;
+            break;
+        case SessionState::AUTH_PENDING:
+            break; // Bỏ qua cho tới khi có kết quả kiểm tra mật khẩu
+        case SessionState::AWAIT_ANSWER:
+            handleAnswer(conn, msg);
+            break;
+        case SessionState::AWAIT_BATCH:
+            handleBatch(conn, msg);
+            break;
+        case SessionState::IN_ROOM:
+            handleRoomAnswer(conn, msg);
+            break;
+        case SessionState::GAME_OVER:
+            break; // Bỏ qua, kết nối sắp đóng
+    }
+}
+
+/**
+ * @brief Hết hạn chót của phiên: chưa đăng nhập kịp thì đóng kết nối;
+ * chưa trả lời kịp thì tính là trả lời sai.
+ */
+void Server::onDeadline(Connection& conn) {
+    switch (conn.session.state) {
+        case SessionState::LOGIN:
+        case SessionState::AUTH_PENDING: {
+            metrics::add(metrics::LOGIN_TIMEOUTS);
+            LOG_INFO("Client " << conn.fd << " did not log in within " << config.login_timeout_s << "s. Disconnecting.");
+            ArenaJson r_msg;
             r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
-            r_msg["payload"]["message"] = "Please login first.";
-            protocol::sendMessage(client_socket, r_msg);
+            r_msg["payload"]["message"] = "Login timed out.";
+            conn.send(std::move(r_msg));
+            conn.session.state = SessionState::GAME_OVER;
+            conn.closeAfterFlush();
+            break;
         }
-    } // Kết thúc while(!is_logged_in)
-
-    
-    // --- GIAI ĐOẠN 2: VÒNG LẶP CHƠI GAME ---
-    
-    std::cout << "Client " << client_socket << " logged in as " << logged_in_username << ". Starting game." << std::endl;
-    
-    // Lấy điểm số hiện tại của user
-    int current_score = 0;
-    {
-        std::lock_guard<std::mutex> lock(g_users_mutex);
-        current_score = loaded_users[user_db_index]["score"];
+        case SessionState::AWAIT_ANSWER:
+            metrics::add(metrics::ANSWER_TIMEOUTS);
+            handleAnswer(conn, ArenaJson::object(), true);
+            break;
+        case SessionState::AWAIT_BATCH:
+            metrics::add(metrics::ANSWER_TIMEOUTS);
+            handleBatch(conn, ArenaJson::object(), true);
+            break;
+        case SessionState::IN_ROOM:
+            handleRoomTimeout(conn);
+            break;
+        case SessionState::GAME_OVER:
+            break;
     }
+}
 
-    // Bắt đầu vòng lặp game
-    while (true) {
-        // 1. Gửi câu hỏi (S2C_NEW_QUESTION)
-        Question q = getRandomQuestion();
-        json q_msg;
-        q_msg["action"] = protocol::S2C_NEW_QUESTION;
-        q_msg["payload"]["question_id"] = q.id;
-        q_msg["payload"]["question_text"] = q.text;
-        q_msg["payload"]["options"] = q.options;
-        if (!protocol::sendMessage(client_socket, q_msg)) break; // Ngắt kết nối
-
-        // 2. Chờ nhận trả lời (C2S_SUBMIT_ANSWER)
-        json a_msg = protocol::receiveMessage(client_socket);
-        if (a_msg.empty()) break; // Ngắt kết nối
-        
-        std::cout << "Received answer from client " << client_socket << ": " << a_msg.dump(2) << std::endl;
-
-        // 3. Xử lý câu trả lời
-        bool is_correct = false;
-        if (a_msg["action"] == protocol::C2S_SUBMIT_ANSWER && 
-            a_msg["payload"]["question_id"] == q.id &&
-            a_msg["payload"]["answer"] == q.correct_answer) {
-            is_correct = true;
+/**
+ * @brief LOGOUT (RẤT QUAN TRỌNG): xóa user khỏi session khi kết nối đóng
+ * (dù là do game over hay disconnect). Rớt kết nối giữa ván thì phiên được
+ * đỗ lại (record vẫn ghim) để client khôi phục bằng resume token.
+ */
+void Server::onClose(Connection& conn) {
+    Session& s = conn.session;
+    if (!s.is_logged_in) return;
+    s.is_logged_in = false;
+
+    ResumeState state;
+    if (s.room) state.room = s.room->name;
+    leaveRoom(conn);
+
+    if (!sessions.resumeEnabled() || s.state == SessionState::GAME_OVER) {
+        sessions.logout(s.logged_in_username);
+        users->release(s.user_db_index);
+        LOG_INFO("User " << s.logged_in_username << " (socket " << conn.fd << ") has been logged out.");
+        return;
+    }
+
+    state.username = s.logged_in_username;
+    state.user_db_index = s.user_db_index;
+    state.state = s.state;
+    state.bank = std::move(s.bank);
+    state.question_index = s.question_index;
+    state.speed_round = s.speed_round;
+    state.batch = std::move(s.batch);
+    state.deck = std::move(s.deck);
+    state.deadline = conn.deadlineAt(); // Khôi phục phiên không được thêm giờ cho câu đang chờ
+    sessions.park(std::move(state));
+    metrics::add(metrics::SESSIONS_PARKED);
+    LOG_INFO("User " << s.logged_in_username << " (socket " << conn.fd << ") disconnected; session parked for "
+             << config.resume_timeout_s << "s.");
+}
+
+/**
+ * @brief Thỏa thuận encoding: client liệt kê các encoding nó hỗ trợ,
+ * server trả lời bằng JSON rồi dùng encoding đã chọn cho các thông điệp sau.
+ * Client cũ không gửi HELLO nên tiếp tục dùng JSON.
+ */
+void Server::handleHello(Connection& conn, const ArenaJson& hello) {
+    protocol::Encoding enc = protocol::Encoding::JSON;
+    ArenaJson offered = hello.value("payload", ArenaJson::object()).value("encodings", ArenaJson::array());
+    for (const auto& name : offered) {
+        if (name == protocol::encodingName(protocol::Encoding::MSGPACK)) {
+            enc = protocol::Encoding::MSGPACK;
+            break;
         }
+    }
 
-        // 4. Phản hồi kết quả (S2C_ANSWER_RESULT)
-        json r_msg;
-        r_msg["action"] = protocol::S2C_ANSWER_RESULT;
-        r_msg["payload"]["question_id"] = q.id;
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_HELLO;
+    r_msg["payload"]["encoding"] = protocol::encodingName(enc);
+    conn.send(std::move(r_msg));       // Trả lời HELLO luôn bằng encoding hiện tại (JSON)
+    conn.setEncoding(enc);
+}
 
-        if (is_correct) {
-            // --- TRẢ LỜI ĐÚNG ---
-            {
-                std::lock_guard<std::mutex> lock(g_users_mutex);
-                current_score = loaded_users[user_db_index]["score"];
-                current_score++; // Cộng điểm
-                loaded_users[user_db_index]["score"] = current_score;
-                saveUsers("../data/users.json"); // Lưu điểm mới
+/**
+ * @brief GIAI ĐOẠN 1: ĐĂNG NHẬP
+ */
+void Server::handleLogin(Connection& conn, const ArenaJson& request) {
+    Session& s = conn.session;
+    LOG_DEBUG("Received login attempt from client " << conn.fd);
+
+    if (protocol::actionOf(request) != protocol::C2S_LOGIN_REQUEST) {
+        // Gửi lệnh khác khi chưa đăng nhập
+        ArenaJson r_msg;
+        r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
+        r_msg["payload"]["message"] = "Please login first.";
+        conn.send(std::move(r_msg));
+        return;
+    }
+    if (!admission->allowLogin(conn.peer_addr)) {
+        // IP đăng nhập quá nhanh (dò mật khẩu qua nhiều kết nối): không tính vào số lần sai
+        ArenaJson r_msg;
+        r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
+        r_msg["payload"]["message"] = "Too many login attempts from your address, please wait.";
+        conn.send(std::move(r_msg));
+        return;
+    }
+
+    // Thiếu/sai kiểu username, password: username rỗng -> S2C_LOGIN_FAILURE như user không tồn tại
+    std::string user(payloadString(request, "username"));
+    std::string pass(payloadString(request, "password"));
+    std::string fail_reason = "";
+    // Speed round (tùy chọn): số câu mỗi lượt, giới hạn ở MAX_SPEED_ROUND
+    const ArenaJson* speed_field = payloadField(request, "speed_round");
+    int64_t speed_round = speed_field && speed_field->is_number_integer() ? speed_field->get<int64_t>() : 0;
+    s.speed_round = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(speed_round, protocol::MAX_SPEED_ROUND)));
+    // Phòng chơi nhiều người (tùy chọn)
+    std::string room(payloadString(request, "room").substr(0, protocol::MAX_ROOM_NAME));
+
+    // BƯỚC 1: Kiểm tra CSDL (username, status); chỉ khóa record của user trong chốc lát
+    std::string stored_password;
+    int index;
+    {
+        metrics::ScopedTimer timer(metrics::LOGIN_CHECK);
+        index = lookupAccount(user, s.login_attempts, fail_reason, stored_password);
+    }
+    if (index < 0) {
+        loginFailed(conn, fail_reason);
+        return;
+    }
+
+    // BƯỚC 2: Kiểm tra mật khẩu (băm chậm) trên pool xác thực; kết quả quay về
+    // task xử lý inbox của kết nối này qua Reactor::post (finishLogin)
+    s.state = SessionState::AUTH_PENDING;
+    std::shared_ptr<Connection> self = conn.shared_from_this();
+    bool queued = auth_executor->trySubmit([this, self, index, user, pass, stored_password, room]() {
+        bool password_ok = false;
+        std::string upgraded_password;
+        {
+            metrics::ScopedTimer timer(metrics::PASSWORD_VERIFY);
+            password_ok = password::verify(pass, stored_password);
+            if (password_ok && password::needsRehash(stored_password, config.auth_iterations)) {
+                upgraded_password = password::hash(pass, config.auth_iterations);
             }
-            
-            r_msg["payload"]["is_correct"] = true;
-            r_msg["payload"]["new_score"] = current_score; // Gửi điểm mới
-            
-            std::cout << "Client " << client_socket << " correct. New score: " << current_score << std::endl;
-            if(!protocol::sendMessage(client_socket, r_msg)) break;
-            // Vòng lặp while(true) tiếp tục -> gửi câu tiếp theo
+        }
+        self->owner->post(self, [this, self, index, user, room, password_ok, stored_password, upgraded_password]() {
+            finishLogin(*self, index, user, room, password_ok, stored_password, upgraded_password);
+        });
+    });
+    if (!queued) {
+        // Quá nhiều lượt đăng nhập đang chờ: từ chối nhanh, không tính là 1 lần sai
+        metrics::add(metrics::AUTH_BUSY);
+        s.state = SessionState::LOGIN;
+        users->release(index);
+        ArenaJson r_msg;
+        r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
+        r_msg["payload"]["message"] = "Too many logins in progress. Please try again later.";
+        conn.send(std::move(r_msg));
+    }
+}
+
+void Server::loginFailed(Connection& conn, const std::string& fail_reason) {
+    Session& s = conn.session;
+    metrics::add(metrics::LOGINS_FAILED);
+    // Đăng nhập thất bại (sai pass, bị khóa, v.v.)
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
+    r_msg["payload"]["message"] = fail_reason;
+    conn.send(std::move(r_msg));
+
+    if (s.login_attempts >= 3) {
+        LOG_INFO("Client " << conn.fd << " failed login 3 times. Disconnecting.");
+        s.state = SessionState::GAME_OVER;
+        conn.closeAfterFlush();
+    }
+}
+
+/**
+ * @brief Phần còn lại của đăng nhập, chạy trong task xử lý inbox khi đã có kết quả
+ * kiểm tra mật khẩu (record 'index' vẫn đang ghim).
+ */
+void Server::finishLogin(Connection& conn, int index, const std::string& user, const std::string& room,
+                         bool password_ok, const std::string& stored_password, const std::string& upgraded_password) {
+    Session& s = conn.session;
+    s.state = SessionState::LOGIN;
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        if (conn.closing || conn.closed) {
+            users->release(index); // Client đã đi trong lúc chờ kiểm tra mật khẩu
+            return;
+        }
+    }
+
+    std::string fail_reason;
+    if (!checkLogin(index, password_ok, stored_password, upgraded_password, s.login_attempts, fail_reason)) {
+        loginFailed(conn, fail_reason);
+        return;
+    }
+    s.user_db_index = index;
+
+    // BƯỚC 2: KIỂM TRA SESSION (user đã login ở client khác chưa)
+    std::string token;
+    std::optional<ResumeState> replaced;
+    if (!sessions.login(user, token, replaced)) {
+        ArenaJson r_msg;
+        r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
+        r_msg["payload"]["message"] = "This account is already logged in elsewhere.";
+        conn.send(std::move(r_msg));
+        users->release(s.user_db_index);
+        return;
+    }
+    if (replaced) {
+        // Đăng nhập lại bằng mật khẩu thay cho phiên đang đỗ: bỏ ghim record của phiên đó
+        users->release(replaced->user_db_index);
+    }
+
+    // Đăng nhập thành công, session hợp lệ
+    s.is_logged_in = true;
+    s.logged_in_username = user;
+
+    metrics::add(metrics::LOGINS_OK);
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_LOGIN_SUCCESS;
+    r_msg["payload"]["message"] = "Login successful!";
+    if (sessions.resumeEnabled()) {
+        r_msg["payload"]["resume_token"] = token;
+    }
+    conn.send(std::move(r_msg));
+
+    // GIAI ĐOẠN 2: BẮT ĐẦU GAME
+    LOG_INFO("Client " << conn.fd << " logged in as " << user << ". Starting game.");
+    s.current_score = users->withRecord(s.user_db_index, [](UserRecord& r) { return r.score; });
+    if (!room.empty()) {
+        joinRoom(conn, room);
+    } else if (s.speed_round > 0) {
+        sendBatch(conn);
+    } else {
+        sendQuestion(conn);
+    }
+}
+
+/**
+ * @brief Khôi phục phiên bị rớt kết nối: 1 lần tra token, không kiểm tra
+ * mật khẩu, không đọc CSDL (record vẫn đang ghim). Client nhận lại câu hỏi
+ * (hoặc lượt speed round) đang chờ trả lời, hoặc vào lại phòng cũ.
+ */
+void Server::handleResume(Connection& conn, const ArenaJson& request) {
+    Session& s = conn.session;
+    std::string token(payloadString(request, "resume_token"));
+    ResumeState state;
+    std::string new_token;
+    if (token.empty() || !sessions.resume(token, state, new_token)) {
+        // Không tính là 1 lần đăng nhập sai: client đăng nhập lại bằng mật khẩu
+        ArenaJson r_msg;
+        r_msg["action"] = protocol::S2C_LOGIN_FAILURE;
+        r_msg["payload"]["message"] = "Session expired. Please log in again.";
+        conn.send(std::move(r_msg));
+        return;
+    }
+
+    metrics::add(metrics::SESSIONS_RESUMED);
+    s.is_logged_in = true;
+    s.logged_in_username = state.username;
+    s.user_db_index = state.user_db_index;
+    s.bank = std::move(state.bank);
+    s.question_index = state.question_index;
+    s.speed_round = state.speed_round;
+    s.batch = std::move(state.batch);
+    s.deck = std::move(state.deck);
+    s.current_score = users->withRecord(s.user_db_index, [](UserRecord& r) { return r.score; });
+
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_LOGIN_SUCCESS;
+    r_msg["payload"]["message"] = "Session resumed.";
+    r_msg["payload"]["resume_token"] = new_token;
+    r_msg["payload"]["resumed"] = true;
+    r_msg["payload"]["score"] = s.current_score;
+    conn.send(std::move(r_msg));
+    LOG_INFO("Client " << conn.fd << " resumed the session of " << s.logged_in_username << ".");
+
+    if (!state.room.empty()) {
+        joinRoom(conn, state.room); // Hạn chót tính theo lúc mở lượt của phòng
+        return;
+    }
+    // Câu/lượt gửi lại giữ hạn chót cũ: rớt kết nối rồi khôi phục không được thêm giờ
+    s.state = state.state == SessionState::AWAIT_BATCH ? SessionState::AWAIT_BATCH : SessionState::AWAIT_ANSWER;
+    uint64_t now = TimingWheel::nowMs();
+    if (state.deadline != 0 && state.deadline <= now) {
+        onDeadline(conn); // Đã hết giờ trong lúc mất kết nối: chấm như hết giờ
+        return;
+    }
+    if (s.state == SessionState::AWAIT_BATCH) {
+        sendBatchQuestions(conn);
+    } else {
+        conn.send(s.bank->get(s.question_index).frame());
+    }
+    conn.setDeadline(std::chrono::milliseconds(state.deadline != 0 ? state.deadline - now : 0));
+}
+
+/**
+ * @brief Gửi câu hỏi (S2C_NEW_QUESTION, frame đã mã hóa sẵn) và chờ trả lời.
+ */
+void Server::sendQuestion(Connection& conn) {
+    metrics::ScopedTimer timer(metrics::QUESTION_SEND);
+    Session& s = conn.session;
+    questions.refresh(s.bank); // Câu mới lấy từ bản mới nhất của kho (nếu vừa nạp lại)
+    s.question_index = s.deck.draw(s.bank->size());
+    conn.send(s.bank->get(s.question_index).frame());
+    conn.setDeadline(std::chrono::seconds(config.answer_timeout_s));
+
+    s.state = SessionState::AWAIT_ANSWER;
+}
+
+/**
+ * @brief GIAI ĐOẠN 2: XỬ LÝ CÂU TRẢ LỜI
+ */
+void Server::handleAnswer(Connection& conn, const ArenaJson& a_msg, bool timed_out) {
+    metrics::ScopedTimer timer(metrics::ANSWER_HANDLE);
+    Session& s = conn.session;
+    QuestionBank::Question q = s.bank->get(s.question_index);
+
+    LOG_DEBUG("Received answer from client " << conn.fd << ": " << (timed_out ? "(timed out)" : a_msg.dump()));
+
+    // 1. Xử lý câu trả lời
+    bool is_correct = false;
+    if (!timed_out && protocol::actionOf(a_msg) == protocol::C2S_SUBMIT_ANSWER &&
+        payloadString(a_msg, "question_id") == q.id() &&
+        payloadString(a_msg, "answer") == q.correctAnswer()) {
+        is_correct = true;
+    }
+    metrics::add(is_correct ? metrics::ANSWERS_CORRECT : metrics::ANSWERS_WRONG);
+
+    // 2. Phản hồi kết quả (S2C_ANSWER_RESULT)
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_ANSWER_RESULT;
+    r_msg["payload"]["question_id"] = q.id();
+
+    if (is_correct) {
+        // --- TRẢ LỜI ĐÚNG ---
+        s.current_score = users->withRecord(s.user_db_index, [&](UserRecord& r) {
+            r.score++; // Cộng điểm
+            saveScore(r); // Lưu điểm mới (commit theo batch) + cập nhật bảng xếp hạng
+            return r.score;
+        });
+
+        r_msg["payload"]["is_correct"] = true;
+        r_msg["payload"]["new_score"] = s.current_score; // Gửi điểm mới
+
+        LOG_DEBUG("Client " << conn.fd << " correct. New score: " << s.current_score);
+        conn.send(std::move(r_msg));
+        sendQuestion(conn); // Gửi câu tiếp theo
+        return;
+    }
+
+    // --- TRẢ LỜI SAI ---
+    r_msg["payload"]["is_correct"] = false;
+    r_msg["payload"]["correct_answer"] = q.correctAnswer();
+    r_msg["payload"]["final_score"] = s.current_score; // Gửi điểm cuối cùng
+    if (timed_out) r_msg["payload"]["timed_out"] = true;
+
+    LOG_DEBUG("Client " << conn.fd << " wrong. Game over. Resetting score to 0.");
+    conn.send(std::move(r_msg));
 
+    // Yêu cầu: Reset điểm về 0 khi chơi xong
+    users->withRecord(s.user_db_index, [&](UserRecord& r) {
+        r.score = 0; // Đặt lại điểm
+        saveScore(r); // Lưu lại (commit theo batch)
+    });
+    LOG_DEBUG("Score for user " << s.logged_in_username << " has been reset to 0.");
+
+    // GIAI ĐOẠN 3: Kết thúc, đóng kết nối sau khi gửi xong kết quả (onClose sẽ logout)
+    s.state = SessionState::GAME_OVER;
+    conn.closeAfterFlush();
+}
+
+
+/**
+ * @brief Gửi 1 lượt speed round: N câu hỏi trong 1 frame S2C_QUESTION_BATCH.
+ */
+void Server::sendBatch(Connection& conn) {
+    metrics::ScopedTimer timer(metrics::QUESTION_SEND);
+    Session& s = conn.session;
+    s.batch.clear();
+    questions.refresh(s.bank);
+    for (int i = 0; i < s.speed_round; ++i) {
+        s.batch.push_back(s.deck.draw(s.bank->size()));
+    }
+    sendBatchQuestions(conn);
+}
+
+void Server::sendBatchQuestions(Connection& conn) {
+    Session& s = conn.session;
+    ArenaJson b_msg;
+    b_msg["action"] = protocol::S2C_QUESTION_BATCH;
+    ArenaJson& list = b_msg["payload"]["questions"] = ArenaJson::array();
+    for (size_t index : s.batch) {
+        QuestionBank::Question q = s.bank->get(index);
+        // Gán từng trường từ string_view: chuỗi chép thẳng vào arena, không qua std::string tạm
+        ArenaJson& item = list.emplace_back();
+        item["question_id"] = q.id();
+        item["question_text"] = q.text();
+        ArenaJson& options = item["options"] = ArenaJson::object();
+        for (size_t o = 0; o < q.numOptions(); ++o) {
+            options[ArenaJson::string_t(q.optionKey(o))] = q.optionValue(o);
+        }
+    }
+    conn.send(std::move(b_msg));
+    conn.setDeadline(std::chrono::seconds(config.answer_timeout_s) * static_cast<int>(s.batch.size()));
+
+    s.state = SessionState::AWAIT_BATCH;
+}
+
+/**
+ * @brief Chấm 1 lượt speed round: câu trả lời thứ i ứng với câu hỏi thứ i của lượt.
+ * Mọi câu đúng đều được cộng điểm; có câu sai thì kết thúc game (như chế độ thường).
+ * Cả lượt chỉ cập nhật record và ghi CSDL 1 lần.
+ */
+void Server::handleBatch(Connection& conn, const ArenaJson& b_msg, bool timed_out) {
+    metrics::ScopedTimer timer(metrics::ANSWER_HANDLE);
+    Session& s = conn.session;
+
+    // Trỏ thẳng vào mảng trong thông điệp (không copy); thiếu hoặc sai kiểu = không trả lời câu nào
+    const ArenaJson* answers = nullptr;
+    if (protocol::actionOf(b_msg) == protocol::C2S_SUBMIT_BATCH) {
+        answers = payloadField(b_msg, "answers");
+        if (answers && !answers->is_array()) answers = nullptr;
+    }
+
+    // 1. Chấm từng câu
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_BATCH_RESULT;
+    ArenaJson& results = r_msg["payload"]["results"] = ArenaJson::array();
+    int correct_count = 0;
+    for (size_t i = 0; i < s.batch.size(); ++i) {
+        QuestionBank::Question q = s.bank->get(s.batch[i]);
+        // Phần tử hỏng (không phải object, thiếu trường, sai kiểu) tính là trả lời sai
+        bool is_correct = answers && i < answers->size() &&
+                          stringField((*answers)[i], "question_id") == q.id() &&
+                          stringField((*answers)[i], "answer") == q.correctAnswer();
+
+        ArenaJson& result = results.emplace_back();
+        result["question_id"] = q.id();
+        result["is_correct"] = is_correct;
+        if (is_correct) {
+            correct_count++;
         } else {
-            // --- TRẢ LỜI SAI ---
-            r_msg["payload"]["is_correct"] = false;
-            r_msg["payload"]["correct_answer"] = q.correct_answer;
-            r_msg["payload"]["final_score"] = current_score; // Gửi điểm cuối cùng
-
-            std::cout << "Client " << client_socket << " wrong. Game over. Resetting score to 0." << std::endl;
-            protocol::sendMessage(client_socket, r_msg);
-            
-            // Yêu cầu: Reset điểm về 0 khi chơi xong
-            {
-                std::lock_guard<std::mutex> lock(g_users_mutex);
-                loaded_users[user_db_index]["score"] = 0; // Đặt lại điểm
-                saveUsers("../data/users.json"); // Lưu lại file
-                std::cout << "Score for user " << logged_in_username << " has been reset to 0." << std::endl;
-            }
-            
-            break; // THOÁT khỏi vòng lặp game
+            result["correct_answer"] = q.correctAnswer();
         }
-    } // Kết thúc while(true) game loop
+    }
+    bool game_over = correct_count < static_cast<int>(s.batch.size());
+    metrics::add(metrics::ANSWERS_CORRECT, correct_count);
+    metrics::add(metrics::ANSWERS_WRONG, s.batch.size() - correct_count);
+    r_msg["payload"]["correct_count"] = correct_count;
+    r_msg["payload"]["game_over"] = game_over;
+    if (timed_out) r_msg["payload"]["timed_out"] = true;
+
+    // 2. Cập nhật điểm 1 lần cho cả lượt
+    if (!game_over) {
+        s.current_score = users->withRecord(s.user_db_index, [&](UserRecord& r) {
+            r.score += correct_count;
+            saveScore(r); // Lưu điểm mới (commit theo batch) + cập nhật bảng xếp hạng
+            return r.score;
+        });
+        r_msg["payload"]["new_score"] = s.current_score;
+
+        LOG_DEBUG("Client " << conn.fd << " cleared a speed round. New score: " << s.current_score);
+        conn.send(std::move(r_msg));
+        sendBatch(conn); // Lượt tiếp theo
+        return;
+    }
+
+    // --- CÓ CÂU SAI: điểm của lượt vẫn được tính vào điểm cuối, rồi reset về 0 ---
+    r_msg["payload"]["final_score"] = s.current_score + correct_count;
+    users->withRecord(s.user_db_index, [&](UserRecord& r) {
+        r.score = 0;
+        saveScore(r); // Lưu lại (commit theo batch)
+    });
+
+    LOG_DEBUG("Client " << conn.fd << " missed " << (s.batch.size() - correct_count)
+              << " question(s) in a speed round. Game over.");
+    conn.send(std::move(r_msg));
+
+    s.state = SessionState::GAME_OVER;
+    conn.closeAfterFlush();
+}
+
+// ==========================================================
+// BẢNG XẾP HẠNG
+// ==========================================================
+
+void Server::handleLeaderboard(Connection& conn, const ArenaJson& request) {
+    ArenaJson payload = request.value("payload", ArenaJson::object());
+    size_t offset = 0;
+    size_t limit = 10;
+    if (payload.contains("offset") && payload["offset"].is_number_unsigned()) {
+        offset = payload["offset"].get<size_t>();
+    }
+    if (payload.contains("limit") && payload["limit"].is_number_unsigned()) {
+        limit = std::min(payload["limit"].get<size_t>(), protocol::MAX_LEADERBOARD_LIMIT);
+    }
 
-    // --- GIAI ĐOẠN 3: LOGOUT (RẤT QUAN TRỌNG) ---
-    // Xóa user khỏi session khi thread kết thúc (dù là do game over hay disconnect)
-    if (is_logged_in) {
-        std::lock_guard<std::mutex> session_lock(g_session_mutex);
-        active_sessions.erase(logged_in_username);
-        std::cout << "User " << logged_in_username << " (socket " << client_socket << ") has been logged out." << std::endl;
+    ArenaJson entries = ArenaJson::array();
+    for (const auto& e : leaderboard.top(offset, limit)) {
+        ArenaJson& entry = entries.emplace_back();
+        entry["rank"] = e.rank;
+        entry["username"] = e.username;
+        entry["score"] = e.score;
     }
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_LEADERBOARD;
+    r_msg["payload"]["total"] = leaderboard.size();
+    r_msg["payload"]["entries"] = std::move(entries);
+    conn.send(std::move(r_msg));
 }
 
+void Server::handleRank(Connection& conn, const ArenaJson& request) {
+    ArenaJson payload = request.value("payload", ArenaJson::object());
+    std::string username = payload.value("username", conn.session.logged_in_username);
+
+    Leaderboard::Entry e = leaderboard.rank(username);
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_RANK;
+    r_msg["payload"]["username"] = e.username;
+    r_msg["payload"]["rank"] = e.rank;
+    r_msg["payload"]["score"] = e.score;
+    r_msg["payload"]["total"] = leaderboard.size();
+    conn.send(std::move(r_msg));
+}
 
 // ==========================================================
-// CÁC HÀM CŨ (KHÔNG THAY ĐỔI)
+// PHÒNG CHƠI NHIỀU NGƯỜI
 // ==========================================================
 
 /**
- * @brief Tải câu hỏi từ file JSON.
+ * @brief Vào phòng: mọi người nhận bảng điểm mới; người mới nhận câu hỏi đang mở
+ * (phòng vừa tạo thì bắt đầu lượt đầu tiên).
  */
-void Server::loadQuestions(const std::string& filename) {
-    std::ifstream f(filename);
-    if (!f.is_open()) {
-        std::cerr << "Cannot open question file: " << filename << std::endl;
+void Server::joinRoom(Connection& conn, const std::string& name) {
+    Session& s = conn.session;
+    std::unique_lock<std::mutex> rooms_lock(rooms_mutex);
+    std::shared_ptr<Room>& slot = rooms[name];
+    if (!slot) slot = std::make_shared<Room>(name);
+    s.room = slot;
+    std::lock_guard<std::mutex> room_lock(s.room->mutex);
+    rooms_lock.unlock();
+
+    Room& room = *s.room;
+    Room::Member member;
+    member.conn = conn.shared_from_this();
+    member.username = s.logged_in_username;
+    room.members.push_back(std::move(member));
+    s.state = SessionState::IN_ROOM;
+    LOG_INFO("User " << s.logged_in_username << " joined room " << name << " ("
+             << room.members.size() << " player(s)).");
+
+    broadcastStandings(room, ArenaJson::object());
+    if (!room.round_open) {
+        startRound(room);
         return;
     }
-    
-    try {
-        json data = json::parse(f);
-        for (const auto& item : data) {
-            Question q;
-            q.id = item["id"];
-            q.text = item["question_text"];
-            q.correct_answer = item["correct_answer"];
-            // Parse map options
-            for (auto& [key, value] : item["options"].items()) {
-                q.options[key] = value;
-            }
-            questions.push_back(q);
-        }
-    } catch (json::parse_error& e) {
-        std::cerr << "Failed to parse questions file: " << e.what() << std::endl;
+    conn.send(room.bank->get(room.question_index).frame());
+    // Hạn chót tính theo lúc mở lượt: vào giữa lượt (kể cả khôi phục phiên) không được thêm giờ
+    uint64_t timeout_ms = static_cast<uint64_t>(std::max(0, config.answer_timeout_s)) * 1000;
+    uint64_t elapsed = TimingWheel::nowMs() - room.round_started;
+    if (timeout_ms == 0) {
+        conn.setDeadline(std::chrono::milliseconds(0));
+    } else if (elapsed >= timeout_ms) {
+        timeOutMember(room, conn, room.members.back());
+    } else {
+        conn.setDeadline(std::chrono::milliseconds(timeout_ms - elapsed));
+    }
+}
+
+void Server::leaveRoom(Connection& conn) {
+    Session& s = conn.session;
+    if (!s.room) return;
+    std::shared_ptr<Room> room = std::move(s.room);
+
+    std::lock_guard<std::mutex> rooms_lock(rooms_mutex);
+    std::lock_guard<std::mutex> room_lock(room->mutex);
+    auto& members = room->members;
+    members.erase(std::remove_if(members.begin(), members.end(),
+                                 [&](const Room::Member& m) { return m.conn.get() == &conn; }),
+                  members.end());
+    LOG_INFO("User " << s.logged_in_username << " left room " << room->name << ".");
+
+    if (members.empty()) {
+        auto it = rooms.find(room->name);
+        if (it != rooms.end() && it->second == room) rooms.erase(it);
+        return;
+    }
+    // Người rời phòng có thể là người cuối cùng chưa trả lời
+    if (room->round_open && room->allAnswered()) {
+        endRound(*room, "");
+    } else {
+        broadcastStandings(*room, ArenaJson::object());
     }
 }
 
 /**
- * @brief Lấy 1 câu hỏi ngẫu nhiên từ CSDL câu hỏi.
+ * @brief Mỗi người 1 lần trả lời mỗi lượt. Đúng: +1 điểm phòng và kết thúc lượt.
+ * Sai: chờ người khác; mọi người đều sai thì kết thúc lượt không ai thắng.
  */
-Question Server::getRandomQuestion() {
-    // Tạo bộ sinh số ngẫu nhiên (static để chỉ khởi tạo 1 lần)
-    static std::mt19937 gen(std::random_device{}());
-    std::uniform_int_distribution<> dist(0, questions.size() - 1);
-    return questions[dist(gen)];
+void Server::handleRoomAnswer(Connection& conn, const ArenaJson& a_msg) {
+    metrics::ScopedTimer timer(metrics::ANSWER_HANDLE);
+    Session& s = conn.session;
+    Room& room = *s.room;
+    std::string_view question_id = payloadString(a_msg, "question_id");
+
+    std::lock_guard<std::mutex> room_lock(room.mutex);
+    Room::Member* me = room.find(&conn);
+    QuestionBank::Question q = room.bank->get(room.question_index);
+
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_ANSWER_RESULT;
+    r_msg["payload"]["room"] = room.name;
+    r_msg["payload"]["question_id"] = question_id;
+
+    // Câu của lượt đã kết thúc, hoặc đã trả lời lượt này: không chấm
+    if (protocol::actionOf(a_msg) != protocol::C2S_SUBMIT_ANSWER || !me || !room.round_open ||
+        question_id != q.id() || me->answered) {
+        r_msg["payload"]["is_correct"] = false;
+        r_msg["payload"]["round_over"] = true;
+        conn.send(std::move(r_msg));
+        return;
+    }
+
+    me->answered = true;
+    bool is_correct = payloadString(a_msg, "answer") == q.correctAnswer();
+    metrics::add(is_correct ? metrics::ANSWERS_CORRECT : metrics::ANSWERS_WRONG);
+    r_msg["payload"]["is_correct"] = is_correct;
+    if (is_correct) {
+        me->points++;
+        r_msg["payload"]["new_score"] = me->points;
+        conn.send(std::move(r_msg));
+        LOG_DEBUG("User " << me->username << " won round " << room.round << " in room " << room.name);
+        endRound(room, me->username);
+        return;
+    }
+
+    conn.send(std::move(r_msg));
+    if (room.allAnswered()) {
+        endRound(room, "");
+    }
+}
+
+/**
+ * @brief Hạn chót của thành viên được đặt lại mỗi lượt (startRound, từ task của
+ * thành viên khác), nên kiểm tra lại: lượt đang mở phải đã quá answer_timeout.
+ */
+void Server::handleRoomTimeout(Connection& conn) {
+    Room& room = *conn.session.room;
+    std::lock_guard<std::mutex> room_lock(room.mutex);
+    Room::Member* me = room.find(&conn);
+    uint64_t timeout_ms = static_cast<uint64_t>(config.answer_timeout_s) * 1000;
+    if (!me || !room.round_open || me->answered ||
+        TimingWheel::nowMs() - room.round_started < timeout_ms) {
+        return;
+    }
+    timeOutMember(room, conn, *me);
+}
+
+void Server::timeOutMember(Room& room, Connection& conn, Room::Member& me) {
+    me.answered = true;
+    metrics::add(metrics::ANSWER_TIMEOUTS);
+    metrics::add(metrics::ANSWERS_WRONG);
+    ArenaJson r_msg;
+    r_msg["action"] = protocol::S2C_ANSWER_RESULT;
+    r_msg["payload"]["room"] = room.name;
+    r_msg["payload"]["question_id"] = room.bank->get(room.question_index).id();
+    r_msg["payload"]["is_correct"] = false;
+    r_msg["payload"]["timed_out"] = true;
+    conn.send(std::move(r_msg));
+    if (room.allAnswered()) {
+        endRound(room, "");
+    }
+}
+
+void Server::endRound(Room& room, const std::string& winner) {
+    QuestionBank::Question q = room.bank->get(room.question_index);
+    room.round_open = false;
+
+    ArenaJson payload;
+    payload["question_id"] = q.id();
+    payload["correct_answer"] = q.correctAnswer();
+    payload["winner"] = winner;
+    broadcastStandings(room, std::move(payload));
+    startRound(room);
+}
+
+void Server::startRound(Room& room) {
+    metrics::ScopedTimer timer(metrics::QUESTION_SEND);
+    questions.refresh(room.bank); // Lượt đang dở (nếu có) đã kết thúc với bản cũ
+    room.question_index = room.deck.draw(room.bank->size());
+    room.round++;
+    room.round_started = TimingWheel::nowMs();
+    room.round_open = true;
+    for (auto& m : room.members) {
+        m.answered = false;
+        // Reactor hẹn giờ khi flush frame câu hỏi bên dưới
+        m.conn->setDeadline(std::chrono::seconds(config.answer_timeout_s));
+    }
+    // Frame nằm sẵn trong file mmap: cả phòng cùng tham chiếu 1 vùng nhớ
+    room.broadcast(room.bank->get(room.question_index).frame());
+}
+
+void Server::broadcastStandings(Room& room, ArenaJson payload) {
+    ArenaJson msg;
+    msg["action"] = protocol::S2C_ROOM_STANDINGS;
+    payload["room"] = room.name;
+    payload["round"] = room.round;
+    payload["standings"] = room.standings();
+    msg["payload"] = std::move(payload);
+    room.broadcast(protocol::prepareFrame(msg)); // Mã hóa 1 lần cho mọi thành viên
+    protocol::clearTree(msg);
 }
@@ -0,0 +1,124 @@
+#include "session_registry.hpp"
+#include "metrics.hpp"
+#include <cerrno>
+#include <stdexcept>
+#include <sys/random.h>
+
+std::string SessionRegistry::newToken() {
+    unsigned char bytes[16];
+    size_t filled = 0;
+    while (filled < sizeof(bytes)) {
+        ssize_t n = getrandom(bytes + filled, sizeof(bytes) - filled, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("getrandom failed");
+        }
+        filled += static_cast<size_t>(n);
+    }
+    static const char HEX[] = "0123456789abcdef";
+    std::string token;
+    token.reserve(sizeof(bytes) * 2);
+    for (unsigned char b : bytes) {
+        token.push_back(HEX[b >> 4]);
+        token.push_back(HEX[b & 0xF]);
+    }
+    return token;
+}
+
+bool SessionRegistry::login(const std::string& username, std::string& token, std::optional<ResumeState>& replaced) {
+    Shard& user_shard = shardFor(username);
+    std::string old_token;
+    {
+        auto lock = metrics::lockTimed(user_shard.mutex, metrics::SESSION_LOCK_WAIT);
+        auto it = user_shard.users.find(username);
+        if (it == user_shard.users.end()) {
+            token = newToken();
+            user_shard.users.emplace(username, token);
+            return true;
+        }
+        old_token = it->second;
+    }
+
+    // User đã có: chỉ đăng nhập được nếu phiên cũ đang đỗ (kết nối cũ đã rớt)
+    {
+        Shard& token_shard = shardFor(old_token);
+        auto lock = metrics::lockTimed(token_shard.mutex, metrics::SESSION_LOCK_WAIT);
+        auto it = token_shard.parked.find(old_token);
+        if (it == token_shard.parked.end()) return false; // Đang chơi ở kết nối khác
+        replaced = std::move(it->second.state);
+        token_shard.parked.erase(it);
+    }
+
+    token = newToken();
+    auto lock = metrics::lockTimed(user_shard.mutex, metrics::SESSION_LOCK_WAIT);
+    user_shard.users[username] = token;
+    return true;
+}
+
+void SessionRegistry::logout(const std::string& username) {
+    Shard& shard = shardFor(username);
+    auto lock = metrics::lockTimed(shard.mutex, metrics::SESSION_LOCK_WAIT);
+    shard.users.erase(username);
+}
+
+void SessionRegistry::park(ResumeState state) {
+    std::string token;
+    {
+        Shard& user_shard = shardFor(state.username);
+        auto lock = metrics::lockTimed(user_shard.mutex, metrics::SESSION_LOCK_WAIT);
+        auto it = user_shard.users.find(state.username);
+        if (it == user_shard.users.end()) return;
+        token = it->second;
+    }
+
+    Shard& token_shard = shardFor(token);
+    auto lock = metrics::lockTimed(token_shard.mutex, metrics::SESSION_LOCK_WAIT);
+    token_shard.parked[token] = Parked{std::move(state), Clock::now() + resume_timeout};
+}
+
+bool SessionRegistry::resume(const std::string& token, ResumeState& out, std::string& new_token) {
+    {
+        Shard& token_shard = shardFor(token);
+        auto lock = metrics::lockTimed(token_shard.mutex, metrics::SESSION_LOCK_WAIT);
+        auto it = token_shard.parked.find(token);
+        // Phiên quá hạn để expire() gỡ (và bỏ ghim record)
+        if (it == token_shard.parked.end() || it->second.expires <= Clock::now()) return false;
+        out = std::move(it->second.state);
+        token_shard.parked.erase(it);
+    }
+
+    new_token = newToken();
+    Shard& user_shard = shardFor(out.username);
+    auto lock = metrics::lockTimed(user_shard.mutex, metrics::SESSION_LOCK_WAIT);
+    user_shard.users[out.username] = new_token;
+    return true;
+}
+
+std::vector<ResumeState> SessionRegistry::expire() {
+    std::vector<std::pair<std::string, ResumeState>> expired; // (token, phiên)
+    Clock::time_point now = Clock::now();
+    for (Shard& shard : shards) {
+        auto lock = metrics::lockTimed(shard.mutex, metrics::SESSION_LOCK_WAIT);
+        for (auto it = shard.parked.begin(); it != shard.parked.end();) {
+            if (it->second.expires <= now) {
+                expired.emplace_back(it->first, std::move(it->second.state));
+                it = shard.parked.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::vector<ResumeState> result;
+    result.reserve(expired.size());
+    for (auto& [token, state] : expired) {
+        Shard& user_shard = shardFor(state.username);
+        {
+            auto lock = metrics::lockTimed(user_shard.mutex, metrics::SESSION_LOCK_WAIT);
+            auto it = user_shard.users.find(state.username);
+            if (it != user_shard.users.end() && it->second == token) user_shard.users.erase(it);
+        }
+        result.push_back(std::move(state));
+    }
+    return result;
+}
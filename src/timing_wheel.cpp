@@ -0,0 +1,127 @@
+#include "timing_wheel.hpp"
+#include <algorithm>
+#include <chrono>
+
+TimingWheel::TimingWheel(uint64_t now_ms) : current(now_ms / TICK_MS) {
+    for (auto& level : slots) {
+        for (Timer& head : level) {
+            head.prev = head.next = &head;
+        }
+    }
+}
+
+uint64_t TimingWheel::nowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void TimingWheel::unlink(Timer& timer) {
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = timer.next = nullptr;
+}
+
+/**
+ * @brief Xếp timer vào tầng thấp nhất chứa được khoảng cách tới hạn của nó
+ * (current <= expires < current + SLOTS^LEVELS). Không kéo hạn về: khi cascade,
+ * timer hết hạn đúng tick vừa đổ (expires == current) vào ô tầng 0 của tick này
+ * và chạy ngay trong lần advance() đó, không trễ 1 tick.
+ */
+void TimingWheel::insert(Timer& timer) {
+    uint64_t delta = timer.expires - current;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    Timer& head = slots[level][(timer.expires >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+}
+
+void TimingWheel::schedule(Timer& timer, uint64_t delay_ms) {
+    schedule(timer, delay_ms, nowMs());
+}
+
+void TimingWheel::schedule(Timer& timer, uint64_t delay_ms, uint64_t now_ms) {
+    if (timer.scheduled()) {
+        unlink(timer);
+    } else {
+        ++count;
+    }
+    static const uint64_t MAX_DELTA = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+    // Hạn đã qua hoặc ngay tick này: chạy ở tick kế tiếp (ô của tick này đã xử lý xong)
+    timer.expires = std::clamp((now_ms + delay_ms + TICK_MS - 1) / TICK_MS, current + 1, current + MAX_DELTA);
+    insert(timer);
+}
+
+void TimingWheel::cancel(Timer& timer) {
+    if (!timer.scheduled()) return;
+    unlink(timer);
+    --count;
+}
+
+/**
+ * @brief Đổ ô hiện tại của tầng 'level' xuống các tầng dưới.
+ */
+void TimingWheel::cascade(int level) {
+    Timer& head = slots[level][(current >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    while (head.next != &head) {
+        Timer& timer = *head.next;
+        unlink(timer);
+        insert(timer);
+    }
+}
+
+void TimingWheel::advance(uint64_t now_ms) {
+    uint64_t target = now_ms / TICK_MS;
+    while (current < target) {
+        ++current;
+        if (count == 0) {
+            current = target; // Không có timer: nhảy thẳng tới hiện tại
+            break;
+        }
+
+        // Tầng dưới vừa quay hết vòng: đổ các tầng trên xuống, từ tầng cao nhất cần đổ
+        int top = 0;
+        while (top < LEVELS - 1 && (current & ((uint64_t(1) << (SLOT_BITS * (top + 1))) - 1)) == 0) {
+            ++top;
+        }
+        for (int level = top; level >= 1; --level) {
+            cascade(level);
+        }
+
+        // Tách ô ra danh sách riêng: callback có thể hẹn/hủy timer khác trong lúc chạy
+        Timer& head = slots[0][current & (SLOTS - 1)];
+        if (head.next == &head) continue;
+        Timer expired;
+        expired.next = head.next;
+        expired.prev = head.prev;
+        expired.next->prev = &expired;
+        expired.prev->next = &expired;
+        head.prev = head.next = &head;
+
+        while (expired.next != &expired) {
+            Timer& timer = *expired.next;
+            unlink(timer);
+            --count;
+            timer.callback();
+        }
+    }
+}
+
+int TimingWheel::nextTimeoutMs(uint64_t now_ms) const {
+    if (count == 0) return -1;
+    // Ô khác rỗng gần nhất của tầng 0; không có thì tới lần đổ tầng 1 kế tiếp
+    uint64_t next = (current | (SLOTS - 1)) + 1;
+    for (uint64_t tick = current + 1; tick < next; ++tick) {
+        const Timer& head = slots[0][tick & (SLOTS - 1)];
+        if (head.next != &head) {
+            next = tick;
+            break;
+        }
+    }
+    uint64_t due_ms = next * TICK_MS;
+    return due_ms <= now_ms ? 0 : static_cast<int>(due_ms - now_ms);
+}
@@ -0,0 +1,374 @@
+#include "user_db.hpp"
+#include "metrics.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <sqlite3.h>
+
+// Khoảng chờ tối đa giữa 2 lần thử lại commit khi đĩa/CSDL đang lỗi
+static const int64_t COMMIT_RETRY_MAX_MS = 2000;
+
+UserStatus statusFromString(const std::string& s) {
+    return s == "blocked" ? UserStatus::BLOCKED : UserStatus::ACTIVE;
+}
+
+const char* statusToString(UserStatus s) {
+    return s == UserStatus::BLOCKED ? "blocked" : "active";
+}
+
+// Khóa chính là username: tra cứu theo B-tree, không cần rowid riêng
+static const char* const SCHEMA =
+    "CREATE TABLE IF NOT EXISTS users ("
+    " username TEXT PRIMARY KEY,"
+    " password TEXT NOT NULL,"
+    " score INTEGER NOT NULL DEFAULT 0,"
+    " status TEXT NOT NULL DEFAULT 'active'"
+    ") WITHOUT ROWID;"
+    // Thứ tự của bảng xếp hạng: dựng bảng xếp hạng bằng 1 lần quét index, không sắp xếp
+    "CREATE INDEX IF NOT EXISTS users_by_score ON users (score DESC, username)";
+
+/**
+ * @brief Mở 1 kết nối: WAL mode, fsync mỗi lần commit, chờ tối đa 5s khi CSDL đang bận.
+ */
+static sqlite3* openConnection(const std::string& path) {
+    sqlite3* db = nullptr;
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+    if (sqlite3_open_v2(path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+        LOG_ERROR("sqlite3_open(" << path << "): " << (db ? sqlite3_errmsg(db) : "out of memory"));
+        sqlite3_close(db);
+        return nullptr;
+    }
+    sqlite3_busy_timeout(db, 5000);
+    return db;
+}
+
+static sqlite3_stmt* prepare(sqlite3* db, const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("sqlite3_prepare(" << sql << "): " << sqlite3_errmsg(db));
+        return nullptr;
+    }
+    return stmt;
+}
+
+static void bindText(sqlite3_stmt* stmt, int index, const std::string& s) {
+    sqlite3_bind_text(stmt, index, s.data(), static_cast<int>(s.size()), SQLITE_STATIC);
+}
+
+/**
+ * @brief Chạy 1 statement đã bind (không trả về dòng), rồi reset để dùng lại.
+ */
+static bool stepDone(sqlite3_stmt* stmt) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return rc == SQLITE_DONE;
+}
+
+UserDb::UserDb(int commit_interval_ms, size_t batch_size)
+    : commit_interval_ms(commit_interval_ms), batch_size(batch_size) {}
+
+UserDb::~UserDb() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    commit_cv.notify_one();
+    if (writer.joinable()) writer.join();
+
+    for (sqlite3_stmt* stmt : {select_user, select_any, insert_user, update_score, update_status, update_password}) {
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(read_db);
+    sqlite3_close(write_db);
+}
+
+bool UserDb::open(const std::string& path) {
+    this->path = path;
+    write_db = openConnection(path);
+    if (!write_db) return false;
+    // synchronous=FULL: commit trả về khi WAL của SQLite đã fsync (giống group commit cũ)
+    if (!exec("PRAGMA journal_mode=WAL") || !exec("PRAGMA synchronous=FULL") || !exec(SCHEMA)) {
+        return false;
+    }
+    read_db = openConnection(path);
+    if (!read_db) return false;
+
+    select_user = prepare(read_db, "SELECT password, score, status FROM users WHERE username = ?1");
+    select_any = prepare(read_db, "SELECT 1 FROM users LIMIT 1");
+    insert_user = prepare(write_db,
+        "INSERT OR REPLACE INTO users (username, password, score, status) VALUES (?1, ?2, ?3, ?4)");
+    update_score = prepare(write_db, "UPDATE users SET score = ?2 WHERE username = ?1");
+    update_status = prepare(write_db, "UPDATE users SET status = ?2 WHERE username = ?1");
+    update_password = prepare(write_db, "UPDATE users SET password = ?2 WHERE username = ?1");
+    if (!select_user || !select_any || !insert_user || !update_score || !update_status || !update_password) {
+        return false;
+    }
+
+    writer = std::thread([this]() { writerLoop(); });
+    return true;
+}
+
+bool UserDb::exec(const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(write_db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        LOG_ERROR("sqlite3_exec(" << sql << "): " << (error ? error : "unknown error"));
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+bool UserDb::empty() {
+    std::lock_guard<std::mutex> lock(read_mutex);
+    bool has_row = sqlite3_step(select_any) == SQLITE_ROW;
+    sqlite3_reset(select_any);
+    return !has_row;
+}
+
+bool UserDb::insertAll(const std::vector<UserRecord>& users) {
+    // Chỉ dùng lúc khởi động, trước thay đổi đầu tiên; khóa 'mutex' để không trùng với writer
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!exec("BEGIN")) return false;
+    for (const auto& r : users) {
+        bindText(insert_user, 1, r.username);
+        bindText(insert_user, 2, r.password);
+        sqlite3_bind_int(insert_user, 3, r.score);
+        sqlite3_bind_text(insert_user, 4, statusToString(r.status), -1, SQLITE_STATIC);
+        if (!stepDone(insert_user)) {
+            LOG_ERROR("Cannot insert user " << r.username << ": " << sqlite3_errmsg(write_db));
+            exec("ROLLBACK");
+            return false;
+        }
+    }
+    return exec("COMMIT");
+}
+
+void UserDb::apply(const PendingUser& change, UserRecord& r) {
+    if (change.has_score) r.score = change.score;
+    if (change.has_status) r.status = change.status;
+    if (change.has_password) r.password = change.password;
+}
+
+/**
+ * @brief Đọc 1 user. Thay đổi chưa commit được chép ra TRƯỚC khi đọc CSDL:
+ * thay đổi nào không có trong bản chép thì đã commit, nên SELECT sau đó thấy nó.
+ * (Trong lúc đọc không có thay đổi mới cho user này: chỉ record đang nằm trong
+ * cache mới được ghi, và cache chỉ đọc CSDL khi user chưa có trong cache.)
+ */
+bool UserDb::load(const std::string& username, UserRecord& out) {
+    metrics::ScopedTimer timer(metrics::DB_LOAD);
+    bool has_overlay = false;
+    PendingUser overlay;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const PendingMap* map : {&committing, &pending}) {
+            auto it = map->find(username);
+            if (it == map->end()) continue;
+            has_overlay = true;
+            if (it->second.has_score) {
+                overlay.has_score = true;
+                overlay.score = it->second.score;
+            }
+            if (it->second.has_status) {
+                overlay.has_status = true;
+                overlay.status = it->second.status;
+            }
+            if (it->second.has_password) {
+                overlay.has_password = true;
+                overlay.password = it->second.password;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(read_mutex);
+    bindText(select_user, 1, username);
+    bool found = sqlite3_step(select_user) == SQLITE_ROW;
+    if (found) {
+        out.username = username;
+        out.password = reinterpret_cast<const char*>(sqlite3_column_text(select_user, 0));
+        out.score = sqlite3_column_int(select_user, 1);
+        out.status = statusFromString(reinterpret_cast<const char*>(sqlite3_column_text(select_user, 2)));
+        if (has_overlay) apply(overlay, out);
+    }
+    // reset ngay: giữ statement dở sẽ giữ transaction đọc, chặn checkpoint của WAL
+    sqlite3_reset(select_user);
+    sqlite3_clear_bindings(select_user);
+    return found;
+}
+
+bool UserDb::forEachScore(const std::function<bool(const std::string&, int32_t)>& f) {
+    // Kết nối riêng: quét lâu không giữ read_mutex của load(); cả lần quét thấy 1 snapshot
+    sqlite3* db = openConnection(path);
+    if (!db) return false;
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = "SELECT username, score FROM users INDEXED BY users_by_score ORDER BY score DESC, username";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("Cannot read scores: " << sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return false;
+    }
+    std::string username;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        username.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                        static_cast<size_t>(sqlite3_column_bytes(stmt, 0)));
+        if (!f(username, sqlite3_column_int(stmt, 1))) {
+            rc = SQLITE_DONE;
+            break;
+        }
+    }
+    if (rc != SQLITE_DONE) LOG_ERROR("Cannot read scores: " << sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return rc == SQLITE_DONE;
+}
+
+uint64_t UserDb::saveScore(const std::string& username, int32_t score) {
+    uint64_t seq;
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        PendingUser& p = pending[username];
+        p.has_score = true;
+        p.score = score;
+        seq = next_seq++;
+        wake = pending.size() >= batch_size;
+    }
+    if (wake) commit_cv.notify_one(); // Đủ batch: commit sớm
+    return seq;
+}
+
+uint64_t UserDb::savePassword(const std::string& username, const std::string& password) {
+    uint64_t seq;
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        PendingUser& p = pending[username];
+        p.has_password = true;
+        p.password = password;
+        seq = next_seq++;
+        wake = pending.size() >= batch_size;
+    }
+    if (wake) commit_cv.notify_one();
+    return seq;
+}
+
+uint64_t UserDb::saveStatus(const std::string& username, UserStatus status) {
+    uint64_t seq;
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        PendingUser& p = pending[username];
+        p.has_status = true;
+        p.status = status;
+        seq = next_seq++;
+        wake = pending.size() >= batch_size;
+    }
+    if (wake) commit_cv.notify_one();
+    return seq;
+}
+
+bool UserDb::waitDurable(uint64_t seq, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (durable_seq >= seq) return true;
+    // Báo writer commit ngay, không chờ hết commit_interval_ms hay đủ batch
+    urgent_seq = std::max(urgent_seq, seq);
+    commit_cv.notify_one();
+    durable_cv.wait_for(lock, timeout, [&]() { return durable_seq >= seq || stopping; });
+    return durable_seq >= seq;
+}
+
+/**
+ * @brief Ghi cả batch trong 1 transaction (1 lần fsync cho mọi user trong batch).
+ */
+bool UserDb::commitBatch(const PendingMap& batch) {
+    metrics::ScopedTimer timer(metrics::DB_COMMIT);
+    if (!exec("BEGIN")) return false;
+    bool ok = true;
+    for (const auto& [username, change] : batch) {
+        if (ok && change.has_score) {
+            bindText(update_score, 1, username);
+            sqlite3_bind_int(update_score, 2, change.score);
+            ok = stepDone(update_score);
+        }
+        if (ok && change.has_status) {
+            bindText(update_status, 1, username);
+            sqlite3_bind_text(update_status, 2, statusToString(change.status), -1, SQLITE_STATIC);
+            ok = stepDone(update_status);
+        }
+        if (ok && change.has_password) {
+            bindText(update_password, 1, username);
+            bindText(update_password, 2, change.password);
+            ok = stepDone(update_password);
+        }
+        if (!ok) break;
+    }
+    if (ok && exec("COMMIT")) {
+        metrics::add(metrics::DB_COMMITS);
+        return true;
+    }
+    LOG_ERROR("Cannot commit user updates: " << sqlite3_errmsg(write_db));
+    exec("ROLLBACK");
+    return false;
+}
+
+/**
+ * @brief Thread writer: mỗi chu kỳ commit toàn bộ thay đổi đang chờ trong 1 transaction.
+ * Commit lỗi thì trả thay đổi về hàng chờ (thay đổi mới hơn được giữ) và thử lại sau
+ * 1 khoảng chờ tăng gấp đôi mỗi lần lỗi (tới COMMIT_RETRY_MAX_MS): batch đầy hay
+ * waitDurable() không làm writer thử lại liên tục khi đĩa đang lỗi.
+ */
+void UserDb::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (failed_commits > 0) {
+            int shift = std::min(failed_commits - 1, 16);
+            auto backoff = std::min<int64_t>(int64_t(commit_interval_ms) << shift, COMMIT_RETRY_MAX_MS);
+            commit_cv.wait_for(lock, std::chrono::milliseconds(backoff), [&]() { return stopping; });
+        } else {
+            commit_cv.wait_for(lock, std::chrono::milliseconds(commit_interval_ms), [&]() {
+                // urgent_seq > durable_seq: có thread đang chờ 1 thay đổi còn trong 'pending'
+                return stopping || pending.size() >= batch_size || (urgent_seq > durable_seq && !pending.empty());
+            });
+        }
+        if (pending.empty()) {
+            if (stopping) break;
+            continue;
+        }
+
+        committing.swap(pending);
+        uint64_t upto = next_seq - 1;
+        lock.unlock();
+
+        // Ghi đĩa ngoài lock: các thread khác vẫn save*() bình thường
+        bool ok = commitBatch(committing);
+
+        lock.lock();
+        if (ok) {
+            if (failed_commits > 0) LOG_INFO("User updates committed again after " << failed_commits << " failed attempt(s).");
+            failed_commits = 0;
+            durable_seq = upto;
+            durable_cv.notify_all();
+        } else {
+            failed_commits++;
+            for (auto& [username, change] : committing) {
+                PendingUser& newer = pending[username];
+                if (!newer.has_score && change.has_score) {
+                    newer.has_score = true;
+                    newer.score = change.score;
+                }
+                if (!newer.has_status && change.has_status) {
+                    newer.has_status = true;
+                    newer.status = change.status;
+                }
+                if (!newer.has_password && change.has_password) {
+                    newer.has_password = true;
+                    newer.password = change.password;
+                }
+            }
+        }
+        committing.clear();
+        if (stopping && (pending.empty() || !ok)) break; // Lỗi khi đang dừng: không thử lại mãi
+    }
+}
@@ -0,0 +1,94 @@
+#include "user_store.hpp"
+#include <algorithm>
+
+UserStore::UserStore(UserDb& db, size_t capacity)
+    : db(db), entries(std::max<size_t>(capacity, 1)), shards(SHARDS), stripes(LOCK_STRIPES) {
+    free_slots.reserve(entries.size());
+    for (size_t i = entries.size(); i > 0; --i) {
+        free_slots.push_back(static_cast<int>(i - 1)); // Dùng ô 0 trước
+    }
+}
+
+/**
+ * @brief Ghim ô 'index' (đang giữ mutex của 'shard'): ô bị ghim lần đầu thì rời danh sách LRU.
+ */
+void UserStore::pin(Shard& shard, int index) {
+    Entry& e = entries[index];
+    if (e.pins++ == 0) shard.lru.erase(e.lru_pos);
+}
+
+/**
+ * @brief Lấy 1 ô cho user mới của phần 'home' (không giữ khóa nào): ô trống nếu còn,
+ * không thì bỏ ô ít dùng nhất của phần 'home', rồi của các phần khác.
+ * Ô trả về không bị ghim và không nằm trong index nào: chỉ thread gọi chạm tới nó.
+ * @return -1 nếu mọi ô đều đang bị ghim.
+ */
+int UserStore::takeSlot(size_t home) {
+    {
+        std::lock_guard<std::mutex> lock(free_mutex);
+        if (!free_slots.empty()) {
+            int index = free_slots.back();
+            free_slots.pop_back();
+            return index;
+        }
+    }
+    for (size_t k = 0; k < shards.size(); ++k) {
+        Shard& shard = shards[(home + k) % shards.size()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.lru.empty()) continue;
+        // Bỏ record ít dùng nhất; thay đổi của nó vẫn nằm trong UserDb (chưa commit thì ở bộ đệm)
+        int index = shard.lru.back();
+        shard.lru.pop_back();
+        shard.index_of.erase(entries[index].record.username);
+        return index;
+    }
+    return -1;
+}
+
+int UserStore::acquire(const std::string& username) {
+    size_t home = std::hash<std::string>()(username) % shards.size();
+    Shard& shard = shards[home];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index_of.find(username);
+        if (it != shard.index_of.end()) {
+            pin(shard, it->second);
+            metrics::add(metrics::USER_CACHE_HITS);
+            return it->second;
+        }
+    }
+
+    // Đọc CSDL ngoài khóa của cache: các user khác vẫn acquire/release bình thường
+    metrics::add(metrics::USER_CACHE_MISSES);
+    UserRecord loaded;
+    if (!db.load(username, loaded)) return NOT_FOUND;
+    int index = takeSlot(home);
+    if (index < 0) return CACHE_FULL;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index_of.find(username);
+    if (it != shard.index_of.end()) {
+        pin(shard, it->second); // Thread khác đã nạp user này trong lúc ta đọc CSDL
+        std::lock_guard<std::mutex> free_lock(free_mutex);
+        free_slots.push_back(index);
+        return it->second;
+    }
+
+    Entry& e = entries[index];
+    e.record = std::move(loaded);
+    e.shard = home;
+    e.pins = 1;
+    shard.index_of.emplace(username, index);
+    return index;
+}
+
+void UserStore::release(int index) {
+    // Ô đang ghim không đổi phần: đọc 'shard' trước khi khóa là an toàn
+    Shard& shard = shards[entries[index].shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry& e = entries[index];
+    if (--e.pins == 0) {
+        shard.lru.push_front(index);
+        e.lru_pos = shard.lru.begin();
+    }
+}
@@ -0,0 +1,91 @@
+#include "wal.hpp"
+#include "logger.hpp"
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <arpa/inet.h> // Cho ntohl, ntohs
+
+// --- CÁC HÀM GIẢI MÃ ---
+
+static bool getU16(const char*& p, const char* end, uint16_t& v) {
+    if (end - p < (long)sizeof(v)) return false;
+    std::memcpy(&v, p, sizeof(v));
+    v = ntohs(v);
+    p += sizeof(v);
+    return true;
+}
+
+static bool getU32(const char*& p, const char* end, uint32_t& v) {
+    if (end - p < (long)sizeof(v)) return false;
+    std::memcpy(&v, p, sizeof(v));
+    v = ntohl(v);
+    p += sizeof(v);
+    return true;
+}
+
+static bool getString(const char*& p, const char* end, std::string& s) {
+    uint16_t len;
+    if (!getU16(p, end, len) || end - p < len) return false;
+    s.assign(p, len);
+    p += len;
+    return true;
+}
+
+/**
+ * @brief Checksum FNV-1a 32-bit, đủ để phát hiện bản ghi bị ghi dở.
+ */
+static uint32_t checksum(const char* data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+long replayWal(const std::string& path, const std::function<void(const WalRecord&)>& apply) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) return -1;
+    std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    long count = 0;
+    const char* p = data.data();
+    const char* end = p + data.size();
+    while (p < end) {
+        uint32_t len, sum;
+        const char* rec = p;
+        if (!getU32(rec, end, len) || !getU32(rec, end, sum) || end - rec < (long)len ||
+            checksum(rec, len) != sum) {
+            LOG_WARN("WAL " << path << ": torn or corrupt record at offset "
+                     << (p - data.data()) << ", ignoring the rest.");
+            break;
+        }
+
+        const char* q = rec;
+        const char* q_end = rec + len;
+        WalRecord r;
+        bool ok = q < q_end;
+        if (ok) {
+            r.op = static_cast<WalRecord::Op>(static_cast<uint8_t>(*q++));
+            ok = getString(q, q_end, r.username);
+        }
+        if (ok && r.op == WalRecord::SET_SCORE) {
+            uint32_t v;
+            ok = getU32(q, q_end, v);
+            r.score = static_cast<int32_t>(v);
+        } else if (ok && r.op == WalRecord::SET_STATUS) {
+            ok = getString(q, q_end, r.status);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            LOG_WARN("WAL " << path << ": unknown record, ignoring the rest.");
+            break;
+        }
+
+        apply(r);
+        ++count;
+        p = q_end;
+    }
+    return count;
+}
@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "leaderboard.hpp"
+#include "question_deck.hpp"
+#include "timing_wheel.hpp"
+
+/**
+ * Kiểm thử tự kiểm tra ('make check') cho các cấu trúc dữ liệu tự viết, bằng cách
+ * chạy thao tác ngẫu nhiên và so với mô hình brute-force:
+ *   timing_wheel   hẹn/hủy/advance theo đồng hồ giả; mỗi timer phải chạy đúng tick hết hạn
+ *                  (kể cả qua ranh giới cascade 64/4096/262144 tick), theo thứ tự, và callback
+ *                  được hẹn lại/hủy timer (chính nó hoặc timer khác cùng tick)
+ *   leaderboard    update/insertIfAbsent với nhiều điểm trùng nhau; rank() và top() khớp với
+ *                  bảng sắp xếp lại từ đầu, checkInvariants() (thứ tự, span) sau mỗi thao tác
+ *   question_deck  n lần rút liên tiếp là 1 hoán vị của [0, n), kể cả khi n đổi giữa chừng
+ *                  (nút của map được dùng lại) và xác suất các hoán vị gần đều nhau
+ *
+ * Dùng: check [--seed N] [--rounds N]. Thất bại thì in seed để chạy lại và trả về mã lỗi 1.
+ */
+
+static uint64_t g_seed = 1;
+static int g_failures = 0;
+
+#define CHECK(cond)                                                                         \
+    do {                                                                                    \
+        if (!(cond)) {                                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed (seed " \
+                      << g_seed << ")" << std::endl;                                        \
+            if (++g_failures >= 20) std::exit(1);                                           \
+        }                                                                                   \
+    } while (0)
+
+// ==========================================================
+// TIMING WHEEL
+// ==========================================================
+
+static const uint64_t TICK = TimingWheel::TICK_MS;
+static const uint64_t MAX_DELTA = (uint64_t(1) << 24) - 1; // SLOTS^LEVELS - 1 tick
+
+/**
+ * @brief Mô hình: tick hết hạn của từng timer đang hẹn, tính giống hệt schedule()/insert().
+ */
+struct WheelModel {
+    TimingWheel wheel;
+    std::vector<TimingWheel::Timer> timers;
+    std::map<size_t, uint64_t> expected; // timer -> tick hết hạn
+    std::mt19937_64 rng;
+    uint64_t now_ms;
+    uint64_t processed;  // Tick wheel đã xử lý xong trước lần advance() đang chạy
+    uint64_t target = 0; // Tick của lần advance() đang chạy
+    uint64_t last_fired = 0;
+    size_t fired = 0;
+
+    WheelModel(uint64_t start_ms, size_t n, uint64_t seed)
+        : wheel(start_ms), timers(n), rng(seed), now_ms(start_ms), processed(start_ms / TICK) {
+        for (size_t i = 0; i < n; ++i) {
+            timers[i].callback = [this, i] { onFire(i); };
+        }
+    }
+
+    uint64_t random(uint64_t n) { return rng() % n; }
+
+    /**
+     * @brief Độ trễ ngẫu nhiên, dồn quanh các ranh giới tầng (64, 4096, 262144 tick).
+     */
+    uint64_t randomDelay() {
+        static const uint64_t BOUNDARIES[] = {1, 64, 4096, 262144};
+        switch (random(6)) {
+            case 0: return 0;
+            case 1: return random(64 * TICK);
+            case 2: return random(4096 * TICK);
+            case 3: {
+                uint64_t b = BOUNDARIES[random(4)] * TICK;
+                uint64_t jitter = random(3 * TICK);
+                return b > jitter && random(2) ? b - jitter : b + jitter;
+            }
+            case 4: return random(300000 * TICK);
+            default: return (MAX_DELTA - 2 + random(5)) * TICK; // Quanh hạn xa nhất (bị kéo về)
+        }
+    }
+
+    /**
+     * @brief Hẹn timer i; 'current' là tick wheel đang đứng (đang xử lý nếu gọi từ callback).
+     */
+    void arm(size_t i, uint64_t current) {
+        uint64_t delay = randomDelay();
+        wheel.schedule(timers[i], delay, now_ms);
+        uint64_t due = (now_ms + delay + TICK - 1) / TICK;
+        expected[i] = std::clamp(due, current + 1, current + MAX_DELTA);
+    }
+
+    void disarm(size_t i) {
+        wheel.cancel(timers[i]);
+        expected.erase(i);
+    }
+
+    void onFire(size_t i) {
+        auto it = expected.find(i);
+        CHECK(it != expected.end());
+        if (it == expected.end()) return;
+        uint64_t tick = it->second;
+        // Đúng lần advance() này, theo thứ tự hạn
+        CHECK(tick > processed && tick <= target);
+        CHECK(tick >= last_fired);
+        last_fired = tick;
+        expected.erase(it);
+        ++fired;
+        CHECK(!timers[i].scheduled());
+
+        // Trong callback: hẹn lại chính nó, hẹn/hủy timer khác (có thể là timer cùng tick chưa chạy)
+        switch (random(4)) {
+            case 0: arm(i, tick); break;
+            case 1: arm(random(timers.size()), tick); break;
+            case 2: disarm(random(timers.size())); break;
+            default: break;
+        }
+    }
+
+    void advanceTo(uint64_t ms) {
+        now_ms = ms;
+        target = ms / TICK;
+        last_fired = 0;
+        wheel.advance(ms);
+        processed = target;
+
+        // Mọi timer đã tới hạn đều phải chạy; số timer còn lại khớp với mô hình
+        for (const auto& [i, tick] : expected) {
+            CHECK(tick > target);
+            CHECK(timers[i].scheduled());
+        }
+        CHECK(wheel.size() == expected.size());
+
+        // nextTimeoutMs() không được chờ quá timer gần nhất
+        int timeout = wheel.nextTimeoutMs(now_ms);
+        if (expected.empty()) {
+            CHECK(timeout == -1);
+        } else {
+            uint64_t first = UINT64_MAX;
+            for (const auto& entry : expected) first = std::min(first, entry.second);
+            uint64_t due_ms = first * TICK;
+            CHECK(timeout >= 0 && now_ms + static_cast<uint64_t>(timeout) <= std::max(due_ms, now_ms));
+        }
+    }
+};
+
+/**
+ * @brief Thao tác ngẫu nhiên: hẹn, hủy, advance từng tick hoặc nhảy xa (nhiều tick trong 1 lần).
+ */
+static void checkWheelRandom(uint64_t start_ms, size_t timers, int steps, uint64_t seed) {
+    WheelModel m(start_ms, timers, seed);
+    for (int step = 0; step < steps; ++step) {
+        switch (m.random(16)) {
+            case 0:
+            case 1:
+            case 2:
+            case 3:
+            case 4:
+            case 5: m.arm(m.random(timers), m.processed); break;
+            case 6:
+            case 7: m.disarm(m.random(timers)); break;
+            case 8:
+            case 9: m.advanceTo(m.now_ms + m.random(5000 * TICK)); break;
+            case 10: m.advanceTo(m.now_ms + m.random(300000 * TICK)); break;
+            default: m.advanceTo(m.now_ms + m.random(2 * TICK)); break;
+        }
+    }
+    for (size_t t = 0; t < timers; ++t) m.disarm(t);
+    CHECK(m.wheel.size() == 0);
+    CHECK(m.wheel.nextTimeoutMs(m.now_ms) == -1);
+}
+
+/**
+ * @brief Timer đặt đúng ở/quanh ranh giới cascade, bắt đầu từ các vị trí lệch
+ * nhau của tầng dưới; advance từng tick để kiểm tra tick chạy chính xác.
+ */
+static void checkWheelBoundaries(uint64_t seed) {
+    static const uint64_t DELTAS[] = {1, 2, 63, 64, 65, 127, 128, 4031, 4095, 4096, 4097, 4160, 8192,
+                                      262143, 262144, 262145, 266240};
+    static const uint64_t OFFSETS[] = {0, 1, 62, 63, 64, 4032, 4094, 4095, 4096, 262143, 262144};
+    for (uint64_t offset : OFFSETS) {
+        // Đồng hồ bắt đầu ở 1 tick tùy ý nhưng cố định phần dư so với 262144 tick
+        uint64_t start_tick = (uint64_t(12345) << 24) + offset;
+        WheelModel m(start_tick * TICK, std::size(DELTAS), seed + offset);
+        for (size_t i = 0; i < std::size(DELTAS); ++i) {
+            m.wheel.schedule(m.timers[i], DELTAS[i] * TICK, m.now_ms);
+            m.expected[i] = start_tick + DELTAS[i];
+            m.timers[i].callback = [&m, i] {
+                CHECK(m.expected.count(i) && m.expected[i] == m.target); // Advance từng tick: đúng tick
+                m.expected.erase(i);
+                ++m.fired;
+            };
+        }
+        uint64_t end_tick = start_tick + 266241;
+        while (m.now_ms / TICK < end_tick) {
+            // Thỉnh thoảng nhảy vào giữa tick (advance làm tròn xuống)
+            m.advanceTo(m.now_ms + TICK + (m.random(4) == 0 ? m.random(TICK) : 0) - (m.now_ms % TICK));
+        }
+        CHECK(m.fired == std::size(DELTAS));
+        CHECK(m.wheel.size() == 0);
+    }
+}
+
+/**
+ * @brief Hạn xa hơn SLOTS^LEVELS tick bị kéo về hạn xa nhất, và chạy đúng tick đó.
+ */
+static void checkWheelClamp() {
+    uint64_t start_tick = 777;
+    TimingWheel wheel(start_tick * TICK);
+    TimingWheel::Timer far, farthest;
+    int fired = 0;
+    far.callback = farthest.callback = [&fired] { ++fired; };
+    wheel.schedule(far, MAX_DELTA * TICK, start_tick * TICK);
+    wheel.schedule(farthest, (MAX_DELTA + 100000) * TICK, start_tick * TICK);
+    wheel.advance((start_tick + MAX_DELTA - 1) * TICK);
+    CHECK(fired == 0 && wheel.size() == 2);
+    wheel.advance((start_tick + MAX_DELTA) * TICK);
+    CHECK(fired == 2 && wheel.size() == 0);
+}
+
+static void checkTimingWheel(int rounds) {
+    checkWheelClamp();
+    checkWheelBoundaries(g_seed);
+    for (int r = 0; r < rounds; ++r) {
+        std::mt19937_64 rng(g_seed + r);
+        uint64_t start_ms = rng() % (uint64_t(1) << 40);
+        checkWheelRandom(start_ms, 1 + rng() % 200, 2000, g_seed * 31 + r);
+    }
+}
+
+// ==========================================================
+// BẢNG XẾP HẠNG
+// ==========================================================
+
+static void checkLeaderboardAgainst(const Leaderboard& board, const std::map<std::string, int32_t>& scores,
+                                    std::mt19937_64& rng) {
+    CHECK(board.checkInvariants());
+    CHECK(board.size() == scores.size());
+
+    // Bảng đúng: điểm giảm dần, cùng điểm thì username tăng dần
+    std::vector<std::pair<int32_t, std::string>> sorted;
+    for (const auto& [name, score] : scores) sorted.emplace_back(-score, name);
+    std::sort(sorted.begin(), sorted.end());
+
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        Leaderboard::Entry e = board.rank(sorted[i].second);
+        CHECK(e.rank == i + 1);
+        CHECK(e.score == -sorted[i].first);
+    }
+    CHECK(board.rank("nobody").rank == 0);
+
+    for (int q = 0; q < 8; ++q) {
+        size_t offset = rng() % (sorted.size() + 3);
+        size_t count = rng() % 12;
+        std::vector<Leaderboard::Entry> page = board.top(offset, count);
+        size_t want = offset < sorted.size() ? std::min(count, sorted.size() - offset) : 0;
+        CHECK(page.size() == want);
+        for (size_t k = 0; k < page.size() && k < want; ++k) {
+            CHECK(page[k].rank == offset + k + 1);
+            CHECK(page[k].username == sorted[offset + k].second);
+            CHECK(page[k].score == -sorted[offset + k].first);
+        }
+    }
+}
+
+static void checkLeaderboard(int rounds) {
+    for (int r = 0; r < rounds; ++r) {
+        std::mt19937_64 rng(g_seed * 7 + r);
+        Leaderboard board;
+        std::map<std::string, int32_t> scores;
+        size_t users = 1 + rng() % 300;
+        int32_t score_range = 1 + static_cast<int32_t>(rng() % 20); // Nhỏ: nhiều điểm bằng nhau
+        for (int step = 0; step < 600; ++step) {
+            std::string name = "u" + std::to_string(rng() % users);
+            int32_t score = static_cast<int32_t>(rng() % score_range) - score_range / 4;
+            if (rng() % 4 == 0) {
+                board.insertIfAbsent(name, score);
+                scores.emplace(name, score);
+            } else {
+                board.update(name, score);
+                scores[name] = score;
+            }
+            if (step % 50 == 0) {
+                checkLeaderboardAgainst(board, scores, rng);
+            } else {
+                CHECK(board.checkInvariants());
+            }
+        }
+        checkLeaderboardAgainst(board, scores, rng);
+    }
+}
+
+// ==========================================================
+// DECK CÂU HỎI
+// ==========================================================
+
+/**
+ * @brief 'n' lần rút liên tiếp phải là 1 hoán vị của [0, n).
+ */
+static void checkPermutation(QuestionDeck& deck, size_t n) {
+    std::vector<bool> seen(n, false);
+    for (size_t i = 0; i < n; ++i) {
+        size_t index = deck.draw(n);
+        CHECK(index < n);
+        if (index >= n) return;
+        CHECK(!seen[index]);
+        seen[index] = true;
+    }
+}
+
+static void checkQuestionDeck(int rounds) {
+    std::mt19937_64 rng(g_seed * 13);
+    static const size_t SIZES[] = {1, 2, 3, 7, 30, 64, 1000, 65537};
+    for (int r = 0; r < rounds; ++r) {
+        QuestionDeck deck;
+        for (int step = 0; step < 20; ++step) {
+            size_t n = rng() % 3 ? SIZES[rng() % std::size(SIZES)] : 1 + rng() % 5000;
+            // Đổi kích thước giữa chừng 1 bộ: bộ mới bắt đầu lại, không lặp trong n lần rút tiếp theo
+            size_t partial = rng() % (n + 1);
+            for (size_t i = 0; i < partial; ++i) {
+                CHECK(deck.draw(n) < n);
+            }
+            size_t m = n + 1 + rng() % 100;
+            checkPermutation(deck, m);
+            checkPermutation(deck, m); // Rút hết thì xáo lại: bộ thứ 2 cũng là hoán vị
+            checkPermutation(deck, n);
+        }
+    }
+
+    // Phân bố: 6 hoán vị của 3 câu gần đều nhau (lệch quá 10% là sai, ~10 sigma)
+    const int TRIALS = 60000;
+    std::map<std::vector<size_t>, int> counts;
+    QuestionDeck deck;
+    for (int t = 0; t < TRIALS; ++t) {
+        std::vector<size_t> order{deck.draw(3), deck.draw(3), deck.draw(3)};
+        counts[order]++;
+    }
+    CHECK(counts.size() == 6);
+    for (const auto& entry : counts) {
+        CHECK(std::abs(entry.second - TRIALS / 6) < TRIALS / 60);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = 20;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            g_seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            rounds = std::max(1, std::atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--seed N] [--rounds N]" << std::endl;
+            return 2;
+        }
+    }
+
+    struct Suite {
+        const char* name;
+        void (*run)(int);
+    };
+    const Suite suites[] = {
+        {"timing_wheel", checkTimingWheel},
+        {"leaderboard", checkLeaderboard},
+        {"question_deck", checkQuestionDeck},
+    };
+    for (const Suite& suite : suites) {
+        int before = g_failures;
+        suite.run(rounds);
+        std::cout << (g_failures == before ? "OK    " : "FAILED") << "  " << suite.name << std::endl;
+    }
+    if (g_failures > 0) {
+        std::cout << g_failures << " check(s) failed (seed " << g_seed << ")" << std::endl;
+        return 1;
+    }
+    return 0;
+}
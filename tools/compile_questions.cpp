@@ -0,0 +1,128 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+#include <cstdio>
+#include "protocol.hpp"
+#include "question_bank.hpp"
+
+/**
+ * Biên dịch questions.json thành file nhị phân questions.bin (định dạng
+ * trong question_bank.hpp) để server mmap và gửi câu hỏi không cần parse.
+ * Cách dùng: compile_questions INPUT.json OUTPUT.bin
+ */
+
+
+/**
+ * @brief Dồn chuỗi vào string pool, trả về StrRef của nó.
+ */
+static bool addString(std::string& pool, const std::string& s, qbank::StrRef& ref) {
+    if (pool.size() + s.size() > UINT32_MAX) return false; // StrRef dùng offset 32-bit
+    ref.offset = static_cast<uint32_t>(pool.size());
+    ref.length = static_cast<uint32_t>(s.size());
+    pool += s;
+    return true;
+}
+
+static bool fail(const std::string& message) {
+    std::cerr << "compile_questions: " << message << std::endl;
+    return false;
+}
+
+static bool compile(const json& data, const std::string& output) {
+    if (!data.is_array()) return fail("the question file must be a JSON array");
+
+    std::vector<qbank::QuestionEntry> questions;
+    std::vector<qbank::OptionEntry> options;
+    std::string pool;
+    std::unordered_set<std::string> ids;
+    questions.reserve(data.size());
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        const json& item = data[i];
+        std::string where = "question #" + std::to_string(i);
+        if (!item.is_object() || !item.contains("id") || !item.contains("question_text") ||
+            !item.contains("correct_answer") || !item.contains("options") || !item["options"].is_object()) {
+            return fail(where + ": needs id, question_text, options and correct_answer");
+        }
+        std::string id = item["id"].get<std::string>();
+        std::string correct = item["correct_answer"].get<std::string>();
+        if (!ids.insert(id).second) return fail(where + ": duplicate id " + id);
+        if (!item["options"].contains(correct)) {
+            return fail(where + " (" + id + "): correct_answer is not one of the options");
+        }
+
+        qbank::QuestionEntry q = {};
+        bool ok = addString(pool, id, q.id) &&
+                  addString(pool, item["question_text"].get<std::string>(), q.text) &&
+                  addString(pool, correct, q.correct_answer);
+        q.first_option = static_cast<uint32_t>(options.size());
+        q.num_options = static_cast<uint32_t>(item["options"].size());
+        for (auto& [key, value] : item["options"].items()) {
+            qbank::OptionEntry o;
+            ok = ok && addString(pool, key, o.key) && addString(pool, value.get<std::string>(), o.value);
+            options.push_back(o);
+        }
+
+        // Frame S2C_NEW_QUESTION giống hệt frame server từng dựng lúc tải questions.json
+        json q_msg;
+        q_msg["action"] = protocol::S2C_NEW_QUESTION;
+        q_msg["payload"]["question_id"] = id;
+        q_msg["payload"]["question_text"] = item["question_text"];
+        q_msg["payload"]["options"] = item["options"];
+        for (protocol::Encoding enc : {protocol::Encoding::JSON, protocol::Encoding::MSGPACK}) {
+            std::string frame;
+            protocol::appendFrame(frame, q_msg, enc);
+            ok = ok && addString(pool, frame, q.frame[static_cast<size_t>(enc)]);
+        }
+        if (!ok) return fail("string pool exceeds 4GB");
+        questions.push_back(q);
+    }
+
+    qbank::FileHeader header = {};
+    header.magic = qbank::MAGIC;
+    header.version = qbank::VERSION;
+    header.count = static_cast<uint32_t>(questions.size());
+    header.option_count = static_cast<uint32_t>(options.size());
+    header.pool_offset = sizeof(header) + questions.size() * sizeof(qbank::QuestionEntry) +
+                         options.size() * sizeof(qbank::OptionEntry);
+    header.pool_size = pool.size();
+
+    // Ghi file tạm rồi rename: server đang mmap file cũ không thấy file dở
+    std::string tmp = output + ".tmp";
+    {
+        std::ofstream o(tmp, std::ios::binary | std::ios::trunc);
+        o.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        o.write(reinterpret_cast<const char*>(questions.data()), questions.size() * sizeof(qbank::QuestionEntry));
+        o.write(reinterpret_cast<const char*>(options.data()), options.size() * sizeof(qbank::OptionEntry));
+        o.write(pool.data(), pool.size());
+        if (!o) return fail("cannot write " + tmp);
+    }
+    if (std::rename(tmp.c_str(), output.c_str()) != 0) return fail("cannot rename " + tmp);
+
+    std::cout << "Compiled " << questions.size() << " questions (" << header.pool_offset + pool.size()
+              << " bytes) into " << output << std::endl;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " INPUT.json OUTPUT.bin\n";
+        return 1;
+    }
+
+    std::ifstream f(argv[1]);
+    if (!f.is_open()) {
+        std::cerr << "compile_questions: cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+    try {
+        return compile(json::parse(f), argv[2]) ? 0 : 1;
+    } catch (json::exception& e) {
+        // JSON hỏng hoặc trường có kiểu sai (ví dụ id là số)
+        std::cerr << "compile_questions: " << argv[1] << ": " << e.what() << std::endl;
+        return 1;
+    }
+}